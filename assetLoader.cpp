@@ -0,0 +1,691 @@
+/**
+ * @brief Loads models and fonts in two halves: decoding on any thread, GPU upload on the main one
+ * @author Mariano Caceres Smoler
+ * @author Enzo Nicolas Rosa Fernandez
+ * @author Francisco Chiusaroli
+ *
+ * raylib's LoadModel and LoadFontEx read, decode and upload in a single call,
+ * and OpenGL may only be used from the thread that owns the context. The
+ * decoders here do the CPU half (OBJ/MTL parsing, image decoding, glyph
+ * rasterization) without touching the GPU, so they can run on worker threads.
+ * The upload functions finish the job on the main thread. Meshes are split per
+ * material and de-indexed like raylib's own OBJ loader, so models look the same.
+ * Models with an up to date binary cache (see modelCache.cpp) skip the OBJ
+ * parsing altogether.
+ *
+ * Sources:
+ * https://paulbourke.net/dataformats/obj/ ; Wavefront OBJ format
+ * https://paulbourke.net/dataformats/mtl/ ; Wavefront MTL format
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "assetLoader.h"
+#include "modelCache.h"
+#include "raymath.h"
+
+#define FONT_GLYPH_PADDING 4	  // As LoadFontEx
+#define OBJ_DEFAULT_DIFFUSE 0.6F // Kd of materials that do not set it, as raylib's OBJ loader
+
+struct ObjMaterial
+{
+	std::string name;
+	float diffuse[3];
+	std::string diffuseMap; // Path of map_Kd, empty if there is none
+};
+
+// Indices into the attribute lists, -1 when absent
+struct ObjVertex
+{
+	int position;
+	int texcoord;
+	int normal;
+};
+
+// Triangles of one material, already de-indexed
+struct ObjMeshBuilder
+{
+	std::vector<float> vertices;
+	std::vector<float> texcoords;
+	std::vector<float> normals;
+};
+
+/**
+ * @brief Reads a whole text file
+ * @return Whether it could be read
+ */
+static bool readTextFile(const char *fileName, std::string &text)
+{
+	int size = 0;
+	unsigned char *fileData = LoadFileData(fileName, &size);
+
+	if (!fileData)
+		return false;
+
+	text.assign((const char *)fileData, size);
+	UnloadFileData(fileData);
+
+	return true;
+}
+
+/**
+ * @brief Gets the directory of a path, with its trailing separator
+ * @param fileName The path
+ * @return The directory, empty for a bare file name
+ */
+std::string getAssetDirectory(const char *fileName)
+{
+	std::string path = fileName;
+	size_t separator = path.find_last_of("/\\");
+
+	return (separator == std::string::npos) ? std::string() : path.substr(0, separator + 1);
+}
+
+static char *skipSpaces(char *text)
+{
+	while (*text == ' ' || *text == '\t')
+		text++;
+
+	return text;
+}
+
+/**
+ * @brief Cuts the next line out of a text buffer
+ * @return The line without its end of line and surrounding blanks, or NULL at the end
+ */
+static char *nextLine(char *&cursor)
+{
+	if (!*cursor)
+		return NULL;
+
+	char *line = cursor;
+	char *end = strchr(cursor, '\n');
+
+	if (end)
+		cursor = end + 1;
+	else
+		end = cursor = line + strlen(line);
+
+	while (end > line && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r' || end[-1] == '\n'))
+		end--;
+
+	*end = '\0';
+
+	return skipSpaces(line);
+}
+
+/**
+ * @brief Checks the statement of a line and skips past it
+ *
+ * @param line The line, moved to the first argument on a match
+ * @param keyword The statement, such as "v" or "usemtl"
+ * @return Whether the line starts with it
+ */
+static bool matchKeyword(char *&line, const char *keyword)
+{
+	size_t length = strlen(keyword);
+
+	if (strncmp(line, keyword, length) || (line[length] != ' ' && line[length] != '\t'))
+		return false;
+
+	line = skipSpaces(line + length);
+
+	return true;
+}
+
+/**
+ * @brief Reads up to count floats, missing ones are 0
+ */
+static void readFloats(char *text, float *values, int count)
+{
+	for (int i = 0; i < count; i++)
+		values[i] = strtof(text, &text);
+}
+
+/**
+ * @brief Gets the last blank separated word of a line, such as the file of a map_Kd with options
+ */
+static const char *getLastWord(const char *text)
+{
+	const char *word = text;
+
+	for (const char *c = text; *c; c++)
+	{
+		if ((*c == ' ' || *c == '\t') && c[1] != ' ' && c[1] != '\t' && c[1])
+			word = c + 1;
+	}
+
+	return word;
+}
+
+/**
+ * @brief Reads the materials of an MTL file
+ *
+ * @param fileName The MTL file
+ * @param directory Where the maps it names are
+ * @param materials Where the materials are added
+ * @param sources If not NULL, where the maps are added, relative to directory
+ */
+static void parseMaterialFile(const std::string &fileName, const std::string &directory,
+							  std::vector<ObjMaterial> &materials, std::vector<std::string> *sources)
+{
+	std::string text;
+
+	if (!readTextFile(fileName.c_str(), text))
+		return;
+
+	char *cursor = &text[0];
+	char *line;
+
+	while ((line = nextLine(cursor)))
+	{
+		if (matchKeyword(line, "newmtl"))
+		{
+			ObjMaterial material;
+
+			material.name = line;
+			material.diffuse[0] = material.diffuse[1] = material.diffuse[2] = OBJ_DEFAULT_DIFFUSE;
+			materials.push_back(material);
+		}
+		else if (materials.empty())
+			continue;
+		else if (matchKeyword(line, "Kd"))
+			readFloats(line, materials.back().diffuse, 3);
+		else if (matchKeyword(line, "map_Kd"))
+		{
+			materials.back().diffuseMap = directory + getLastWord(line);
+
+			if (sources)
+				sources->push_back(getLastWord(line));
+		}
+	}
+}
+
+/**
+ * @brief Turns a 1-based or negative OBJ index into a 0-based one
+ * @return The index, or -1 if it is out of range
+ */
+static int resolveIndex(long index, size_t count)
+{
+	if (index > 0 && (size_t)index <= count)
+		return (int)index - 1;
+
+	if (index < 0 && (size_t)-index <= count)
+		return (int)(count + index);
+
+	return -1;
+}
+
+/**
+ * @brief Reads the corners of a face, as v, v/vt, v//vn or v/vt/vn
+ * @return Whether it is a polygon with valid positions
+ */
+static bool parseFace(char *text, size_t positionCount, size_t texcoordCount, size_t normalCount,
+					  std::vector<ObjVertex> &face)
+{
+	face.clear();
+
+	while (*text)
+	{
+		char *next;
+		ObjVertex vertex;
+
+		vertex.position = resolveIndex(strtol(text, &next, 10), positionCount);
+		vertex.texcoord = vertex.normal = -1;
+
+		if (next == text || vertex.position < 0)
+			return false;
+
+		text = next;
+
+		if (*text == '/')
+		{
+			text++;
+
+			if (*text != '/')
+			{
+				vertex.texcoord = resolveIndex(strtol(text, &next, 10), texcoordCount);
+				text = next;
+			}
+
+			if (*text == '/')
+			{
+				text++;
+				vertex.normal = resolveIndex(strtol(text, &next, 10), normalCount);
+				text = next;
+			}
+		}
+
+		face.push_back(vertex);
+		text = skipSpaces(text);
+	}
+
+	return face.size() >= 3;
+}
+
+static void appendVertex(ObjMeshBuilder &builder, const ObjVertex &vertex, const std::vector<float> &positions,
+						 const std::vector<float> &texcoords, const std::vector<float> &normals)
+{
+	builder.vertices.insert(builder.vertices.end(), &positions[3 * vertex.position], &positions[3 * vertex.position] + 3);
+
+	if (vertex.texcoord >= 0)
+	{
+		builder.texcoords.push_back(texcoords[2 * vertex.texcoord]);
+		builder.texcoords.push_back(1.0F - texcoords[2 * vertex.texcoord + 1]); // Images are stored top row first
+	}
+	else
+		builder.texcoords.insert(builder.texcoords.end(), 2, 0.0F);
+
+	if (vertex.normal >= 0)
+		builder.normals.insert(builder.normals.end(), &normals[3 * vertex.normal], &normals[3 * vertex.normal] + 3);
+	else
+		builder.normals.insert(builder.normals.end(), 3, 0.0F);
+}
+
+static unsigned long long hashBytes(unsigned long long hash, const void *bytes, size_t size)
+{
+	const unsigned char *data = (const unsigned char *)bytes;
+
+	for (size_t i = 0; i < size; i++)
+		hash = (hash ^ data[i]) * 1099511628211ULL;
+
+	return hash;
+}
+
+/**
+ * @brief Gets what identifies a mesh for sharing
+ *
+ * The models of the solar system are one sphere exported at different places:
+ * their positions differ by a translation plus the round off of the text
+ * format, and their normals were recomputed from those. So only the parts that
+ * stay exact are hashed (FNV-1a); the shape is summarized by its bounds and
+ * spread, and the registry then compares the arrays within a tolerance.
+ *
+ * @param mesh The mesh, with its CPU arrays
+ * @return Its identity
+ */
+static MeshIdentity getMeshIdentity(const Mesh &mesh)
+{
+	MeshIdentity identity = {};
+	unsigned long long hash = 14695981039346656037ULL;
+
+	hash = hashBytes(hash, &mesh.vertexCount, sizeof(mesh.vertexCount));
+	hash = hashBytes(hash, &mesh.triangleCount, sizeof(mesh.triangleCount));
+
+	if (mesh.texcoords)
+		hash = hashBytes(hash, mesh.texcoords, mesh.vertexCount * 2 * sizeof(float));
+
+	if (mesh.indices)
+		hash = hashBytes(hash, mesh.indices, mesh.triangleCount * 3 * sizeof(unsigned short));
+
+	identity.hash = hash;
+
+	for (int i = 0; i < mesh.vertexCount; i++)
+	{
+		Vector3 position = {mesh.vertices[3 * i], mesh.vertices[3 * i + 1], mesh.vertices[3 * i + 2]};
+
+		identity.bounds.min = i ? Vector3Min(identity.bounds.min, position) : position;
+		identity.bounds.max = i ? Vector3Max(identity.bounds.max, position) : position;
+	}
+
+	Vector3 center = Vector3Scale(Vector3Add(identity.bounds.min, identity.bounds.max), 0.5F);
+	double squares = 0;
+
+	for (int i = 0; i < mesh.vertexCount; i++)
+	{
+		Vector3 position = {mesh.vertices[3 * i], mesh.vertices[3 * i + 1], mesh.vertices[3 * i + 2]};
+
+		squares += Vector3LengthSqr(Vector3Subtract(position, center));
+	}
+
+	identity.spread = mesh.vertexCount ? (float)sqrt(squares / mesh.vertexCount) : 0;
+
+	return identity;
+}
+
+static float *copyToMemAlloc(const std::vector<float> &values)
+{
+	float *array = (float *)MemAlloc((unsigned int)(values.size() * sizeof(float)));
+
+	memcpy(array, values.data(), values.size() * sizeof(float));
+
+	return array;
+}
+
+/**
+ * @brief Decodes a Wavefront OBJ model, from its cache if it is up to date
+ *
+ * Does not use the GPU, so it may run on any thread.
+ *
+ * @param fileName The OBJ file
+ * @param data Where the model is stored, empty on failure
+ * @return Whether the model could be read
+ */
+bool decodeModelFile(const char *fileName, ModelData *data)
+{
+	if (!readModelCache(fileName, data) && !decodeObjFile(fileName, data, NULL))
+		return false;
+
+	data->meshIdentity = (MeshIdentity *)MemAlloc(data->meshCount * sizeof(MeshIdentity));
+
+	for (int i = 0; i < data->meshCount; i++)
+		data->meshIdentity[i] = getMeshIdentity(data->meshes[i]);
+
+	return true;
+}
+
+/**
+ * @brief Parses a Wavefront OBJ model, its materials and its diffuse maps
+ *
+ * Does not use the GPU, so it may run on any thread.
+ *
+ * @param fileName The OBJ file
+ * @param data Where the model is stored, empty on failure
+ * @param sources If not NULL, where the MTL files and maps it uses are added, relative to its directory
+ * @return Whether the model could be read
+ */
+bool decodeObjFile(const char *fileName, ModelData *data, std::vector<std::string> *sources)
+{
+	*data = {};
+
+	std::string text;
+
+	if (!readTextFile(fileName, text))
+		return false;
+
+	std::string directory = getAssetDirectory(fileName);
+	std::vector<float> positions;
+	std::vector<float> texcoords;
+	std::vector<float> normals;
+	std::vector<ObjMaterial> materials;
+	std::vector<ObjMeshBuilder> builders(1);
+	std::vector<ObjVertex> face;
+	unsigned int material = 0;
+
+	char *cursor = &text[0];
+	char *line;
+
+	while ((line = nextLine(cursor)))
+	{
+		float values[3];
+
+		if (matchKeyword(line, "v"))
+		{
+			readFloats(line, values, 3);
+			positions.insert(positions.end(), values, values + 3);
+		}
+		else if (matchKeyword(line, "vt"))
+		{
+			readFloats(line, values, 2);
+			texcoords.insert(texcoords.end(), values, values + 2);
+		}
+		else if (matchKeyword(line, "vn"))
+		{
+			readFloats(line, values, 3);
+			normals.insert(normals.end(), values, values + 3);
+		}
+		else if (matchKeyword(line, "f"))
+		{
+			if (!parseFace(line, positions.size() / 3, texcoords.size() / 2, normals.size() / 3, face))
+				continue;
+
+			// Polygons as triangle fans
+			for (size_t i = 1; i + 1 < face.size(); i++)
+			{
+				appendVertex(builders[material], face[0], positions, texcoords, normals);
+				appendVertex(builders[material], face[i], positions, texcoords, normals);
+				appendVertex(builders[material], face[i + 1], positions, texcoords, normals);
+			}
+		}
+		else if (matchKeyword(line, "usemtl"))
+		{
+			material = 0; // Unknown materials fall back to the first one
+
+			for (size_t i = 0; i < materials.size(); i++)
+			{
+				if (materials[i].name == line)
+					material = (unsigned int)i;
+			}
+		}
+		else if (matchKeyword(line, "mtllib"))
+		{
+			if (sources)
+				sources->push_back(line);
+
+			parseMaterialFile(directory + line, directory, materials, sources);
+			builders.resize(std::max(materials.size(), builders.size()));
+		}
+	}
+
+	// Without an MTL file the model gets a plain white material
+	if (materials.empty())
+	{
+		ObjMaterial fallback;
+
+		fallback.diffuse[0] = fallback.diffuse[1] = fallback.diffuse[2] = 1.0F;
+		materials.push_back(fallback);
+	}
+
+	int meshCount = 0;
+
+	for (size_t i = 0; i < builders.size(); i++)
+	{
+		if (!builders[i].vertices.empty())
+			meshCount++;
+	}
+
+	if (!meshCount)
+		return false;
+
+	// One mesh per material with triangles
+	data->meshCount = meshCount;
+	data->meshes = (Mesh *)MemAlloc(meshCount * sizeof(Mesh));
+	data->meshMaterial = (int *)MemAlloc(meshCount * sizeof(int));
+
+	for (size_t i = 0, j = 0; i < builders.size(); i++)
+	{
+		if (builders[i].vertices.empty())
+			continue;
+
+		Mesh &mesh = data->meshes[j];
+
+		mesh.vertexCount = (int)(builders[i].vertices.size() / 3);
+		mesh.triangleCount = mesh.vertexCount / 3;
+		mesh.vertices = copyToMemAlloc(builders[i].vertices);
+		mesh.texcoords = copyToMemAlloc(builders[i].texcoords);
+		mesh.normals = copyToMemAlloc(builders[i].normals);
+
+		data->meshMaterial[j++] = (int)std::min(i, materials.size() - 1);
+	}
+
+	data->materialCount = (int)materials.size();
+	data->materialColor = (Color *)MemAlloc(data->materialCount * sizeof(Color));
+	data->materialImage = (Image *)MemAlloc(data->materialCount * sizeof(Image));
+
+	for (int i = 0; i < data->materialCount; i++)
+	{
+		const ObjMaterial &objMaterial = materials[i];
+
+		// As raylib: textured materials are not tinted by Kd
+		if (!objMaterial.diffuseMap.empty())
+		{
+			data->materialColor[i] = WHITE;
+			data->materialImage[i] = LoadImage(objMaterial.diffuseMap.c_str());
+		}
+		else
+		{
+			data->materialColor[i] = {(unsigned char)(Clamp(objMaterial.diffuse[0], 0, 1) * 255.0F),
+									  (unsigned char)(Clamp(objMaterial.diffuse[1], 0, 1) * 255.0F),
+									  (unsigned char)(Clamp(objMaterial.diffuse[2], 0, 1) * 255.0F), 255};
+		}
+	}
+
+	return true;
+}
+
+/**
+ * @brief Sends a decoded model to the GPU
+ *
+ * Must run on the thread that owns the OpenGL context. Takes the mesh arrays
+ * and frees the rest of the decoded data. Meshes that already have buffers
+ * are not uploaded again.
+ *
+ * @param data The decoded model, empty afterwards
+ * @return The model, or a cube if it could not be decoded (as LoadModel)
+ */
+Model uploadModelData(ModelData *data)
+{
+	Model model = {};
+
+	if (!data->meshCount)
+		model = LoadModelFromMesh(GenMeshCube(1.0F, 1.0F, 1.0F));
+	else
+	{
+		model.transform = MatrixIdentity();
+		model.meshCount = data->meshCount;
+		model.meshes = data->meshes;
+		model.meshMaterial = data->meshMaterial;
+
+		for (int i = 0; i < model.meshCount; i++)
+		{
+			// Already on the GPU, shared with another model
+			if (model.meshes[i].vboId)
+				continue;
+
+			UploadMesh(&model.meshes[i], false);
+
+			// The arrays are in the cache mapping: only the GPU copy is kept
+			if (data->cache)
+			{
+				model.meshes[i].vertices = NULL;
+				model.meshes[i].texcoords = NULL;
+				model.meshes[i].normals = NULL;
+				model.meshes[i].indices = NULL;
+			}
+		}
+
+		model.materialCount = data->materialCount;
+		model.materials = (Material *)MemAlloc(model.materialCount * sizeof(Material));
+
+		for (int i = 0; i < model.materialCount; i++)
+		{
+			model.materials[i] = LoadMaterialDefault();
+			model.materials[i].maps[MATERIAL_MAP_DIFFUSE].color = data->materialColor[i];
+
+			if (data->materialImage[i].data)
+			{
+				model.materials[i].maps[MATERIAL_MAP_DIFFUSE].texture = LoadTextureFromImage(data->materialImage[i]);
+
+				if (!data->cache)
+					UnloadImage(data->materialImage[i]);
+			}
+		}
+	}
+
+	MemFree(data->materialColor);
+	MemFree(data->materialImage);
+	MemFree(data->meshIdentity);
+	destroyMappedFile(data->cache);
+
+	*data = {};
+
+	return model;
+}
+
+/**
+ * @brief Frees a decoded model that will not be uploaded
+ * @param data The decoded model, empty afterwards
+ */
+void unloadModelData(ModelData *data)
+{
+	if (!data->cache)
+	{
+		for (int i = 0; i < data->meshCount; i++)
+		{
+			MemFree(data->meshes[i].vertices);
+			MemFree(data->meshes[i].texcoords);
+			MemFree(data->meshes[i].normals);
+			MemFree(data->meshes[i].indices);
+		}
+
+		for (int i = 0; i < data->materialCount; i++)
+		{
+			if (data->materialImage[i].data)
+				UnloadImage(data->materialImage[i]);
+		}
+	}
+
+	MemFree(data->meshes);
+	MemFree(data->meshMaterial);
+	MemFree(data->materialColor);
+	MemFree(data->materialImage);
+	MemFree(data->meshIdentity);
+	destroyMappedFile(data->cache);
+
+	*data = {};
+}
+
+/**
+ * @brief Rasterizes the glyphs of a TTF/OTF font into an atlas image
+ *
+ * Does not use the GPU, so it may run on any thread.
+ *
+ * @param fileName The font file
+ * @param fontSize Glyph height in pixels
+ * @param glyphCount Glyphs to rasterize, from the space character on
+ * @param data Where the font is stored
+ * @return Whether the font could be read
+ */
+bool decodeFontFile(const char *fileName, int fontSize, int glyphCount, FontData *data)
+{
+	*data = {};
+
+	int size = 0;
+	unsigned char *fileData = LoadFileData(fileName, &size);
+
+	if (!fileData)
+		return false;
+
+	data->font.baseSize = fontSize;
+	data->font.glyphCount = glyphCount;
+	data->font.glyphPadding = FONT_GLYPH_PADDING;
+	data->font.glyphs = LoadFontData(fileData, size, fontSize, NULL, glyphCount, FONT_DEFAULT);
+
+	UnloadFileData(fileData);
+
+	if (!data->font.glyphs)
+		return false;
+
+	data->atlas = GenImageFontAtlas(data->font.glyphs, &data->font.recs, glyphCount, fontSize, FONT_GLYPH_PADDING, 0);
+	data->valid = true;
+
+	return true;
+}
+
+/**
+ * @brief Sends the atlas of a decoded font to the GPU
+ *
+ * Must run on the thread that owns the OpenGL context.
+ *
+ * @param data The decoded font, empty afterwards
+ * @return The font, or the default one if it could not be decoded (as LoadFontEx)
+ */
+Font uploadFontData(FontData *data)
+{
+	if (!data->valid)
+		return GetFontDefault();
+
+	Font font = data->font;
+
+	font.texture = LoadTextureFromImage(data->atlas);
+	UnloadImage(data->atlas);
+
+	*data = {};
+
+	return font;
+}
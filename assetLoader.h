@@ -0,0 +1,69 @@
+/**
+ * @brief Loads models and fonts in two halves: decoding on any thread, GPU upload on the main one
+ * @author Mariano Caceres Smoler
+ * @author Enzo Nicolas Rosa Fernandez
+ * @author Francisco Chiusaroli
+ */
+
+#ifndef ASSETLOADER_H
+#define ASSETLOADER_H
+
+#include <raylib.h>
+#include <string>
+#include <vector>
+
+#include "mappedFile.h"
+
+/**
+ * @brief What makes two meshes the same for sharing, see AssetRegistry
+ */
+struct MeshIdentity
+{
+	unsigned long long hash; // Of the counts, texture coordinates and indices, which are exact
+	BoundingBox bounds;
+	float spread; // Root mean square distance of the positions to the center of bounds
+};
+
+/**
+ * @brief A model decoded into CPU memory, not yet known to the GPU
+ */
+struct ModelData
+{
+	int meshCount; // 0 if the file could not be read
+	Mesh *meshes;  // Vertex arrays only, allocated with MemAlloc unless cache is set
+	int *meshMaterial;
+
+	int materialCount;
+	Color *materialColor;
+	Image *materialImage; // Diffuse maps, data is NULL where there is none
+
+	MappedFile *cache; // If read from the model cache, the arrays and images point into it
+
+	MeshIdentity *meshIdentity;
+};
+
+/**
+ * @brief A font rasterized into CPU memory, not yet known to the GPU
+ */
+struct FontData
+{
+	bool valid;
+	Font font; // Everything but the texture
+	Image atlas;
+};
+
+bool decodeModelFile(const char *fileName, ModelData *data);
+
+bool decodeObjFile(const char *fileName, ModelData *data, std::vector<std::string> *sources);
+
+Model uploadModelData(ModelData *data);
+
+void unloadModelData(ModelData *data);
+
+std::string getAssetDirectory(const char *fileName);
+
+bool decodeFontFile(const char *fileName, int fontSize, int glyphCount, FontData *data);
+
+Font uploadFontData(FontData *data);
+
+#endif
@@ -0,0 +1,273 @@
+/**
+ * @brief Loads each distinct mesh and sound once and shares it
+ * @author Mariano Caceres Smoler
+ * @author Enzo Nicolas Rosa Fernandez
+ * @author Francisco Chiusaroli
+ *
+ * Meshes are matched by content (see MeshIdentity): the hash of their exact
+ * parts, and the size of their bounds and their spread within a tolerance,
+ * then every position and normal within that tolerance. A match may sit
+ * somewhere else, as the models of the solar system were
+ * exported at different places; the model then draws the shared mesh through a
+ * translation in its transform. Sounds are matched by file, and repeated ones
+ * become aliases: they play on their own but use the same samples.
+ */
+
+#include <cmath>
+
+#include "assetRegistry.h"
+#include "raymath.h"
+#include "rlgl.h"
+
+#define MESH_MATCH_TOLERANCE 2E-4F // Above a unit in the last place of normals written with 4 decimals
+
+static bool isNear(Vector3 a, Vector3 b)
+{
+	return fabsf(a.x - b.x) <= MESH_MATCH_TOLERANCE && fabsf(a.y - b.y) <= MESH_MATCH_TOLERANCE &&
+		   fabsf(a.z - b.z) <= MESH_MATCH_TOLERANCE;
+}
+
+static Vector3 getBoundsCenter(BoundingBox bounds)
+{
+	return Vector3Scale(Vector3Add(bounds.min, bounds.max), 0.5F);
+}
+
+static Vector3 getBoundsSize(BoundingBox bounds)
+{
+	return Vector3Subtract(bounds.max, bounds.min);
+}
+
+/**
+ * @brief Compares the positions and normals of a decoded mesh with those of a registered one
+ *
+ * @param shared The registered mesh
+ * @param mesh The decoded mesh, with its CPU arrays
+ * @param offset Where the decoded mesh sits relative to the registered one
+ * @return Whether every value matches within the tolerance
+ */
+static bool isSameShape(const SharedMesh &shared, const Mesh &mesh, Vector3 offset)
+{
+	size_t count = 3 * (size_t)mesh.vertexCount;
+
+	if (shared.vertices.size() != count || shared.normals.size() != (mesh.normals ? count : 0))
+		return false;
+
+	for (size_t i = 0; i < count; i += 3)
+	{
+		Vector3 position = {mesh.vertices[i] - offset.x, mesh.vertices[i + 1] - offset.y,
+							mesh.vertices[i + 2] - offset.z};
+
+		if (!isNear(position, {shared.vertices[i], shared.vertices[i + 1], shared.vertices[i + 2]}))
+			return false;
+
+		if (mesh.normals &&
+			!isNear({mesh.normals[i], mesh.normals[i + 1], mesh.normals[i + 2]},
+					{shared.normals[i], shared.normals[i + 1], shared.normals[i + 2]}))
+			return false;
+	}
+
+	return true;
+}
+
+/**
+ * @brief Finds a registered mesh that has the same content as a decoded one, maybe somewhere else
+ *
+ * The identities rule out most meshes cheaply; the arrays of the candidates
+ * left are then compared.
+ *
+ * @param registry The registry
+ * @param identity The identity of the decoded mesh
+ * @param mesh The decoded mesh, with its CPU arrays
+ * @return Its index, or -1 if there is none
+ */
+static int findSharedMesh(const AssetRegistry *registry, const MeshIdentity &identity, const Mesh &mesh)
+{
+	for (size_t i = 0; i < registry->meshes.size(); i++)
+	{
+		const SharedMesh &shared = registry->meshes[i];
+
+		if (!shared.identified || shared.identity.hash != identity.hash ||
+			!isNear(getBoundsSize(shared.identity.bounds), getBoundsSize(identity.bounds)) ||
+			fabsf(shared.identity.spread - identity.spread) > MESH_MATCH_TOLERANCE * identity.spread)
+			continue;
+
+		Vector3 offset = Vector3Subtract(getBoundsCenter(identity.bounds), getBoundsCenter(shared.identity.bounds));
+
+		if (isSameShape(shared, mesh, offset))
+			return (int)i;
+	}
+
+	return -1;
+}
+
+AssetRegistry *constructAssetRegistry()
+{
+	return new AssetRegistry();
+}
+
+/**
+ * @brief Unloads every mesh and sound in the registry
+ * @param registry The registry, after the models that use it
+ */
+void destroyAssetRegistry(AssetRegistry *registry)
+{
+	for (size_t i = 0; i < registry->meshes.size(); i++)
+		UnloadMesh(registry->meshes[i].mesh);
+
+	for (size_t i = 0; i < registry->soundAliases.size(); i++)
+		UnloadSoundAlias(registry->soundAliases[i]);
+
+	for (size_t i = 0; i < registry->sounds.size(); i++)
+		UnloadSound(registry->sounds[i].sound);
+
+	delete registry;
+}
+
+/**
+ * @brief Sends a decoded model to the GPU, reusing the meshes already there
+ *
+ * A model shares its meshes only if all of them are registered and moved by
+ * the same offset, as it has a single transform. Its new meshes are
+ * registered. Materials and textures are always its own.
+ *
+ * @param registry The registry
+ * @param data The decoded model, empty afterwards
+ * @return The model, to be unloaded with unloadSharedModel
+ */
+Model uploadSharedModel(AssetRegistry *registry, ModelData *data)
+{
+	int meshCount = data->meshCount;
+	std::vector<int> shared(meshCount, -1);
+	Vector3 offset = {0, 0, 0};
+	bool sharing = (meshCount > 0);
+
+	for (int i = 0; i < meshCount && sharing; i++)
+	{
+		shared[i] = findSharedMesh(registry, data->meshIdentity[i], data->meshes[i]);
+
+		if (shared[i] < 0)
+		{
+			sharing = false;
+			break;
+		}
+
+		Vector3 meshOffset = Vector3Subtract(getBoundsCenter(data->meshIdentity[i].bounds),
+											 getBoundsCenter(registry->meshes[shared[i]].identity.bounds));
+
+		if (!i)
+			offset = meshOffset;
+		else if (!isNear(meshOffset, offset))
+			sharing = false;
+	}
+
+	if (!sharing)
+	{
+		offset = {0, 0, 0};
+		shared.assign(meshCount, -1);
+	}
+
+	// uploadModelData empties data and may drop the CPU arrays
+	std::vector<SharedMesh> registered(meshCount);
+
+	for (int i = 0; i < meshCount; i++)
+	{
+		if (shared[i] < 0)
+		{
+			const Mesh &mesh = data->meshes[i];
+			size_t count = 3 * (size_t)mesh.vertexCount;
+
+			registered[i].identified = true;
+			registered[i].identity = data->meshIdentity[i];
+			registered[i].vertices.assign(mesh.vertices, mesh.vertices + count);
+
+			if (mesh.normals)
+				registered[i].normals.assign(mesh.normals, mesh.normals + count);
+
+			continue;
+		}
+
+		if (!data->cache)
+		{
+			MemFree(data->meshes[i].vertices);
+			MemFree(data->meshes[i].texcoords);
+			MemFree(data->meshes[i].normals);
+			MemFree(data->meshes[i].indices);
+		}
+
+		data->meshes[i] = registry->meshes[shared[i]].mesh;
+	}
+
+	Model model = uploadModelData(data);
+
+	model.transform = MatrixTranslate(offset.x, offset.y, offset.z);
+
+	for (int i = 0; i < model.meshCount; i++)
+	{
+		if (i < meshCount && shared[i] >= 0)
+			continue;
+
+		// Past meshCount, the model could not be read
+		SharedMesh mesh = (i < meshCount) ? registered[i] : SharedMesh();
+
+		mesh.mesh = model.meshes[i];
+
+		registry->meshes.push_back(mesh);
+	}
+
+	return model;
+}
+
+/**
+ * @brief Unloads what a model from uploadSharedModel owns: its materials and textures, not its meshes
+ * @param model The model
+ */
+void unloadSharedModel(Model model)
+{
+	for (int i = 0; i < model.materialCount; i++)
+	{
+		Texture2D texture = model.materials[i].maps[MATERIAL_MAP_DIFFUSE].texture;
+
+		if (texture.id && texture.id != rlGetTextureIdDefault())
+			UnloadTexture(texture);
+
+		MemFree(model.materials[i].maps);
+	}
+
+	MemFree(model.materials);
+	MemFree(model.meshes);
+	MemFree(model.meshMaterial);
+}
+
+/**
+ * @brief Loads a sound, or an alias of it if it was loaded before
+ *
+ * @param registry The registry, which unloads it
+ * @param fileName The sound file
+ * @return The sound
+ */
+Sound loadSharedSound(AssetRegistry *registry, const char *fileName)
+{
+	for (size_t i = 0; i < registry->sounds.size(); i++)
+	{
+		const SharedSound &shared = registry->sounds[i];
+
+		if (shared.fileName != fileName)
+			continue;
+
+		// Could not be loaded: aliases need its buffer
+		if (!shared.sound.stream.buffer)
+			return shared.sound;
+
+		Sound alias = LoadSoundAlias(shared.sound);
+
+		registry->soundAliases.push_back(alias);
+
+		return alias;
+	}
+
+	SharedSound shared = {fileName, LoadSound(fileName)};
+
+	registry->sounds.push_back(shared);
+
+	return shared.sound;
+}
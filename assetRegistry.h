@@ -0,0 +1,52 @@
+/**
+ * @brief Loads each distinct mesh and sound once and shares it
+ * @author Mariano Caceres Smoler
+ * @author Enzo Nicolas Rosa Fernandez
+ * @author Francisco Chiusaroli
+ */
+
+#ifndef ASSETREGISTRY_H
+#define ASSETREGISTRY_H
+
+#include <raylib.h>
+#include <string>
+#include <vector>
+
+#include "assetLoader.h"
+
+struct SharedMesh
+{
+	Mesh mesh;
+	bool identified; // Fallback cubes are never shared
+	MeshIdentity identity;
+	std::vector<float> vertices; // CPU copies the content of new meshes is compared against
+	std::vector<float> normals;
+};
+
+struct SharedSound
+{
+	std::string fileName;
+	Sound sound;
+};
+
+/**
+ * @brief Owner of the GPU meshes and audio buffers the models and sounds share
+ */
+struct AssetRegistry
+{
+	std::vector<SharedMesh> meshes;
+	std::vector<SharedSound> sounds;
+	std::vector<Sound> soundAliases;
+};
+
+AssetRegistry *constructAssetRegistry();
+
+void destroyAssetRegistry(AssetRegistry *registry);
+
+Model uploadSharedModel(AssetRegistry *registry, ModelData *data);
+
+void unloadSharedModel(Model model);
+
+Sound loadSharedSound(AssetRegistry *registry, const char *fileName);
+
+#endif
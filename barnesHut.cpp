@@ -0,0 +1,525 @@
+/**
+ * @brief Barnes-Hut octree for all-body gravity
+ * @author Mariano Caceres Smoler
+ * @author Enzo Nicolas Rosa Fernandez
+ * @author Francisco Chiusaroli
+ *
+ * The tree is rebuilt on every step. Bodies are first bucketed in parallel
+ * into the 4x4x4 cells of the two top levels (counting sort), then every cell
+ * is built as an independent subtree on its own job, and finally the subtrees
+ * are stitched under the root. Far away nodes are replaced by their center of
+ * mass when size / distance < theta.
+ *
+ * Sources:
+ * https://en.wikipedia.org/wiki/Barnes%E2%80%93Hut_simulation ; Algorithm and opening criterion
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "barnesHut.h"
+#include "configuration.h"
+
+#define BARNES_HUT_LEAF_SIZE 8			// Bodies summed directly in a leaf
+#define BARNES_HUT_MAX_DEPTH 32			// Leaves are forced past this depth (coincident bodies)
+#define BARNES_HUT_CELLS_PER_AXIS 4		// Cells per axis of the top two levels
+#define BARNES_HUT_CELLS 64				// Subtrees built in parallel
+#define BARNES_HUT_SORT_CHUNK 4096		// Bodies per job when bucketing
+#define BARNES_HUT_BODIES_PER_JOB 256	// Bodies per job when walking the tree
+#define BARNES_HUT_STACK_SIZE (8 * BARNES_HUT_MAX_DEPTH + 8)
+
+/**
+ * @brief Octree node. Leaves have count > 0 and no children.
+ */
+struct BarnesHutNode
+{
+	float comX, comY, comZ; // Center of mass
+	float mass;
+	float size; // Edge of the node cube
+	int child[8];
+	unsigned int first; // Bodies of a leaf in the order array
+	unsigned int count;
+};
+
+struct BarnesHutTree
+{
+	std::vector<BarnesHutNode> nodes;
+	std::vector<BarnesHutNode> cellNodes[BARNES_HUT_CELLS];
+
+	std::vector<unsigned int> order; // Body indices, grouped by node
+	std::vector<unsigned char> cell; // Top level cell of every body
+	std::vector<unsigned int> chunkOffsets;
+};
+
+template <typename position_t>
+struct BarnesHutInput
+{
+	const position_t *posX;
+	const position_t *posY;
+	const position_t *posZ;
+	const float *mass;
+	unsigned int *order;
+};
+
+/**
+ * @brief Constructs an empty Barnes-Hut tree
+ * @return The tree
+ */
+BarnesHutTree *constructBarnesHutTree()
+{
+	return new BarnesHutTree();
+}
+
+/**
+ * @brief Destroys a Barnes-Hut tree
+ * @param tree The tree
+ */
+void destroyBarnesHutTree(BarnesHutTree *tree)
+{
+	delete tree;
+}
+
+/**
+ * @brief Octant of a point: bit 2 for upper x, bit 1 for upper y, bit 0 for upper z
+ */
+static int getOctant(bool upperX, bool upperY, bool upperZ)
+{
+	return (upperX << 2) | (upperY << 1) | upperZ;
+}
+
+/**
+ * @brief Fills in mass and center of mass of an internal node from its children
+ */
+static void sumChildren(BarnesHutNode *node, const std::vector<BarnesHutNode> &nodes, float centerX, float centerY, float centerZ)
+{
+	double mass = 0, momentX = 0, momentY = 0, momentZ = 0;
+
+	for (int o = 0; o < 8; o++)
+	{
+		if (node->child[o] >= 0)
+		{
+			const BarnesHutNode &child = nodes[node->child[o]];
+
+			mass += child.mass;
+			momentX += (double)child.mass * child.comX;
+			momentY += (double)child.mass * child.comY;
+			momentZ += (double)child.mass * child.comZ;
+		}
+	}
+
+	node->mass = (float)mass;
+	node->comX = (mass > 0) ? (float)(momentX / mass) : centerX;
+	node->comY = (mass > 0) ? (float)(momentY / mass) : centerY;
+	node->comZ = (mass > 0) ? (float)(momentZ / mass) : centerZ;
+}
+
+/**
+ * @brief Recursively builds the subtree of the bodies in order[first, first + count)
+ * @return Index of the subtree root in nodes
+ */
+template <typename position_t>
+static int buildNode(const BarnesHutInput<position_t> &in, std::vector<BarnesHutNode> &nodes,
+					 unsigned int first, unsigned int count,
+					 float centerX, float centerY, float centerZ, float size, int depth)
+{
+	int index = (int)nodes.size();
+	nodes.push_back(BarnesHutNode());
+
+	// Filled locally: nodes may be reallocated while building the children
+	BarnesHutNode node;
+	node.size = size;
+	node.first = first;
+	node.count = 0;
+	std::fill(node.child, node.child + 8, -1);
+
+	if (count <= BARNES_HUT_LEAF_SIZE || depth >= BARNES_HUT_MAX_DEPTH)
+	{
+		double mass = 0, momentX = 0, momentY = 0, momentZ = 0;
+
+		for (unsigned int k = first; k < first + count; k++)
+		{
+			unsigned int j = in.order[k];
+
+			mass += in.mass[j];
+			momentX += (double)in.mass[j] * in.posX[j];
+			momentY += (double)in.mass[j] * in.posY[j];
+			momentZ += (double)in.mass[j] * in.posZ[j];
+		}
+
+		node.count = count;
+		node.mass = (float)mass;
+		node.comX = (mass > 0) ? (float)(momentX / mass) : centerX;
+		node.comY = (mass > 0) ? (float)(momentY / mass) : centerY;
+		node.comZ = (mass > 0) ? (float)(momentZ / mass) : centerZ;
+	}
+	else
+	{
+		// Split the range in octants: by x, then each half by y, then each quarter by z
+		unsigned int *bounds[9];
+		bounds[0] = in.order + first;
+		bounds[8] = in.order + first + count;
+		bounds[4] = std::partition(bounds[0], bounds[8], [&](unsigned int j)
+								   { return in.posX[j] < centerX; });
+
+		for (int h = 0; h < 8; h += 4)
+			bounds[h + 2] = std::partition(bounds[h], bounds[h + 4], [&](unsigned int j)
+										   { return in.posY[j] < centerY; });
+
+		for (int q = 0; q < 8; q += 2)
+			bounds[q + 1] = std::partition(bounds[q], bounds[q + 2], [&](unsigned int j)
+										   { return in.posZ[j] < centerZ; });
+
+		float quarter = size * 0.25F;
+
+		for (int o = 0; o < 8; o++)
+		{
+			unsigned int childCount = (unsigned int)(bounds[o + 1] - bounds[o]);
+
+			if (childCount)
+			{
+				node.child[o] = buildNode(in, nodes, (unsigned int)(bounds[o] - in.order), childCount,
+										  centerX + ((o & 4) ? quarter : -quarter),
+										  centerY + ((o & 2) ? quarter : -quarter),
+										  centerZ + ((o & 1) ? quarter : -quarter),
+										  size * 0.5F, depth + 1);
+			}
+		}
+
+		sumChildren(&node, nodes, centerX, centerY, centerZ);
+	}
+
+	nodes[index] = node;
+
+	return index;
+}
+
+/**
+ * @brief Rebuilds the tree for the current body positions
+ */
+template <typename position_t>
+static void buildBarnesHutTree(BarnesHutTree *tree, JobSystem *jobSystem, const BarnesHutInput<position_t> &baseInput, unsigned int bodyCount,
+							   float *rootX, float *rootY, float *rootZ, float *rootSize)
+{
+	unsigned int chunkCount = (bodyCount + BARNES_HUT_SORT_CHUNK - 1) / BARNES_HUT_SORT_CHUNK;
+
+	tree->order.resize(bodyCount);
+	tree->cell.resize(bodyCount);
+	tree->chunkOffsets.assign(chunkCount * BARNES_HUT_CELLS, 0);
+
+	BarnesHutInput<position_t> in = baseInput;
+	in.order = tree->order.data();
+
+	// Bounding box, reduced per chunk
+	std::vector<float> chunkBounds(chunkCount * 6);
+
+	parallelFor(jobSystem, 0, chunkCount, 1, [&](unsigned int begin, unsigned int end)
+				{
+					for (unsigned int c = begin; c < end; c++)
+					{
+						float *bounds = &chunkBounds[c * 6];
+						unsigned int last = std::min(bodyCount, (c + 1) * BARNES_HUT_SORT_CHUNK);
+
+						bounds[0] = bounds[1] = bounds[2] = INFINITY;
+						bounds[3] = bounds[4] = bounds[5] = -INFINITY;
+
+						for (unsigned int i = c * BARNES_HUT_SORT_CHUNK; i < last; i++)
+						{
+							bounds[0] = std::min(bounds[0], (float)in.posX[i]);
+							bounds[1] = std::min(bounds[1], (float)in.posY[i]);
+							bounds[2] = std::min(bounds[2], (float)in.posZ[i]);
+							bounds[3] = std::max(bounds[3], (float)in.posX[i]);
+							bounds[4] = std::max(bounds[4], (float)in.posY[i]);
+							bounds[5] = std::max(bounds[5], (float)in.posZ[i]);
+						}
+					} });
+
+	float minX = INFINITY, minY = INFINITY, minZ = INFINITY;
+	float maxX = -INFINITY, maxY = -INFINITY, maxZ = -INFINITY;
+
+	for (unsigned int c = 0; c < chunkCount; c++)
+	{
+		minX = std::min(minX, chunkBounds[c * 6 + 0]);
+		minY = std::min(minY, chunkBounds[c * 6 + 1]);
+		minZ = std::min(minZ, chunkBounds[c * 6 + 2]);
+		maxX = std::max(maxX, chunkBounds[c * 6 + 3]);
+		maxY = std::max(maxY, chunkBounds[c * 6 + 4]);
+		maxZ = std::max(maxZ, chunkBounds[c * 6 + 5]);
+	}
+
+	// Slightly enlarged so the bodies on the upper faces still fall inside
+	float size = std::max(maxX - minX, std::max(maxY - minY, maxZ - minZ)) * 1.001F + 1.0F;
+	float cellSize = size / BARNES_HUT_CELLS_PER_AXIS;
+
+	*rootX = minX + size * 0.5F;
+	*rootY = minY + size * 0.5F;
+	*rootZ = minZ + size * 0.5F;
+	*rootSize = size;
+
+	// Bucket bodies into the top level cells (parallel counting sort, stable per chunk)
+	parallelFor(jobSystem, 0, chunkCount, 1, [&](unsigned int begin, unsigned int end)
+				{
+					for (unsigned int c = begin; c < end; c++)
+					{
+						unsigned int *histogram = &tree->chunkOffsets[c * BARNES_HUT_CELLS];
+						unsigned int last = std::min(bodyCount, (c + 1) * BARNES_HUT_SORT_CHUNK);
+
+						for (unsigned int i = c * BARNES_HUT_SORT_CHUNK; i < last; i++)
+						{
+							int ix = std::min(BARNES_HUT_CELLS_PER_AXIS - 1, (int)((in.posX[i] - minX) / cellSize));
+							int iy = std::min(BARNES_HUT_CELLS_PER_AXIS - 1, (int)((in.posY[i] - minY) / cellSize));
+							int iz = std::min(BARNES_HUT_CELLS_PER_AXIS - 1, (int)((in.posZ[i] - minZ) / cellSize));
+
+							int cell = getOctant(ix >> 1, iy >> 1, iz >> 1) * 8 + getOctant(ix & 1, iy & 1, iz & 1);
+
+							tree->cell[i] = (unsigned char)cell;
+							histogram[cell]++;
+						}
+					} });
+
+	unsigned int cellFirst[BARNES_HUT_CELLS];
+	unsigned int cellCount[BARNES_HUT_CELLS];
+	unsigned int running = 0;
+
+	for (int cell = 0; cell < BARNES_HUT_CELLS; cell++)
+	{
+		cellFirst[cell] = running;
+
+		for (unsigned int c = 0; c < chunkCount; c++)
+		{
+			unsigned int count = tree->chunkOffsets[c * BARNES_HUT_CELLS + cell];
+
+			tree->chunkOffsets[c * BARNES_HUT_CELLS + cell] = running;
+			running += count;
+		}
+
+		cellCount[cell] = running - cellFirst[cell];
+	}
+
+	parallelFor(jobSystem, 0, chunkCount, 1, [&](unsigned int begin, unsigned int end)
+				{
+					for (unsigned int c = begin; c < end; c++)
+					{
+						unsigned int *offsets = &tree->chunkOffsets[c * BARNES_HUT_CELLS];
+						unsigned int last = std::min(bodyCount, (c + 1) * BARNES_HUT_SORT_CHUNK);
+
+						for (unsigned int i = c * BARNES_HUT_SORT_CHUNK; i < last; i++)
+							in.order[offsets[tree->cell[i]]++] = i;
+					} });
+
+	// One subtree per cell
+	parallelFor(jobSystem, 0, BARNES_HUT_CELLS, 1, [&](unsigned int begin, unsigned int end)
+				{
+					for (unsigned int cell = begin; cell < end; cell++)
+					{
+						tree->cellNodes[cell].clear();
+
+						if (cellCount[cell])
+						{
+							int o1 = cell / 8;
+							int o2 = cell % 8;
+							int ix = ((o1 >> 2) & 1) * 2 + ((o2 >> 2) & 1);
+							int iy = ((o1 >> 1) & 1) * 2 + ((o2 >> 1) & 1);
+							int iz = (o1 & 1) * 2 + (o2 & 1);
+
+							buildNode(in, tree->cellNodes[cell], cellFirst[cell], cellCount[cell],
+									  minX + (ix + 0.5F) * cellSize,
+									  minY + (iy + 0.5F) * cellSize,
+									  minZ + (iz + 0.5F) * cellSize,
+									  cellSize, 2);
+						}
+					} });
+
+	// Stitch: root at 0, first level at 1..8, then every subtree
+	unsigned int cellBase[BARNES_HUT_CELLS];
+	unsigned int nodeCount = 9;
+
+	for (int cell = 0; cell < BARNES_HUT_CELLS; cell++)
+	{
+		cellBase[cell] = nodeCount;
+		nodeCount += (unsigned int)tree->cellNodes[cell].size();
+	}
+
+	tree->nodes.resize(nodeCount);
+
+	parallelFor(jobSystem, 0, BARNES_HUT_CELLS, 1, [&](unsigned int begin, unsigned int end)
+				{
+					for (unsigned int cell = begin; cell < end; cell++)
+					{
+						const std::vector<BarnesHutNode> &local = tree->cellNodes[cell];
+
+						for (size_t k = 0; k < local.size(); k++)
+						{
+							BarnesHutNode node = local[k];
+
+							for (int o = 0; o < 8; o++)
+							{
+								if (node.child[o] >= 0)
+									node.child[o] += cellBase[cell];
+							}
+
+							tree->nodes[cellBase[cell] + k] = node;
+						}
+					} });
+
+	float half = size * 0.5F;
+	float quarter = size * 0.25F;
+
+	for (int o1 = 0; o1 < 8; o1++)
+	{
+		BarnesHutNode &node = tree->nodes[1 + o1];
+
+		node.size = half;
+		node.first = 0;
+		node.count = 0;
+
+		for (int o2 = 0; o2 < 8; o2++)
+			node.child[o2] = tree->cellNodes[o1 * 8 + o2].empty() ? -1 : (int)cellBase[o1 * 8 + o2];
+
+		sumChildren(&node, tree->nodes,
+					*rootX + ((o1 & 4) ? quarter : -quarter),
+					*rootY + ((o1 & 2) ? quarter : -quarter),
+					*rootZ + ((o1 & 1) ? quarter : -quarter));
+	}
+
+	BarnesHutNode &root = tree->nodes[0];
+
+	root.size = size;
+	root.first = 0;
+	root.count = 0;
+
+	for (int o1 = 0; o1 < 8; o1++)
+		root.child[o1] = (tree->nodes[1 + o1].mass > 0) ? 1 + o1 : -1;
+
+	sumChildren(&root, tree->nodes, *rootX, *rootY, *rootZ);
+}
+
+/**
+ * @brief Walks the tree to get the acceleration on body i
+ *
+ * Offsets to the bodies of a leaf are taken at position precision; nodes only
+ * store a float center of mass, which is plenty for the far field.
+ */
+template <typename position_t, typename acceleration_t>
+static void walkBarnesHutTree(const BarnesHutTree *tree, const BarnesHutInput<position_t> &in, unsigned int i, float theta2,
+							  acceleration_t *accX, acceleration_t *accY, acceleration_t *accZ)
+{
+	position_t px = in.posX[i];
+	position_t py = in.posY[i];
+	position_t pz = in.posZ[i];
+	acceleration_t ax = 0, ay = 0, az = 0;
+
+	int stack[BARNES_HUT_STACK_SIZE];
+	int top = 0;
+
+	stack[top++] = 0;
+
+	while (top)
+	{
+		const BarnesHutNode &node = tree->nodes[stack[--top]];
+
+		if (node.mass <= 0)
+			continue;
+
+		if (node.count)
+		{
+			// Leaf: direct sum over its bodies
+			for (unsigned int k = node.first; k < node.first + node.count; k++)
+			{
+				unsigned int j = in.order[k];
+
+				acceleration_t dx = (acceleration_t)(in.posX[j] - px);
+				acceleration_t dy = (acceleration_t)(in.posY[j] - py);
+				acceleration_t dz = (acceleration_t)(in.posZ[j] - pz);
+				acceleration_t r2 = dx * dx + dy * dy + dz * dz;
+
+				if (j != i && r2 > 0)
+				{
+					acceleration_t inv = 1 / std::sqrt(r2);
+					acceleration_t factor = (in.mass[j] * inv) * (inv * inv);
+
+					ax += dx * factor;
+					ay += dy * factor;
+					az += dz * factor;
+				}
+			}
+
+			continue;
+		}
+
+		acceleration_t dx = (acceleration_t)(node.comX - px);
+		acceleration_t dy = (acceleration_t)(node.comY - py);
+		acceleration_t dz = (acceleration_t)(node.comZ - pz);
+		acceleration_t r2 = dx * dx + dy * dy + dz * dz;
+
+		if (node.size * node.size < theta2 * r2)
+		{
+			// Far enough: the whole node acts as a single body
+			acceleration_t inv = 1 / std::sqrt(r2);
+			acceleration_t factor = (node.mass * inv) * (inv * inv);
+
+			ax += dx * factor;
+			ay += dy * factor;
+			az += dz * factor;
+		}
+		else
+		{
+			for (int o = 0; o < 8; o++)
+			{
+				if (node.child[o] >= 0)
+					stack[top++] = node.child[o];
+			}
+		}
+	}
+
+	*accX = GRAVITATIONAL_CONSTANT * ax;
+	*accY = GRAVITATIONAL_CONSTANT * ay;
+	*accZ = GRAVITATIONAL_CONSTANT * az;
+}
+
+/**
+ * @brief Computes the gravitational acceleration on every body with a Barnes-Hut tree
+ *
+ * @param tree Tree storage, reused between calls
+ * @param jobSystem Workers to split the build and the walk across
+ * @param posX, posY, posZ Body positions
+ * @param mass Body masses
+ * @param bodyCount Number of bodies
+ * @param openingAngle Theta: nodes seen under a smaller size / distance ratio are not opened
+ * @param accX, accY, accZ Output accelerations
+ */
+template <typename position_t, typename acceleration_t>
+void computeBarnesHutAccelerations(BarnesHutTree *tree, JobSystem *jobSystem,
+								   const position_t *posX, const position_t *posY, const position_t *posZ, const float *mass,
+								   unsigned int bodyCount, float openingAngle,
+								   acceleration_t *accX, acceleration_t *accY, acceleration_t *accZ)
+{
+	if (!bodyCount)
+		return;
+
+	BarnesHutInput<position_t> in = {posX, posY, posZ, mass, NULL};
+	float rootX, rootY, rootZ, rootSize;
+
+	buildBarnesHutTree(tree, jobSystem, in, bodyCount, &rootX, &rootY, &rootZ, &rootSize);
+
+	in.order = tree->order.data();
+	float theta2 = openingAngle * openingAngle;
+
+	// Walk in tree order so neighbouring jobs touch neighbouring nodes
+	parallelFor(jobSystem, 0, bodyCount, BARNES_HUT_BODIES_PER_JOB, [&](unsigned int begin, unsigned int end)
+				{
+					for (unsigned int k = begin; k < end; k++)
+					{
+						unsigned int i = in.order[k];
+
+						walkBarnesHutTree(tree, in, i, theta2, &accX[i], &accY[i], &accZ[i]);
+					} });
+}
+
+// One instance per precision_type_t
+template void computeBarnesHutAccelerations(BarnesHutTree *, JobSystem *, const float *, const float *, const float *, const float *,
+											unsigned int, float, float *, float *, float *);
+template void computeBarnesHutAccelerations(BarnesHutTree *, JobSystem *, const double *, const double *, const double *, const float *,
+											unsigned int, float, float *, float *, float *);
+template void computeBarnesHutAccelerations(BarnesHutTree *, JobSystem *, const double *, const double *, const double *, const float *,
+											unsigned int, float, double *, double *, double *);
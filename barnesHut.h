@@ -0,0 +1,26 @@
+/**
+ * @brief Barnes-Hut octree for all-body gravity
+ * @author Mariano Caceres Smoler
+ * @author Enzo Nicolas Rosa Fernandez
+ * @author Francisco Chiusaroli
+ */
+
+#ifndef BARNESHUT_H
+#define BARNESHUT_H
+
+#include "jobSystem.h"
+
+struct BarnesHutTree;
+
+BarnesHutTree *constructBarnesHutTree();
+
+void destroyBarnesHutTree(BarnesHutTree *tree);
+
+// Instantiated for float, mixed and double precision (see precision_type_t)
+template <typename position_t, typename acceleration_t>
+void computeBarnesHutAccelerations(BarnesHutTree *tree, JobSystem *jobSystem,
+								   const position_t *posX, const position_t *posY, const position_t *posZ, const float *mass,
+								   unsigned int bodyCount, float openingAngle,
+								   acceleration_t *accX, acceleration_t *accY, acceleration_t *accZ);
+
+#endif
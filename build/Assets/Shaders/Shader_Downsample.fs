@@ -0,0 +1,20 @@
+#version 330 core
+
+in vec2 fragTexCoord;
+in vec4 fragColor;
+
+uniform sampler2D texture0;
+uniform vec2 texelSize; // Of the source texture
+
+out vec4 finalColor;
+
+void main()
+{
+    // Quarter resolution: 4 bilinear samples, each between 2x2 texels, average the 4x4 block
+    vec3 color = texture(texture0, fragTexCoord + vec2(-1.0, -1.0) * texelSize).rgb;
+    color += texture(texture0, fragTexCoord + vec2(1.0, -1.0) * texelSize).rgb;
+    color += texture(texture0, fragTexCoord + vec2(-1.0, 1.0) * texelSize).rgb;
+    color += texture(texture0, fragTexCoord + vec2(1.0, 1.0) * texelSize).rgb;
+
+    finalColor = vec4(color * 0.25, 1.0);
+}
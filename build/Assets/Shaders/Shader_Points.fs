@@ -0,0 +1,10 @@
+#version 330 core
+
+in vec4 fragColor;
+
+out vec4 finalColor;
+
+void main()
+{
+    finalColor = fragColor;
+}
@@ -0,0 +1,25 @@
+#version 330 core
+
+// One quad per point: the corner is per vertex, the point is per instance
+in vec2 vertexCorner;
+in vec3 pointPosition;
+in vec4 pointColor;
+
+uniform mat4 mvp;
+uniform vec2 viewportSize; // Pixels
+uniform float pointSize;   // Pixels at a distance of one unit
+
+out vec4 fragColor;
+
+void main()
+{
+    vec4 center = mvp * vec4(pointPosition, 1.0);
+
+    // Size attenuation: smaller with distance, but never under a pixel
+    float size = max(pointSize / center.w, 1.0);
+
+    center.xy += vertexCorner * size / viewportSize * center.w;
+
+    fragColor = pointColor;
+    gl_Position = center;
+}
@@ -0,0 +1,417 @@
+/**
+ * @brief Binary checkpoints of the orbital simulation
+ * @author Mariano Caceres Smoler
+ * @author Enzo Nicolas Rosa Fernandez
+ * @author Francisco Chiusaroli
+ *
+ * A checkpoint holds everything a run needs to continue exactly where it was:
+ * the time, the integrator and block timestep state, and the body arrays of
+ * the current precision. The accelerations are only stored while they are
+ * valid. Diagnostics are not stored: enabling them takes a new reference anyway.
+ *
+ * Saving copies the simulation into an image of the file, which is all the
+ * simulation waits for, and writes the image on a background thread. The file
+ * is written under a temporary name and renamed when complete, so a crash while
+ * writing keeps the previous checkpoint. Loading maps the file and copies every
+ * array straight into a simulation allocated with the stored shape.
+ *
+ * Layout, in native byte order:
+ *   CheckpointHeader
+ *   positionX, positionY, positionZ, velocityX, velocityY, velocityZ
+ *   accelerationX, accelerationY, accelerationZ, if accelerationsType is set
+ *   mass, initialPosition, radius, color, chunkLevel
+ * Every array starts on a CHECKPOINT_ALIGNMENT boundary, padded with zeros.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "checkpoint.h"
+#include "mappedFile.h"
+
+#define CHECKPOINT_MAGIC 0x5043534F // "OSCP" in little endian, so other byte orders are rejected
+#define CHECKPOINT_VERSION 3
+#define CHECKPOINT_ALIGNMENT 64
+#define CHECKPOINT_MAX_ARRAYS 14
+#define CHECKPOINT_COPY_BLOCK (1 << 20) // Bytes copied by each job
+#define CHECKPOINT_TEMPORARY_EXTENSION ".tmp"
+
+struct CheckpointHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint64_t fileSize;
+
+	uint32_t bodyCount;
+	uint32_t starSystemCount;
+	uint32_t precision;	   // precision_type_t
+	uint32_t integrator;	   // integrator_type_t
+	int32_t accelerationsType; // logical_sim_type_t
+	int32_t blockSimType;	   // logical_sim_type_t
+	uint32_t blockStep;
+	float openingAngle;
+
+	double timeStep;
+	double totalTime;
+};
+
+static_assert(sizeof(CheckpointHeader) <= CHECKPOINT_ALIGNMENT, "the first array would overlap the header");
+
+/**
+ * @brief An array of the simulation, as stored in the checkpoint
+ */
+struct CheckpointArray
+{
+	void *data;
+	size_t size; // Bytes
+	size_t offset;
+};
+
+struct CheckpointWriter
+{
+	std::thread thread;
+	std::atomic<bool> busy;
+	bool succeeded; // Of the last write, read after joining
+
+	std::vector<unsigned char> image; // Of the file, reused between checkpoints
+	std::string fileName;
+};
+
+/**
+ * @brief Rounds a file offset up to the alignment of the arrays
+ */
+static size_t alignOffset(size_t offset)
+{
+	return (offset + CHECKPOINT_ALIGNMENT - 1) & ~(size_t)(CHECKPOINT_ALIGNMENT - 1);
+}
+
+/**
+ * @brief Lists the hot arrays of a precision
+ * @return Number of arrays listed
+ */
+template <typename position_t, typename velocity_t>
+static int getStateArrays(BodyState<position_t, velocity_t> *state, unsigned int bodyCount, bool accelerations,
+						  CheckpointArray *arrays)
+{
+	void *positions[] = {state->positionX, state->positionY, state->positionZ};
+	void *velocities[] = {state->velocityX, state->velocityY, state->velocityZ};
+	void *accelerationArrays[] = {state->accelerationX, state->accelerationY, state->accelerationZ};
+	int count = 0;
+
+	for (int axis = 0; axis < 3; axis++)
+		arrays[count++] = {positions[axis], bodyCount * sizeof(position_t), 0};
+
+	for (int axis = 0; axis < 3; axis++)
+		arrays[count++] = {velocities[axis], bodyCount * sizeof(velocity_t), 0};
+
+	for (int axis = 0; accelerations && axis < 3; axis++)
+		arrays[count++] = {accelerationArrays[axis], bodyCount * sizeof(velocity_t), 0};
+
+	return count;
+}
+
+/**
+ * @brief Lists the arrays a checkpoint of a simulation stores, and where
+ *
+ * Only the shape of the simulation is needed for the sizes and offsets: the
+ * data pointers are NULL for a simulation that was not allocated.
+ *
+ * @param sim The orbital simulation
+ * @param arrays Filled in, CHECKPOINT_MAX_ARRAYS at most
+ * @param arrayCount Filled in with the number of arrays
+ * @return Size of the whole checkpoint file
+ */
+static size_t getCheckpointArrays(OrbitalSim *sim, CheckpointArray *arrays, int *arrayCount)
+{
+	OrbitalBodies *bodies = &sim->bodiesList;
+	unsigned int bodyCount = sim->bodyCount;
+	bool accelerations = (sim->accelerationsType != LOGIC_STANDBY);
+	int count;
+
+	switch (bodies->precision)
+	{
+	case PRECISION_MIXED:
+		count = getStateArrays(&bodies->mixedState, bodyCount, accelerations, arrays);
+		break;
+	case PRECISION_DOUBLE:
+		count = getStateArrays(&bodies->doubleState, bodyCount, accelerations, arrays);
+		break;
+	default:
+		count = getStateArrays(&bodies->floatState, bodyCount, accelerations, arrays);
+		break;
+	}
+
+	arrays[count++] = {bodies->mass, bodyCount * sizeof(float), 0};
+	arrays[count++] = {bodies->initialPosition, bodyCount * sizeof(Vector3), 0};
+	arrays[count++] = {bodies->radius, bodyCount * sizeof(float), 0};
+	arrays[count++] = {bodies->color, bodyCount * sizeof(Color), 0};
+	arrays[count++] = {sim->chunkLevel, getOrbitalSimChunkCount(sim) * sizeof(unsigned char), 0};
+
+	size_t offset = alignOffset(sizeof(CheckpointHeader));
+
+	for (int i = 0; i < count; i++)
+	{
+		arrays[i].offset = offset;
+		offset = alignOffset(offset + arrays[i].size);
+	}
+
+	*arrayCount = count;
+
+	return offset;
+}
+
+/**
+ * @brief Copies memory in blocks spread across the job system
+ */
+static void copyInParallel(JobSystem *jobSystem, void *to, const void *from, size_t size)
+{
+	unsigned int blockCount = (unsigned int)((size + CHECKPOINT_COPY_BLOCK - 1) / CHECKPOINT_COPY_BLOCK);
+
+	parallelFor(jobSystem, 0, blockCount, 1, [=](unsigned int begin, unsigned int end)
+				{
+					size_t first = (size_t)begin * CHECKPOINT_COPY_BLOCK;
+					size_t last = std::min(size, (size_t)end * CHECKPOINT_COPY_BLOCK);
+
+					memcpy((unsigned char *)to + first, (const unsigned char *)from + first, last - first);
+				});
+}
+
+/**
+ * @brief Writes the image of a checkpoint, on the writer thread
+ */
+static void writeCheckpointFile(CheckpointWriter *writer)
+{
+	std::string temporaryName = writer->fileName + CHECKPOINT_TEMPORARY_EXTENSION;
+	FILE *file = fopen(temporaryName.c_str(), "wb");
+	bool succeeded = false;
+
+	if (file)
+	{
+		succeeded = (fwrite(writer->image.data(), 1, writer->image.size(), file) == writer->image.size());
+		succeeded = !fclose(file) && succeeded;
+
+#if defined(_WIN32)
+		// rename does not replace existing files on Windows
+		if (succeeded)
+			remove(writer->fileName.c_str());
+#endif
+
+		succeeded = succeeded && !rename(temporaryName.c_str(), writer->fileName.c_str());
+
+		if (!succeeded)
+			remove(temporaryName.c_str());
+	}
+
+	writer->succeeded = succeeded;
+	writer->busy = false;
+}
+
+/**
+ * @brief Constructs a writer of checkpoints
+ * @return The checkpoint writer
+ */
+CheckpointWriter *constructCheckpointWriter()
+{
+	CheckpointWriter *writer = new CheckpointWriter();
+
+	writer->busy = false;
+	writer->succeeded = true;
+
+	return writer;
+}
+
+/**
+ * @brief Waits for the checkpoint being written, if any, and destroys the writer
+ * @param writer The checkpoint writer
+ */
+void destroyCheckpointWriter(CheckpointWriter *writer)
+{
+	waitCheckpointWriter(writer);
+
+	delete writer;
+}
+
+/**
+ * @brief Starts saving a checkpoint of a simulation
+ *
+ * The simulation is copied before returning, so it can keep stepping while
+ * the file is written.
+ *
+ * @param writer The checkpoint writer
+ * @param sim The orbital simulation
+ * @param fileName The checkpoint file, replaced when complete
+ * @return Whether the checkpoint was started; false while the previous one is still being written
+ */
+bool saveOrbitalSimCheckpoint(CheckpointWriter *writer, const OrbitalSim *sim, const char *fileName)
+{
+	if (writer->busy)
+		return false;
+
+	if (writer->thread.joinable())
+		writer->thread.join();
+
+	CheckpointArray arrays[CHECKPOINT_MAX_ARRAYS];
+	int arrayCount;
+
+	// Only read from
+	size_t fileSize = getCheckpointArrays(const_cast<OrbitalSim *>(sim), arrays, &arrayCount);
+
+	writer->image.resize(fileSize);
+
+	unsigned char *image = writer->image.data();
+	CheckpointHeader header = {};
+
+	header.magic = CHECKPOINT_MAGIC;
+	header.version = CHECKPOINT_VERSION;
+	header.fileSize = fileSize;
+	header.bodyCount = sim->bodyCount;
+	header.starSystemCount = sim->starSystemCount;
+	header.precision = (uint32_t)sim->bodiesList.precision;
+	header.integrator = (uint32_t)sim->integrator;
+	header.accelerationsType = sim->accelerationsType;
+	header.blockSimType = sim->blockSimType;
+	header.blockStep = sim->blockStep;
+	header.timeStep = sim->timeStep;
+	header.totalTime = sim->totalTime;
+	header.openingAngle = sim->openingAngle;
+
+	memset(image, 0, arrays[0].offset);
+	memcpy(image, &header, sizeof(header));
+
+	for (int i = 0; i < arrayCount; i++)
+	{
+		size_t end = arrays[i].offset + arrays[i].size;
+		size_t next = (i + 1 < arrayCount) ? arrays[i + 1].offset : fileSize;
+
+		copyInParallel(sim->jobSystem, image + arrays[i].offset, arrays[i].data, arrays[i].size);
+		memset(image + end, 0, next - end);
+	}
+
+	writer->fileName = fileName;
+	writer->busy = true;
+	writer->thread = std::thread(writeCheckpointFile, writer);
+
+	return true;
+}
+
+/**
+ * @brief Waits for the checkpoint being written, if any
+ * @param writer The checkpoint writer
+ * @return Whether the last checkpoint was written
+ */
+bool waitCheckpointWriter(CheckpointWriter *writer)
+{
+	if (writer->thread.joinable())
+		writer->thread.join();
+
+	return writer->succeeded;
+}
+
+/**
+ * @brief Checks that a header describes a simulation this build can run
+ */
+static bool isCheckpointHeaderValid(const CheckpointHeader *header, size_t fileSize)
+{
+	return header->magic == CHECKPOINT_MAGIC &&
+		   header->version == CHECKPOINT_VERSION &&
+		   header->fileSize == fileSize &&
+		   header->starSystemCount > 0 && header->starSystemCount <= STAR_SYSTEM_MAX_BODYNUM &&
+		   header->starSystemCount <= header->bodyCount &&
+		   header->precision < PRECISION_TYPE_COUNT &&
+		   header->integrator < INTEGRATOR_TYPE_COUNT &&
+		   header->accelerationsType >= LOGIC_STANDBY && header->accelerationsType < LOGIC_TYPE_COUNT &&
+		   header->blockSimType >= LOGIC_STANDBY && header->blockSimType < LOGIC_TYPE_COUNT &&
+		   header->blockStep < 1U << (BLOCK_LEVEL_COUNT - 1) &&
+		   header->timeStep > 0;
+}
+
+/**
+ * @brief Checks that the asteroid chunks of a checkpoint are on step levels the simulation has
+ *
+ * @param chunkLevel The levels, as stored
+ * @param size How many there are
+ * @return Whether all of them are in range
+ */
+static bool areCheckpointChunkLevelsValid(const unsigned char *chunkLevel, size_t size)
+{
+	for (size_t i = 0; i < size; i++)
+	{
+		if (chunkLevel[i] >= BLOCK_LEVEL_COUNT)
+			return false;
+	}
+
+	return true;
+}
+
+/**
+ * @brief Restores a simulation from a checkpoint
+ *
+ * @param fileName The checkpoint file
+ * @return The orbital simulation, as it was when saved; NULL if the file is
+ *         missing, damaged or from another version
+ */
+OrbitalSim *loadOrbitalSimCheckpoint(const char *fileName)
+{
+	MappedFile *mappedFile = constructMappedFile(fileName);
+
+	if (!mappedFile)
+		return NULL;
+
+	CheckpointHeader header;
+
+	if (mappedFile->size < sizeof(header))
+	{
+		destroyMappedFile(mappedFile);
+
+		return NULL;
+	}
+
+	memcpy(&header, mappedFile->data, sizeof(header));
+
+	// The layout follows from the shape alone, so a bad file is caught before allocating
+	OrbitalSim shape = OrbitalSim();
+	CheckpointArray arrays[CHECKPOINT_MAX_ARRAYS];
+	int arrayCount;
+
+	shape.bodyCount = header.bodyCount;
+	shape.starSystemCount = header.starSystemCount;
+	shape.bodiesList.precision = (int)header.precision;
+	shape.accelerationsType = header.accelerationsType;
+
+	// The chunk levels are the last array
+	if (!isCheckpointHeaderValid(&header, mappedFile->size) ||
+		getCheckpointArrays(&shape, arrays, &arrayCount) != mappedFile->size ||
+		!areCheckpointChunkLevelsValid(mappedFile->data + arrays[arrayCount - 1].offset, arrays[arrayCount - 1].size))
+	{
+		destroyMappedFile(mappedFile);
+
+		return NULL;
+	}
+
+	OrbitalSim *sim = allocateOrbitalSim(header.timeStep, header.starSystemCount, header.bodyCount, (int)header.precision);
+
+	if (sim)
+	{
+		sim->totalTime = header.totalTime;
+		sim->openingAngle = header.openingAngle;
+		sim->integrator = (int)header.integrator;
+		sim->accelerationsType = header.accelerationsType;
+		sim->blockSimType = header.blockSimType;
+		sim->blockStep = header.blockStep;
+
+		getCheckpointArrays(sim, arrays, &arrayCount);
+
+		for (int i = 0; i < arrayCount; i++)
+			copyInParallel(sim->jobSystem, arrays[i].data, mappedFile->data + arrays[i].offset, arrays[i].size);
+	}
+
+	destroyMappedFile(mappedFile);
+
+	return sim;
+}
@@ -0,0 +1,25 @@
+/**
+ * @brief Binary checkpoints of the orbital simulation
+ * @author Mariano Caceres Smoler
+ * @author Enzo Nicolas Rosa Fernandez
+ * @author Francisco Chiusaroli
+ */
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include "orbitalSim.h"
+
+struct CheckpointWriter;
+
+CheckpointWriter *constructCheckpointWriter();
+
+void destroyCheckpointWriter(CheckpointWriter *writer);
+
+bool saveOrbitalSimCheckpoint(CheckpointWriter *writer, const OrbitalSim *sim, const char *fileName);
+
+bool waitCheckpointWriter(CheckpointWriter *writer);
+
+OrbitalSim *loadOrbitalSimCheckpoint(const char *fileName);
+
+#endif
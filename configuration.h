@@ -12,10 +12,14 @@
 #include <raylib.h>
 #include <vector>
 
+struct AssetRegistry;
+struct PendingAssets; // Decoded in the background, see menu.cpp
+
 
 
 //Constant definitions and macros
 #define NORM(x, y, z) (sqrt(((x) * (x)) + ((y) * (y)) + ((z) * (z))))
+#define GRAVITATIONAL_CONSTANT 6.6743E-11
 
 // Macros for resources locations
 #define ASSETS_SOURCE(x) "./Assets/" x
@@ -26,6 +30,10 @@
 
 #define TYPE_COUNTER 3	   // Times that the typewriter audio is loaded
 #define GRID_SLOTS_COUNT 8 // Number of slots in the visual grid
+#define ASTEROID_MODEL_COUNT 4 // Asteroid meshes, assigned round robin
+#define BLUR_DOWNSAMPLE 4 // Divisor of the monitor resolution for the blur passes
+#define CHECKPOINT_FILE "orbitalSim.checkpoint" // Saved with F5, resumed from on startup
+#define TRAJECTORY_FILE "orbitalSim.trajectory" // Recorded while F6 is on
 
 // Enums/Ids for the visual and logical state of the simulations
 enum visual_sim_type_t
@@ -39,7 +47,37 @@ enum logical_sim_type_t
 {
 	LOGIC_STANDBY = -1,
 	GRAVITATIONAL_SIMULATION,
-	SPRINGS_SIMULATION
+	DIRECT_GRAVITY_SIMULATION,
+	SPRINGS_SIMULATION,
+	BARNES_HUT_SIMULATION,
+	LOGIC_TYPE_COUNT
+};
+
+// Time integration schemes for the logical simulation
+enum integrator_type_t
+{
+	INTEGRATOR_EULER,
+	INTEGRATOR_LEAPFROG,
+	INTEGRATOR_YOSHIDA4,
+	INTEGRATOR_FOREST_RUTH,
+	INTEGRATOR_TYPE_COUNT
+};
+
+// Scalar types of the simulation core: position / velocity
+enum precision_type_t
+{
+	PRECISION_FLOAT,  // float / float: widest SIMD
+	PRECISION_MIXED,  // double / float: positions keep their resolution far from the sun
+	PRECISION_DOUBLE, // double / double: for long runs
+	PRECISION_TYPE_COUNT
+};
+
+// Built-in star systems, see ephemerides.h
+enum star_system_type_t
+{
+	STAR_SYSTEM_SOLAR,
+	STAR_SYSTEM_ALPHA_CENTAURI,
+	STAR_SYSTEM_TYPE_COUNT
 };
 
 // General states of the program
@@ -67,7 +105,7 @@ typedef struct
 	Font Font_Golden;
 	Font Font_Typerwriter;
 
-	// Sounds
+	// Sounds, all but the first of each are aliases
 	Sound Typewriter_forward[TYPE_COUNTER];
 	Sound Typewriter_backward[TYPE_COUNTER];
 
@@ -84,7 +122,11 @@ typedef struct
 	Model Model_Uranus;
 	Model Model_Venus;
 
-	Model Models_Asteroids[4];
+	Model Models_Asteroids[ASTEROID_MODEL_COUNT]; // Their materials use Shader_instancing
+
+	// Mid-range asteroids: a low-poly sphere drawn instanced
+	Mesh Mesh_AsteroidSphere;
+	Material Material_AsteroidSphere; // Owns Shader_instancing
 
 	std::vector<Model *> Models_Solar_System;
 
@@ -99,9 +141,29 @@ typedef struct
 	int Shader_blur_v_renderWidth;
 	int Shader_blur_v_renderHeight;
 
+	Shader Shader_downsample; // Scene to the blur resolution
+	int Shader_downsample_texelSize_location;
+
+	Shader Shader_instancing; // Takes the model matrix per instance, for DrawMeshInstanced
+
+	Shader Shader_points; // Far asteroids: one screen-space quad per point
+	int Shader_points_corner_location;
+	int Shader_points_position_location;
+	int Shader_points_color_location;
+	int Shader_points_mvp_location;
+	int Shader_points_viewportSize_location;
+	int Shader_points_pointSize_location;
+
 	// Textures
-	RenderTexture2D Texture_Buffer1;
-	RenderTexture2D Texture_Buffer2;
+	RenderTexture2D Texture_Buffer1;	 // Scene, at the monitor resolution
+	RenderTexture2D Texture_BlurBuffer1; // Blur passes, at 1 / BLUR_DOWNSAMPLE of it
+	RenderTexture2D Texture_BlurBuffer2;
+
+	// Owner of the meshes and sounds loaded once and shared
+	AssetRegistry *Asset_registry;
+
+	// Fonts and models still decoding, NULL once finish_resources uploaded them
+	PendingAssets *Pending_assets;
 
 } resource_t;
 
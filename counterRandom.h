@@ -0,0 +1,69 @@
+/**
+ * @brief Counter-based random numbers: the value of any draw is a function of a key and its index
+ * @author Mariano Caceres Smoler
+ * @author Enzo Nicolas Rosa Fernandez
+ * @author Francisco Chiusaroli
+ *
+ * Nothing is shared between draws, so they can be taken in any order and on
+ * any thread, and a seed gives the same values on every platform.
+ *
+ * @cite B. Widynski, "Squares: A Fast Counter-Based RNG", arXiv:2004.06278
+ */
+
+#ifndef COUNTERRANDOM_H
+#define COUNTERRANDOM_H
+
+#include <cstdint>
+
+/**
+ * @brief Derives the key of a stream from a seed
+ *
+ * Squares wants keys with well mixed bits; the SplitMix64 finalizer spreads
+ * small seeds over the whole word.
+ *
+ * @param seed Any value
+ * @return The key, always odd
+ */
+inline uint64_t getCounterRandomKey(uint64_t seed)
+{
+	uint64_t z = seed + 0x9E3779B97F4A7C15ULL;
+
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+
+	return (z ^ (z >> 31)) | 1;
+}
+
+/**
+ * @brief Gets a draw of a stream: four rounds of squaring the counter
+ *
+ * @param key Key of the stream
+ * @param counter Index of the draw
+ * @return 32 random bits
+ */
+inline uint32_t getCounterRandom(uint64_t key, uint64_t counter)
+{
+	uint64_t x = counter * key;
+	uint64_t y = x;
+	uint64_t z = y + key;
+
+	x = x * x + y;
+	x = (x >> 32) | (x << 32);
+	x = x * x + z;
+	x = (x >> 32) | (x << 32);
+	x = x * x + y;
+	x = (x >> 32) | (x << 32);
+
+	return (uint32_t)((x * x + z) >> 32);
+}
+
+/**
+ * @brief Turns a draw into a uniform value in [0, 1), exact in float
+ * @param bits 32 random bits
+ */
+inline float getCounterRandomUnit(uint32_t bits)
+{
+	return (bits >> 8) * (1.0F / 16777216.0F);
+}
+
+#endif
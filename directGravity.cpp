@@ -0,0 +1,160 @@
+/**
+ * @brief Exact all-pairs gravity, cache blocked
+ * @author Mariano Caceres Smoler
+ * @author Enzo Nicolas Rosa Fernandez
+ * @author Francisco Chiusaroli
+ *
+ * Bodies are split in tiles small enough for two of them to stay in L1. Every
+ * pair of tiles is visited once and each interaction is applied to both bodies
+ * (Newton's third law), halving the work of the plain double loop.
+ *
+ * To accumulate without locks, tile pairs are scheduled as a round-robin
+ * tournament: within a round no tile appears twice, so the pairs of a round can
+ * run on different workers while each one owns the accumulators of its two
+ * tiles. The summation order is fixed, so results do not depend on the number
+ * of threads.
+ *
+ * Sources:
+ * https://en.wikipedia.org/wiki/Round-robin_tournament#Circle_method ; Pair scheduling
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "configuration.h"
+#include "directGravity.h"
+
+// 256 bodies * (16 bytes of input + 24 bytes of accumulators) = 10 KB per tile
+#define DIRECT_TILE_SIZE 256
+
+template <typename position_t>
+struct DirectInput
+{
+	const position_t *posX;
+	const position_t *posY;
+	const position_t *posZ;
+	const float *mass;
+	unsigned int bodyCount;
+
+	// Accumulated in double: this mode is the accuracy reference
+	double *accX;
+	double *accY;
+	double *accZ;
+};
+
+/**
+ * @brief Applies every pair (i, j) with i in tileA and j in tileB
+ *        (only j > i when both are the same tile)
+ */
+template <typename position_t>
+static void interactTiles(const DirectInput<position_t> &in, unsigned int tileA, unsigned int tileB)
+{
+	unsigned int firstA = tileA * DIRECT_TILE_SIZE;
+	unsigned int lastA = std::min(in.bodyCount, firstA + DIRECT_TILE_SIZE);
+	unsigned int firstB = tileB * DIRECT_TILE_SIZE;
+	unsigned int lastB = std::min(in.bodyCount, firstB + DIRECT_TILE_SIZE);
+
+	for (unsigned int i = firstA; i < lastA; i++)
+	{
+		double ax = 0, ay = 0, az = 0;
+
+		for (unsigned int j = (tileA == tileB) ? i + 1 : firstB; j < lastB; j++)
+		{
+			double dx = (double)in.posX[j] - in.posX[i];
+			double dy = (double)in.posY[j] - in.posY[i];
+			double dz = (double)in.posZ[j] - in.posZ[i];
+			double r2 = dx * dx + dy * dy + dz * dz;
+
+			if (r2 > 0)
+			{
+				double inv3 = 1.0 / (r2 * sqrt(r2));
+
+				ax += dx * (in.mass[j] * inv3);
+				ay += dy * (in.mass[j] * inv3);
+				az += dz * (in.mass[j] * inv3);
+
+				in.accX[j] -= dx * (in.mass[i] * inv3);
+				in.accY[j] -= dy * (in.mass[i] * inv3);
+				in.accZ[j] -= dz * (in.mass[i] * inv3);
+			}
+		}
+
+		in.accX[i] += ax;
+		in.accY[i] += ay;
+		in.accZ[i] += az;
+	}
+}
+
+/**
+ * @brief Computes the exact gravitational acceleration on every body from every other body
+ *
+ * @param jobSystem Workers to split the tile pairs across
+ * @param posX, posY, posZ Body positions
+ * @param mass Body masses
+ * @param bodyCount Number of bodies
+ * @param accX, accY, accZ Output accelerations
+ */
+template <typename position_t, typename acceleration_t>
+void computeDirectAccelerations(JobSystem *jobSystem,
+								const position_t *posX, const position_t *posY, const position_t *posZ, const float *mass,
+								unsigned int bodyCount,
+								acceleration_t *accX, acceleration_t *accY, acceleration_t *accZ)
+{
+	std::vector<double> accumulators(3 * (size_t)bodyCount, 0.0);
+
+	DirectInput<position_t> in;
+	in.posX = posX;
+	in.posY = posY;
+	in.posZ = posZ;
+	in.mass = mass;
+	in.bodyCount = bodyCount;
+	in.accX = accumulators.data();
+	in.accY = in.accX + bodyCount;
+	in.accZ = in.accY + bodyCount;
+
+	unsigned int tileCount = (bodyCount + DIRECT_TILE_SIZE - 1) / DIRECT_TILE_SIZE;
+
+	// Pairs inside each tile: tiles are disjoint, all of them at once
+	parallelFor(jobSystem, 0, tileCount, 1, [&](unsigned int begin, unsigned int end)
+				{
+					for (unsigned int tile = begin; tile < end; tile++)
+						interactTiles(in, tile, tile);
+				});
+
+	// Pairs of tiles, one tournament round at a time (circle method, with a bye if odd)
+	unsigned int players = tileCount + (tileCount & 1);
+
+	for (unsigned int round = 0; round + 1 < players; round++)
+	{
+		parallelFor(jobSystem, 0, players / 2, 1, [&](unsigned int begin, unsigned int end)
+					{
+						for (unsigned int k = begin; k < end; k++)
+						{
+							unsigned int tileA = (k == 0) ? players - 1 : (round + k) % (players - 1);
+							unsigned int tileB = (round + players - 1 - k) % (players - 1);
+
+							if (tileA < tileCount && tileB < tileCount)
+								interactTiles(in, tileA, tileB);
+						}
+					});
+	}
+
+	parallelFor(jobSystem, 0, bodyCount, DIRECT_TILE_SIZE, [&](unsigned int begin, unsigned int end)
+				{
+					for (unsigned int i = begin; i < end; i++)
+					{
+						accX[i] = (acceleration_t)(GRAVITATIONAL_CONSTANT * in.accX[i]);
+						accY[i] = (acceleration_t)(GRAVITATIONAL_CONSTANT * in.accY[i]);
+						accZ[i] = (acceleration_t)(GRAVITATIONAL_CONSTANT * in.accZ[i]);
+					}
+				});
+}
+
+// One instance per precision_type_t
+template void computeDirectAccelerations(JobSystem *, const float *, const float *, const float *, const float *,
+										 unsigned int, float *, float *, float *);
+template void computeDirectAccelerations(JobSystem *, const double *, const double *, const double *, const float *,
+										 unsigned int, float *, float *, float *);
+template void computeDirectAccelerations(JobSystem *, const double *, const double *, const double *, const float *,
+										 unsigned int, double *, double *, double *);
@@ -0,0 +1,20 @@
+/**
+ * @brief Exact all-pairs gravity, cache blocked
+ * @author Mariano Caceres Smoler
+ * @author Enzo Nicolas Rosa Fernandez
+ * @author Francisco Chiusaroli
+ */
+
+#ifndef DIRECTGRAVITY_H
+#define DIRECTGRAVITY_H
+
+#include "jobSystem.h"
+
+// Instantiated for float, mixed and double precision (see precision_type_t)
+template <typename position_t, typename acceleration_t>
+void computeDirectAccelerations(JobSystem *jobSystem,
+								const position_t *posX, const position_t *posY, const position_t *posZ, const float *mass,
+								unsigned int bodyCount,
+								acceleration_t *accX, acceleration_t *accY, acceleration_t *accZ);
+
+#endif
@@ -0,0 +1,324 @@
+/**
+ * @brief Work-stealing job system
+ * @author Mariano Caceres Smoler
+ * @author Enzo Nicolas Rosa Fernandez
+ * @author Francisco Chiusaroli
+ *
+ * Every worker owns a queue of ranges. A worker takes the newest range from its
+ * own queue, splits it in halves until it fits the grain (pushing back the half
+ * it does not run), and when it runs out of work it steals the oldest (largest)
+ * range from another queue. The thread calling parallelFor helps with the work
+ * until its range is done, so nested calls do not deadlock. Threads outside the
+ * pool, like the render and simulation threads, share one queue and only help
+ * with their own call, so neither one stalls on a range of the other.
+ *
+ * Sources:
+ * https://en.wikipedia.org/wiki/Work_stealing ; General scheme
+ */
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "jobSystem.h"
+
+/**
+ * @brief A parallelFor call waiting for its items to be processed
+ */
+struct JobGroup
+{
+	const job_range_t *job;
+	unsigned int grain;
+	std::atomic<unsigned int> remaining;
+};
+
+/**
+ * @brief A pending range of a JobGroup
+ */
+struct JobTask
+{
+	JobGroup *group;
+	unsigned int begin;
+	unsigned int end;
+};
+
+struct WorkQueue
+{
+	std::mutex lock;
+	std::deque<JobTask> tasks;
+};
+
+struct JobSystem
+{
+	std::vector<std::thread> workers;
+
+	// One queue per worker, plus a shared one for threads outside the pool
+	WorkQueue *queues;
+	unsigned int queueCount;
+
+	std::atomic<bool> running;
+	std::atomic<int> pendingTasks;
+
+	std::mutex sleepLock;
+	std::condition_variable wakeUp;
+};
+
+// Queue owned by the calling thread, if it is a worker
+static thread_local JobSystem *currentJobSystem = nullptr;
+static thread_local unsigned int currentQueue = 0;
+
+static JobSystem *sharedJobSystem = nullptr;
+static std::mutex sharedJobSystemLock;
+
+/**
+ * @brief Gets the queue the calling thread should push to and pop from
+ */
+static unsigned int getOwnQueue(JobSystem *jobSystem)
+{
+	return (currentJobSystem == jobSystem) ? currentQueue : jobSystem->queueCount - 1;
+}
+
+static void pushTask(JobSystem *jobSystem, unsigned int queue, const JobTask &task)
+{
+	{
+		std::lock_guard<std::mutex> guard(jobSystem->queues[queue].lock);
+		jobSystem->queues[queue].tasks.push_back(task);
+	}
+
+	jobSystem->pendingTasks++;
+
+	std::lock_guard<std::mutex> guard(jobSystem->sleepLock);
+	jobSystem->wakeUp.notify_one();
+}
+
+/**
+ * @brief Takes the newest task of a queue (owner side)
+ * @param group Only take tasks of this group, or NULL for any
+ */
+static bool popTask(JobSystem *jobSystem, unsigned int queue, const JobGroup *group, JobTask *task)
+{
+	std::deque<JobTask> &tasks = jobSystem->queues[queue].tasks;
+	std::lock_guard<std::mutex> guard(jobSystem->queues[queue].lock);
+
+	for (size_t i = tasks.size(); i > 0; i--)
+	{
+		if (!group || tasks[i - 1].group == group)
+		{
+			*task = tasks[i - 1];
+			tasks.erase(tasks.begin() + (i - 1));
+			jobSystem->pendingTasks--;
+
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/**
+ * @brief Takes the oldest task of any other queue (thief side)
+ * @param group Only take tasks of this group, or NULL for any
+ */
+static bool stealTask(JobSystem *jobSystem, unsigned int thief, const JobGroup *group, JobTask *task)
+{
+	for (unsigned int i = 1; i < jobSystem->queueCount; i++)
+	{
+		WorkQueue &victim = jobSystem->queues[(thief + i) % jobSystem->queueCount];
+		std::lock_guard<std::mutex> guard(victim.lock);
+
+		for (size_t j = 0; j < victim.tasks.size(); j++)
+		{
+			if (!group || victim.tasks[j].group == group)
+			{
+				*task = victim.tasks[j];
+				victim.tasks.erase(victim.tasks.begin() + j);
+				jobSystem->pendingTasks--;
+
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+static bool findTask(JobSystem *jobSystem, unsigned int queue, const JobGroup *group, JobTask *task)
+{
+	return popTask(jobSystem, queue, group, task) || stealTask(jobSystem, queue, group, task);
+}
+
+/**
+ * @brief Splits a task down to its grain, leaving the other halves up for grabs, and runs it
+ */
+static void runTask(JobSystem *jobSystem, unsigned int queue, JobTask task)
+{
+	while (task.end - task.begin > task.group->grain)
+	{
+		unsigned int middle = task.begin + (task.end - task.begin) / 2;
+
+		pushTask(jobSystem, queue, {task.group, middle, task.end});
+		task.end = middle;
+	}
+
+	(*task.group->job)(task.begin, task.end);
+
+	task.group->remaining -= task.end - task.begin;
+}
+
+static void workerLoop(JobSystem *jobSystem, unsigned int queue)
+{
+	currentJobSystem = jobSystem;
+	currentQueue = queue;
+
+	JobTask task;
+
+	while (jobSystem->running)
+	{
+		if (findTask(jobSystem, queue, NULL, &task))
+		{
+			runTask(jobSystem, queue, task);
+		}
+		else
+		{
+			std::unique_lock<std::mutex> lock(jobSystem->sleepLock);
+			jobSystem->wakeUp.wait(lock, [jobSystem]
+								   { return !jobSystem->running || jobSystem->pendingTasks > 0; });
+		}
+	}
+}
+
+/**
+ * @brief Constructs a job system
+ *
+ * @param workerCount Number of worker threads; 0 uses one less than the hardware threads
+ *                    (the thread calling parallelFor also does work)
+ * @return The job system
+ */
+JobSystem *constructJobSystem(unsigned int workerCount)
+{
+	JobSystem *jobSystem = new JobSystem();
+
+	if (workerCount == 0)
+	{
+		unsigned int hardwareThreads = std::thread::hardware_concurrency();
+		workerCount = (hardwareThreads > 1) ? hardwareThreads - 1 : 0;
+	}
+
+	jobSystem->queueCount = workerCount + 1;
+	jobSystem->queues = new WorkQueue[jobSystem->queueCount];
+	jobSystem->running = true;
+	jobSystem->pendingTasks = 0;
+
+	for (unsigned int i = 0; i < workerCount; i++)
+		jobSystem->workers.push_back(std::thread(workerLoop, jobSystem, i));
+
+	return jobSystem;
+}
+
+/**
+ * @brief Stops the workers and destroys a job system
+ * @param jobSystem The job system
+ */
+void destroyJobSystem(JobSystem *jobSystem)
+{
+	{
+		std::lock_guard<std::mutex> guard(jobSystem->sleepLock);
+		jobSystem->running = false;
+		jobSystem->wakeUp.notify_all();
+	}
+
+	for (size_t i = 0; i < jobSystem->workers.size(); i++)
+		jobSystem->workers[i].join();
+
+	delete[] jobSystem->queues;
+	delete jobSystem;
+}
+
+/**
+ * @brief Gets the job system shared by the whole program, creating it on first use
+ * @return The shared job system
+ */
+JobSystem *getJobSystem()
+{
+	std::lock_guard<std::mutex> guard(sharedJobSystemLock);
+
+	if (!sharedJobSystem)
+		sharedJobSystem = constructJobSystem(0);
+
+	return sharedJobSystem;
+}
+
+/**
+ * @brief Destroys the shared job system, if it was ever created
+ */
+void shutdownJobSystem()
+{
+	std::lock_guard<std::mutex> guard(sharedJobSystemLock);
+
+	if (sharedJobSystem)
+	{
+		destroyJobSystem(sharedJobSystem);
+		sharedJobSystem = nullptr;
+	}
+}
+
+/**
+ * @brief Gets the number of threads that take part in a parallelFor
+ *
+ * @param jobSystem The job system
+ * @return Worker threads plus the calling thread
+ */
+unsigned int getJobSystemThreadCount(JobSystem *jobSystem)
+{
+	return jobSystem->queueCount;
+}
+
+/**
+ * @brief Runs a job over [begin, end) split across the workers, and waits for it
+ *
+ * @param jobSystem The job system (NULL runs the job inline)
+ * @param begin First item
+ * @param end One past the last item
+ * @param grain Largest range handed to a single job call
+ * @param job Work function, called with non-overlapping sub-ranges
+ */
+void parallelFor(JobSystem *jobSystem, unsigned int begin, unsigned int end, unsigned int grain, const job_range_t &job)
+{
+	if (begin >= end)
+		return;
+
+	if (grain == 0)
+		grain = 1;
+
+	if (!jobSystem || jobSystem->workers.empty() || end - begin <= grain)
+	{
+		job(begin, end);
+		return;
+	}
+
+	JobGroup group;
+	group.job = &job;
+	group.grain = grain;
+	group.remaining = end - begin;
+
+	unsigned int queue = getOwnQueue(jobSystem);
+
+	// Workers help with anybody's work; other threads only with their own
+	const JobGroup *helpedGroup = (currentJobSystem == jobSystem) ? NULL : &group;
+
+	runTask(jobSystem, queue, {&group, begin, end});
+
+	// Help with the remaining work until our range is done
+	JobTask task;
+
+	while (group.remaining > 0)
+	{
+		if (findTask(jobSystem, queue, helpedGroup, &task))
+			runTask(jobSystem, queue, task);
+		else
+			std::this_thread::yield();
+	}
+}
@@ -0,0 +1,30 @@
+/**
+ * @brief Work-stealing job system
+ * @author Mariano Caceres Smoler
+ * @author Enzo Nicolas Rosa Fernandez
+ * @author Francisco Chiusaroli
+ */
+
+#ifndef JOBSYSTEM_H
+#define JOBSYSTEM_H
+
+#include <functional>
+
+// Work function for a range of items [begin, end)
+typedef std::function<void(unsigned int begin, unsigned int end)> job_range_t;
+
+struct JobSystem;
+
+JobSystem *constructJobSystem(unsigned int workerCount);
+
+void destroyJobSystem(JobSystem *jobSystem);
+
+JobSystem *getJobSystem();
+
+void shutdownJobSystem();
+
+unsigned int getJobSystemThreadCount(JobSystem *jobSystem);
+
+void parallelFor(JobSystem *jobSystem, unsigned int begin, unsigned int end, unsigned int grain, const job_range_t &job);
+
+#endif
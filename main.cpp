@@ -5,16 +5,29 @@
  * @copyright Copyright (c) 2022-2023
  */
 
+#include "checkpoint.h"
 #include "configuration.h"
+#include "jobSystem.h"
 #include "menu.h"
 #include "orbitalSim.h"
+#include "scenario.h"
+#include "simThread.h"
+#include "trajectoryReplay.h"
 #include "view.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 
 #define SECONDS_PER_DAY 86400
+#define MIN_TIME_WARP (1 * SECONDS_PER_DAY)
+#define MAX_TIME_WARP (1000 * SECONDS_PER_DAY)
+#define DIAGNOSTICS_INTERVAL 64 // Steps between conservation measurements while the HUD shows them
+#define TRAJECTORY_INTERVAL 4	// Steps between recorded frames
+#define REPLAY_SEEK_STEP (30 * SECONDS_PER_DAY)
 #define MAX_GRADIENT 255
 
-int main()
+int main(int argc, char **argv)
 {
 
 	//**************DECLARATIONS & DEFINITIONS***************//
@@ -31,7 +44,8 @@ int main()
 	View *view = constructView(&fps, &monitor);
 
 	float timeMultiplier = 10 * SECONDS_PER_DAY; // Simulation speed: 10 days per simulation second
-	float timeStep = 1 * timeMultiplier / fps;
+	double timeStep = 1 * timeMultiplier / fps;
+	float timeWarp = 5 * timeMultiplier; // Simulated time per second, reached with more updates per frame (not a larger timeStep)
 
 	unsigned char gradient = 255;
 	unsigned char text_gradient = 0;
@@ -45,10 +59,19 @@ int main()
 	float blur_gradient = MAX_GRADIENT - 20;
 
 	const char *view_options[2] = {"Planets Mode", "Pepsi Mode"};
-	const char *math_options[2] = {"Gravity Mode", "Spring Mode"};
+	const char *math_options[LOGIC_TYPE_COUNT] = {"Gravity Mode", "Exact Gravity Mode", "Spring Mode", "Barnes-Hut Mode"};
 	const char *ship_options[2] = {"No", "Yes"};
+	const char *integrator_options[INTEGRATOR_TYPE_COUNT] = {"Euler", "Leapfrog", "Yoshida 4", "Forest-Ruth"};
 
-	int subSteps;
+	const char *precision_options[PRECISION_TYPE_COUNT] = {"Float", "Mixed", "Double"};
+
+	integrator_type_t integrator = INTEGRATOR_EULER;
+	precision_type_t precision = PRECISION_FLOAT;
+	bool diagnostics = false; // Conservation HUD, toggled with F3
+	bool recording = false;	  // Trajectory recorder, toggled with F6
+
+	TrajectoryReplay *replay = NULL; // Shown instead of the simulation while set, toggled with F7
+	double replayTime = 0;
 
 	float &monitorwidth = monitor.width;
 	float &monitorheight = monitor.height;
@@ -57,7 +80,36 @@ int main()
 
 	//************************STARTUP************************//
 
-	OrbitalSim *sim = constructOrbitalSim(timeStep);
+	// Command line: [--asteroids N] [--seed N] [SCENARIO]
+	unsigned int asteroidCount = ASTEROIDS_BODYNUM;
+	unsigned int seed = 1;
+	const char *scenario = NULL;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "--asteroids") && i + 1 < argc)
+			asteroidCount = (unsigned int)strtoul(argv[++i], NULL, 10);
+		else if (!strcmp(argv[i], "--seed") && i + 1 < argc)
+			seed = (unsigned int)strtoul(argv[++i], NULL, 10);
+		else
+			scenario = argv[i];
+	}
+
+	// Load the scenario, or without options resume the last run if it was saved, with its own timestep
+	OrbitalSim *sim = NULL;
+
+	if (scenario)
+		sim = loadOrbitalSimScenario(scenario, timeStep);
+	else if (argc == 1)
+		sim = loadOrbitalSimCheckpoint(CHECKPOINT_FILE);
+
+	if (sim)
+	{
+		integrator = (integrator_type_t)sim->integrator;
+		precision = (precision_type_t)sim->bodiesList.precision;
+	}
+	else
+		sim = constructOrbitalSim(timeStep, asteroidCount, seed);
 
 	InitAudioDevice();
 
@@ -72,21 +124,29 @@ int main()
 	while (GetKeyPressed())
 		;
 
+	finish_resources(Master_resource); // Waits for the assets decoded during the intro
+
 	setup_3D_view(view);
 
 	float x = monitorwidth * 0.7f;
 	float y1 = monitorheight * 0.4f;
 	float y2 = monitorheight * 0.5f;
 	float y3 = monitorheight * 0.6f;
+	float y4 = monitorheight * 0.7f;
+	float y5 = monitorheight * 0.8f;
 	float w = monitorwidth * 0.3f;
 	float h = monitorheight * 0.05f;
 
+	// From here on the simulation steps on its own thread
+	SimThread *simThread = constructSimThread(sim, simLogicalType, timeWarp, fps);
+
 	//*******************************************************//
 
 	//*********************MAIN-LOOP*************************//
 
 	while (isViewRendering(view))
 	{
+		const SimSnapshot *snapshot = replay ? seekTrajectoryReplay(replay, replayTime) : acquireSimSnapshot(simThread);
 
 		switch (program_stage)
 		{
@@ -94,11 +154,7 @@ int main()
 			//********TITLE-SCREEN*********//
 
 		case INTRODUCTION:
-			subSteps = 5;
-			for (int i = 0; i < subSteps; i++)
-				updateOrbitalSim(sim, simLogicalType); // Updates multiple times per frame.
-
-			renderView(view, sim, Master_resource, simVisualType, 0, toggle_ship);
+			renderView(view, snapshot, Master_resource, simVisualType, 0, toggle_ship);
 
 			update_blur_shader(Master_resource, &monitor, blur_gradient);
 
@@ -152,11 +208,7 @@ int main()
 
 			ShowCursor();
 
-			subSteps = 5;
-			for (int i = 0; i < subSteps; i++)
-				updateOrbitalSim(sim, simLogicalType); // Updates multiple times per frame.
-
-			renderView(view, sim, Master_resource, simVisualType, 0, toggle_ship);
+			renderView(view, snapshot, Master_resource, simVisualType, 0, toggle_ship);
 
 			BeginDrawing_with_blurry_filter(Master_resource);
 
@@ -207,6 +259,36 @@ int main()
 				DrawTextEx(Master_resource->Font_Gothic, ship_options[toggle_ship], (Vector2){x + w * 0.5F, y3}, 48, 0.0, BLACK);
 			}
 
+			// Integrator button
+
+			DrawTextEx(Master_resource->Font_Gothic, "Integrator", (Vector2){monitorwidth * 0.75F, monitorheight * 0.65F}, 48, 0.0, WHITE);
+
+			if (isMouseHere(GetMousePosition(), (Vector2){x, y4}, (Vector2){x + w, y4 + h}))
+			{
+				DrawRectangleGradientH(x, y4, w, h, BLACK, PURPLE);
+				DrawTextEx(Master_resource->Font_Gothic, integrator_options[integrator], (Vector2){x + w * 0.5F, y4}, 48, 0.0, WHITE);
+			}
+			else
+			{
+				DrawRectangleGradientH(x, y4, w, h, BLACK, DARKBLUE);
+				DrawTextEx(Master_resource->Font_Gothic, integrator_options[integrator], (Vector2){x + w * 0.5F, y4}, 48, 0.0, BLACK);
+			}
+
+			// Precision button
+
+			DrawTextEx(Master_resource->Font_Gothic, "Precision", (Vector2){monitorwidth * 0.75F, monitorheight * 0.75F}, 48, 0.0, WHITE);
+
+			if (isMouseHere(GetMousePosition(), (Vector2){x, y5}, (Vector2){x + w, y5 + h}))
+			{
+				DrawRectangleGradientH(x, y5, w, h, BLACK, PURPLE);
+				DrawTextEx(Master_resource->Font_Gothic, precision_options[precision], (Vector2){x + w * 0.5F, y5}, 48, 0.0, WHITE);
+			}
+			else
+			{
+				DrawRectangleGradientH(x, y5, w, h, BLACK, DARKBLUE);
+				DrawTextEx(Master_resource->Font_Gothic, precision_options[precision], (Vector2){x + w * 0.5F, y5}, 48, 0.0, BLACK);
+			}
+
 			//--------------------------//
 
 			//----Mouse interaction-----//
@@ -215,10 +297,8 @@ int main()
 			{
 				if (isMouseHere(GetMousePosition(), (Vector2){x, y1}, (Vector2){x + w, y1 + h}))
 				{
-					if (simLogicalType == GRAVITATIONAL_SIMULATION)
-						simLogicalType = SPRINGS_SIMULATION;
-					else
-						simLogicalType = GRAVITATIONAL_SIMULATION;
+					simLogicalType = (logical_sim_type_t)((simLogicalType + 1) % LOGIC_TYPE_COUNT);
+					sendSimCommand(simThread, {SIM_COMMAND_SET_TYPE, (float)simLogicalType});
 				}
 				else if (isMouseHere(GetMousePosition(), (Vector2){x, y2}, (Vector2){x + w, y2 + h}))
 				{
@@ -231,6 +311,16 @@ int main()
 				{
 					toggle_ship = !toggle_ship;
 				}
+				else if (isMouseHere(GetMousePosition(), (Vector2){x, y4}, (Vector2){x + w, y4 + h}))
+				{
+					integrator = (integrator_type_t)((integrator + 1) % INTEGRATOR_TYPE_COUNT);
+					sendSimCommand(simThread, {SIM_COMMAND_SET_INTEGRATOR, (float)integrator});
+				}
+				else if (isMouseHere(GetMousePosition(), (Vector2){x, y5}, (Vector2){x + w, y5 + h}))
+				{
+					precision = (precision_type_t)((precision + 1) % PRECISION_TYPE_COUNT);
+					sendSimCommand(simThread, {SIM_COMMAND_SET_PRECISION, (float)precision});
+				}
 			}
 
 			//--------------------------//
@@ -252,23 +342,105 @@ int main()
 
 		case FREEVIEW:
 			HideCursor();
-			subSteps = 5;
-			for (int i = 0; i < subSteps; i++)
-				updateOrbitalSim(sim, simLogicalType); // Updates multiple times per frame.
-
 			BeginDrawing_without_blurry_filter(Master_resource);
 
-			renderView(view, sim, Master_resource, simVisualType, 1, toggle_ship);
+			renderView(view, snapshot, Master_resource, simVisualType, 1, toggle_ship);
 
-			DrawText(getISODate(sim->totalTime), 0, 25, 20, RED);
+			DrawText(getISODate(snapshot->totalTime), 0, 25, 20, RED);
+
+			if (replay)
+				DrawText(TextFormat("Replay of " TRAJECTORY_FILE ", %.0f days/s", timeWarp / SECONDS_PER_DAY), 0, 50, 20, RED);
+			else
+				DrawText(TextFormat("%.0f/%.0f days/s, %u updates/frame", snapshot->timeWarp / SECONDS_PER_DAY, timeWarp / SECONDS_PER_DAY, snapshot->subSteps), 0, 50, 20, RED);
 
 			DrawFPS(0, 0);
 
+			if (diagnostics)
+			{
+				const OrbitalDiagnostics &d = snapshot->diagnostics;
+
+				if (d.valid)
+					DrawText(TextFormat("dE/E %+.2e  dP/P %.2e  dL/L %.2e", d.energyDrift, d.momentumDrift, d.angularMomentumDrift), 120, 0, 20, RED);
+				else
+					DrawText("Conservation: gravity mode only", 120, 0, 20, RED);
+			}
+
+			if (recording)
+				DrawText("Recording " TRAJECTORY_FILE, 0, 75, 20, RED);
+
+			if (IsKeyPressed(KEY_F3))
+			{
+				diagnostics = !diagnostics;
+				sendSimCommand(simThread, {SIM_COMMAND_SET_DIAGNOSTICS, diagnostics ? (float)DIAGNOSTICS_INTERVAL : 0.0F});
+			}
+
+			if (IsKeyPressed(KEY_F5))
+			{
+				sendSimCommand(simThread, {SIM_COMMAND_SAVE_CHECKPOINT, 0});
+			}
+
+			if (IsKeyPressed(KEY_F6) && !replay)
+			{
+				recording = !recording;
+				sendSimCommand(simThread, {SIM_COMMAND_SET_RECORDING, recording ? (float)TRAJECTORY_INTERVAL : 0.0F});
+			}
+
+			// Replay of the last recording; the simulation is paused meanwhile
+			if (IsKeyPressed(KEY_F7) && !recording)
+			{
+				if (replay)
+				{
+					destroyTrajectoryReplay(replay);
+					replay = NULL;
+
+					sendSimCommand(simThread, {SIM_COMMAND_SET_TIME_WARP, timeWarp});
+				}
+				else if ((replay = constructTrajectoryReplay(TRAJECTORY_FILE)))
+				{
+					replayTime = getTrajectoryReplayFrameTime(replay, 0);
+
+					sendSimCommand(simThread, {SIM_COMMAND_SET_TIME_WARP, 0.0F});
+				}
+			}
+
+			if (replay)
+			{
+				double replayStart = getTrajectoryReplayFrameTime(replay, 0);
+				double replayEnd = getTrajectoryReplayFrameTime(replay, getTrajectoryReplayFrameCount(replay) - 1);
+
+				replayTime += timeWarp * GetFrameTime();
+
+				if (IsKeyPressed(KEY_HOME))
+					replayTime = replayStart;
+				if (IsKeyPressed(KEY_END))
+					replayTime = replayEnd;
+				if (IsKeyPressed(KEY_LEFT_BRACKET))
+					replayTime -= REPLAY_SEEK_STEP;
+				if (IsKeyPressed(KEY_RIGHT_BRACKET))
+					replayTime += REPLAY_SEEK_STEP;
+
+				replayTime = std::max(replayStart, std::min(replayEnd, replayTime));
+			}
+
 			if (IsKeyPressed(KEY_BACKSPACE))
 			{
 				program_stage = SETTING_MENU;
 			}
 
+			// Time warp
+			if (IsKeyPressed(KEY_PAGE_UP) || IsKeyPressed(KEY_PAGE_DOWN))
+			{
+				timeWarp *= IsKeyPressed(KEY_PAGE_UP) ? 2.0F : 0.5F;
+
+				if (timeWarp > MAX_TIME_WARP)
+					timeWarp = MAX_TIME_WARP;
+				if (timeWarp < MIN_TIME_WARP)
+					timeWarp = MIN_TIME_WARP;
+
+				if (!replay)
+					sendSimCommand(simThread, {SIM_COMMAND_SET_TIME_WARP, timeWarp});
+			}
+
 			EndDrawing();
 
 			break;
@@ -285,7 +457,12 @@ int main()
 	//************************CLEANUP************************//
 
 	destroyView(view);
+	destroySimThread(simThread);
+
+	if (replay)
+		destroyTrajectoryReplay(replay);
 	destroyOrbitalSim(sim);
+	shutdownJobSystem();
 	CloseAudioDevice();
 
 	kill_resources(Master_resource);
@@ -0,0 +1,106 @@
+/**
+ * @brief Read-only memory-mapped files
+ * @author Mariano Caceres Smoler
+ * @author Enzo Nicolas Rosa Fernandez
+ * @author Francisco Chiusaroli
+ *
+ * Kept apart from raylib: windows.h declares functions with the same names.
+ */
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "mappedFile.h"
+
+/**
+ * @brief Maps a whole file into memory, read only
+ *
+ * Pages are read from disk as they are touched. The file can be closed right
+ * after mapping: the mapping keeps its own reference.
+ *
+ * @param fileName The file
+ * @return The mapping, or NULL if the file is missing or empty
+ */
+MappedFile *constructMappedFile(const char *fileName)
+{
+	const void *data = NULL;
+	size_t size = 0;
+
+#if defined(_WIN32)
+	HANDLE file = CreateFileA(fileName, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+
+	if (file == INVALID_HANDLE_VALUE)
+		return NULL;
+
+	LARGE_INTEGER fileSize;
+
+	if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0)
+	{
+		HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+
+		if (mapping)
+		{
+			data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+			size = (size_t)fileSize.QuadPart;
+			CloseHandle(mapping);
+		}
+	}
+
+	CloseHandle(file);
+#else
+	int file = open(fileName, O_RDONLY);
+
+	if (file < 0)
+		return NULL;
+
+	struct stat status;
+
+	if (!fstat(file, &status) && status.st_size > 0)
+	{
+		void *mapping = mmap(NULL, (size_t)status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+
+		if (mapping != MAP_FAILED)
+		{
+			data = mapping;
+			size = (size_t)status.st_size;
+		}
+	}
+
+	close(file);
+#endif
+
+	if (!data)
+		return NULL;
+
+	MappedFile *mappedFile = new MappedFile();
+
+	mappedFile->data = (const unsigned char *)data;
+	mappedFile->size = size;
+
+	return mappedFile;
+}
+
+/**
+ * @brief Unmaps a file
+ * @param mappedFile The mapping, may be NULL
+ */
+void destroyMappedFile(MappedFile *mappedFile)
+{
+	if (!mappedFile)
+		return;
+
+#if defined(_WIN32)
+	UnmapViewOfFile(mappedFile->data);
+#else
+	munmap((void *)mappedFile->data, mappedFile->size);
+#endif
+
+	delete mappedFile;
+}
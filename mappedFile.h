@@ -0,0 +1,23 @@
+/**
+ * @brief Read-only memory-mapped files
+ * @author Mariano Caceres Smoler
+ * @author Enzo Nicolas Rosa Fernandez
+ * @author Francisco Chiusaroli
+ */
+
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <cstddef>
+
+struct MappedFile
+{
+	const unsigned char *data; // Page aligned
+	size_t size;
+};
+
+MappedFile *constructMappedFile(const char *fileName);
+
+void destroyMappedFile(MappedFile *mappedFile);
+
+#endif
@@ -0,0 +1,172 @@
+/**
+ * @brief Aligned memory arenas for large arrays, backed by huge pages when available
+ * @author Mariano Caceres Smoler
+ * @author Enzo Nicolas Rosa Fernandez
+ * @author Francisco Chiusaroli
+ *
+ * An arena is a single mapping of anonymous memory that allocations are carved
+ * out of in order, each one aligned to MEMORY_ARENA_ALIGNMENT. It is all freed
+ * at once. Pages are only backed by memory when first written, so an arena can
+ * reserve room that may never be used, and on NUMA systems every page lands on
+ * the node of the thread that writes it first.
+ *
+ * On Linux, arenas of a huge page or more are aligned to huge pages and asked to
+ * use transparent huge pages: a million bodies then take tens of TLB entries
+ * instead of tens of thousands. Elsewhere they use normal pages; Windows only
+ * gives large pages to accounts with the lock pages privilege.
+ *
+ * Kept apart from raylib: windows.h declares functions with the same names.
+ */
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include <cstdint>
+
+#include "memoryArena.h"
+
+#define HUGE_PAGE_SIZE (2 << 20)
+
+/**
+ * @brief Maps an arena of zeroed memory
+ *
+ * @param size Bytes of room
+ * @return The arena, or NULL if it could not be mapped
+ */
+MemoryArena *constructMemoryArena(size_t size)
+{
+	if (!size)
+		return NULL;
+
+	unsigned char *data = NULL;
+	bool hugePages = false;
+
+#if defined(_WIN32)
+	data = (unsigned char *)VirtualAlloc(NULL, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+
+	if (!data)
+		return NULL;
+#else
+	size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+
+	size = (size + pageSize - 1) / pageSize * pageSize;
+
+	// Mapped with room to align to a huge page, then trimmed
+	size_t alignment = (size >= HUGE_PAGE_SIZE) ? HUGE_PAGE_SIZE : pageSize;
+	size_t mappedSize = size + alignment - pageSize;
+	int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+
+#if defined(MAP_NORESERVE)
+	flags |= MAP_NORESERVE; // Room never written is not counted against the memory of the system
+#endif
+
+	void *mapping = mmap(NULL, mappedSize, PROT_READ | PROT_WRITE, flags, -1, 0);
+
+	if (mapping == MAP_FAILED)
+		return NULL;
+
+	uintptr_t start = (uintptr_t)mapping;
+	uintptr_t aligned = (start + alignment - 1) & ~(uintptr_t)(alignment - 1);
+
+	if (aligned > start)
+		munmap(mapping, aligned - start);
+
+	if (aligned + size < start + mappedSize)
+		munmap((void *)(aligned + size), start + mappedSize - (aligned + size));
+
+	data = (unsigned char *)aligned;
+
+#if defined(MADV_HUGEPAGE)
+	if (alignment == HUGE_PAGE_SIZE)
+		hugePages = !madvise(data, size, MADV_HUGEPAGE);
+#endif
+#endif
+
+	MemoryArena *arena = new MemoryArena();
+
+	arena->data = data;
+	arena->size = size;
+	arena->used = 0;
+	arena->hugePages = hugePages;
+
+	return arena;
+}
+
+/**
+ * @brief Unmaps an arena and everything allocated from it
+ * @param arena The arena, may be NULL
+ */
+void destroyMemoryArena(MemoryArena *arena)
+{
+	if (!arena)
+		return;
+
+#if defined(_WIN32)
+	VirtualFree(arena->data, 0, MEM_RELEASE);
+#else
+	munmap(arena->data, arena->size);
+#endif
+
+	delete arena;
+}
+
+/**
+ * @brief Takes the next free room of an arena
+ *
+ * @param arena The arena
+ * @param size Bytes
+ * @return Memory aligned to MEMORY_ARENA_ALIGNMENT, zeroed until discarded; NULL if the arena is full
+ */
+void *allocateFromMemoryArena(MemoryArena *arena, size_t size)
+{
+	size = getMemoryArenaAllocationSize(size);
+
+	if (size > arena->size - arena->used)
+		return NULL;
+
+	void *data = arena->data + arena->used;
+
+	arena->used += size;
+
+	return data;
+}
+
+/**
+ * @brief Gives the memory of a range back to the system, keeping it allocated
+ *
+ * Only whole pages inside the range are given back. The range stays usable;
+ * its contents are undefined until written again.
+ *
+ * @param arena The arena
+ * @param data Start of the range
+ * @param size Bytes
+ */
+void discardMemoryArenaRange(MemoryArena *arena, void *data, size_t size)
+{
+#if defined(_WIN32)
+	SYSTEM_INFO system;
+
+	GetSystemInfo(&system);
+
+	size_t pageSize = system.dwPageSize;
+#else
+	size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+#endif
+
+	uintptr_t start = ((uintptr_t)data + pageSize - 1) & ~(uintptr_t)(pageSize - 1);
+	uintptr_t end = ((uintptr_t)data + size) & ~(uintptr_t)(pageSize - 1);
+
+	if (start < (uintptr_t)arena->data || end > (uintptr_t)(arena->data + arena->size) || start >= end)
+		return;
+
+#if defined(_WIN32)
+	VirtualAlloc((void *)start, end - start, MEM_RESET, PAGE_READWRITE);
+#else
+	madvise((void *)start, end - start, MADV_DONTNEED);
+#endif
+}
@@ -0,0 +1,41 @@
+/**
+ * @brief Aligned memory arenas for large arrays, backed by huge pages when available
+ * @author Mariano Caceres Smoler
+ * @author Enzo Nicolas Rosa Fernandez
+ * @author Francisco Chiusaroli
+ */
+
+#ifndef MEMORYARENA_H
+#define MEMORYARENA_H
+
+#include <cstddef>
+
+#define MEMORY_ARENA_ALIGNMENT 64 // Of every allocation: a cache line, and the widest SIMD load
+
+struct MemoryArena
+{
+	unsigned char *data; // Page aligned, huge page aligned if large enough
+	size_t size;
+	size_t used;
+	bool hugePages; // Whether the system was asked to back it with huge pages
+};
+
+MemoryArena *constructMemoryArena(size_t size);
+
+void destroyMemoryArena(MemoryArena *arena);
+
+void *allocateFromMemoryArena(MemoryArena *arena, size_t size);
+
+void discardMemoryArenaRange(MemoryArena *arena, void *data, size_t size);
+
+/**
+ * @brief Gets the room an allocation takes in an arena
+ * @param size Bytes requested
+ * @return Bytes, rounded up to MEMORY_ARENA_ALIGNMENT
+ */
+inline size_t getMemoryArenaAllocationSize(size_t size)
+{
+	return (size + MEMORY_ARENA_ALIGNMENT - 1) & ~(size_t)(MEMORY_ARENA_ALIGNMENT - 1);
+}
+
+#endif
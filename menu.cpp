@@ -8,13 +8,60 @@
  */
 #include "menu.h"
 
+#include <algorithm>
 #include <chrono>
 #include <stdio.h>
+#include <thread>
 
-#define TOGGLE_LIMIT 6 // Maximum times the end symbol toggles during intro animation
+#include "assetLoader.h"
+#include "assetRegistry.h"
+#include "jobSystem.h"
+
+#define TOGGLE_LIMIT 6		   // Maximum times the end symbol toggles during intro animation
+#define FONT_GLYPH_COUNT 250   // Glyphs rasterized per font, from the space character on
+#define PENDING_FONT_COUNT 2   // Fonts decoded while the intro plays
+#define PENDING_MODEL_COUNT 15 // Models decoded while the intro plays
+
+struct PendingFont
+{
+	const char *file;
+	int size;
+};
+
+// Assets the intro does not use, decoded in the background while it plays
+static const PendingFont pending_fonts[PENDING_FONT_COUNT] = {
+	{FONTS_LOCATE("Gothic_regular.ttf"), 48},
+	{FONTS_LOCATE("Golden.otf"), 128},
+};
+
+static const char *const pending_models[PENDING_MODEL_COUNT] = {
+	MODELS_LOCATE("Pepsi_Basic/Pepsi_Can.obj"), // Demo model
+	MODELS_LOCATE("UFO/Low_poly_UFO.obj"),
+	MODELS_LOCATE("Solar_System/sun.obj"),
+	MODELS_LOCATE("Solar_System/mercury.obj"),
+	MODELS_LOCATE("Solar_System/venus.obj"),
+	MODELS_LOCATE("Solar_System/earth.obj"),
+	MODELS_LOCATE("Solar_System/mars.obj"),
+	MODELS_LOCATE("Solar_System/jupiter.obj"),
+	MODELS_LOCATE("Solar_System/saturn.obj"),
+	MODELS_LOCATE("Solar_System/uranus.obj"),
+	MODELS_LOCATE("Solar_System/neptune.obj"),
+	MODELS_LOCATE("Solar_System/asteroid1.obj"),
+	MODELS_LOCATE("Solar_System/asteroid2.obj"),
+	MODELS_LOCATE("Solar_System/asteroid3.obj"),
+	MODELS_LOCATE("Solar_System/asteroid4.obj"),
+};
+
+struct PendingAssets
+{
+	std::thread thread; // Runs the decoding jobs, done when joined
+	FontData fonts[PENDING_FONT_COUNT];
+	ModelData models[PENDING_MODEL_COUNT];
+};
 
 // Declarations of static/private functions
 static void intialize_resources(resource_t *Master_resource, monitor_t *monitor);
+static void start_pending_assets(resource_t *Master_resource);
 static void animation_intro(resource_t *Master_resource, monitor_t *monitor);
 
 /**
@@ -41,43 +88,48 @@ resource_t *intro(visual_sim_type_t *simVisualType, logical_sim_type_t *simLogic
 }
 
 /**
- * @brief Loads all fonts, models, shaders, and audio required for the intro sequence and later stages.
+ * @brief Loads the fonts and audio the intro sequence needs, and the shaders for later stages.
+ * Everything else starts decoding in the background; see finish_resources.
  * @param Master_resource Pointer to resource_t structure where resources will be stored.
  * @param monitor Pointer to monitor_t for determining rendering dimensions.
  */
 static void intialize_resources(resource_t *Master_resource, monitor_t *monitor)
 {
-	// Load fonts for different text styles
-	Master_resource->Font_Gothic = LoadFontEx(FONTS_LOCATE("Gothic_regular.ttf"), 48, 0, 250);
-	Master_resource->Font_Golden = LoadFontEx(FONTS_LOCATE("Golden.otf"), 128, 0, 250);
-	Master_resource->Font_Typerwriter = LoadFontEx(FONTS_LOCATE("TypeWriter.ttf"), 64, 0, 250);
-
-	// Load models (Pepsi can and UFO)
-	Master_resource->Model_PepsiCan = LoadModel(MODELS_LOCATE("Pepsi_Basic/Pepsi_Can.obj")); // Demo model
-	Master_resource->Model_SpaceShip = LoadModel(MODELS_LOCATE("UFO/Low_poly_UFO.obj"));
-	Master_resource->Model_Sun = LoadModel(MODELS_LOCATE("Solar_System/sun.obj"));
+	start_pending_assets(Master_resource);
+
+	Master_resource->Asset_registry = constructAssetRegistry();
+
+	// Load the intro font
+	Master_resource->Font_Typerwriter = LoadFontEx(FONTS_LOCATE("TypeWriter.ttf"), 64, 0, FONT_GLYPH_COUNT);
+
+	// Filled in by finish_resources, the addresses do not change
 	Master_resource->Models_Solar_System.push_back(&Master_resource->Model_Sun);
-	Master_resource->Model_Mercury = LoadModel(MODELS_LOCATE("Solar_System/mercury.obj"));
 	Master_resource->Models_Solar_System.push_back(&Master_resource->Model_Mercury);
-	Master_resource->Model_Venus = LoadModel(MODELS_LOCATE("Solar_System/venus.obj"));
 	Master_resource->Models_Solar_System.push_back(&Master_resource->Model_Venus);
-	Master_resource->Model_Earth = LoadModel(MODELS_LOCATE("Solar_System/earth.obj"));
 	Master_resource->Models_Solar_System.push_back(&Master_resource->Model_Earth);
-	Master_resource->Model_Mars = LoadModel(MODELS_LOCATE("Solar_System/mars.obj"));
 	Master_resource->Models_Solar_System.push_back(&Master_resource->Model_Mars);
-	Master_resource->Model_Jupiter = LoadModel(MODELS_LOCATE("Solar_System/jupiter.obj"));
 	Master_resource->Models_Solar_System.push_back(&Master_resource->Model_Jupiter);
-	Master_resource->Model_Saturn = LoadModel(MODELS_LOCATE("Solar_System/saturn.obj"));
 	Master_resource->Models_Solar_System.push_back(&Master_resource->Model_Saturn);
-	Master_resource->Model_Uranus = LoadModel(MODELS_LOCATE("Solar_System/uranus.obj"));
 	Master_resource->Models_Solar_System.push_back(&Master_resource->Model_Uranus);
-	Master_resource->Model_Neptune = LoadModel(MODELS_LOCATE("Solar_System/neptune.obj"));
 	Master_resource->Models_Solar_System.push_back(&Master_resource->Model_Neptune);
 
-	Master_resource->Models_Asteroids[0] = LoadModel(MODELS_LOCATE("Solar_System/asteroid1.obj"));
-	Master_resource->Models_Asteroids[1] = LoadModel(MODELS_LOCATE("Solar_System/asteroid2.obj"));
-	Master_resource->Models_Asteroids[2] = LoadModel(MODELS_LOCATE("Solar_System/asteroid3.obj"));
-	Master_resource->Models_Asteroids[3] = LoadModel(MODELS_LOCATE("Solar_System/asteroid4.obj"));
+	// Load the instancing shader: asteroids are drawn in batches, one draw call per mesh
+	Master_resource->Shader_instancing = LoadShader(SHADER_LOCATE("Shader_Instancing.vs"), SHADER_LOCATE("Shader_Instancing.fs"));
+	Master_resource->Shader_instancing.locs[SHADER_LOC_MATRIX_MVP] = GetShaderLocation(Master_resource->Shader_instancing, "mvp");
+	Master_resource->Shader_instancing.locs[SHADER_LOC_MATRIX_MODEL] = GetShaderLocationAttrib(Master_resource->Shader_instancing, "instanceTransform");
+
+	Master_resource->Mesh_AsteroidSphere = GenMeshSphere(1.0F, 4, 3);
+	Master_resource->Material_AsteroidSphere = LoadMaterialDefault();
+	Master_resource->Material_AsteroidSphere.shader = Master_resource->Shader_instancing;
+
+	// Load the point cloud shader
+	Master_resource->Shader_points = LoadShader(SHADER_LOCATE("Shader_Points.vs"), SHADER_LOCATE("Shader_Points.fs"));
+	Master_resource->Shader_points_corner_location = GetShaderLocationAttrib(Master_resource->Shader_points, "vertexCorner");
+	Master_resource->Shader_points_position_location = GetShaderLocationAttrib(Master_resource->Shader_points, "pointPosition");
+	Master_resource->Shader_points_color_location = GetShaderLocationAttrib(Master_resource->Shader_points, "pointColor");
+	Master_resource->Shader_points_mvp_location = GetShaderLocation(Master_resource->Shader_points, "mvp");
+	Master_resource->Shader_points_viewportSize_location = GetShaderLocation(Master_resource->Shader_points, "viewportSize");
+	Master_resource->Shader_points_pointSize_location = GetShaderLocation(Master_resource->Shader_points, "pointSize");
 
 	// Load horizontal and vertical blur shaders
 	Master_resource->Shader_blur_h = LoadShader(0, SHADER_LOCATE("Shader_Blur_h.fs"));
@@ -90,18 +142,111 @@ static void intialize_resources(resource_t *Master_resource, monitor_t *monitor)
 	Master_resource->Shader_blur_v_renderHeight = GetShaderLocation(Master_resource->Shader_blur_v, "renderHeight");
 	Master_resource->Shader_blur_v_renderWidth = GetShaderLocation(Master_resource->Shader_blur_v, "renderWidth");
 
+	// Load the downsampling shader: the blur runs on a quarter resolution copy of the scene
+	Master_resource->Shader_downsample = LoadShader(0, SHADER_LOCATE("Shader_Downsample.fs"));
+	Master_resource->Shader_downsample_texelSize_location = GetShaderLocation(Master_resource->Shader_downsample, "texelSize");
+
+	Vector2 texelSize = {1.0F / monitor->width, 1.0F / monitor->height};
+	SetShaderValue(Master_resource->Shader_downsample, Master_resource->Shader_downsample_texelSize_location, &texelSize, SHADER_UNIFORM_VEC2);
+
 	update_blur_shader(Master_resource, monitor, 5.0);
 
 	// Load typewriter sound effects
 	for (int i = 0; i < TYPE_COUNTER; i++)
 	{
-		Master_resource->Typewriter_forward[i] = LoadSound(AUDIO_LOCATE("Typewriter_forward.wav"));
-		Master_resource->Typewriter_backward[i] = LoadSound(AUDIO_LOCATE("Typewriter_backward.wav"));
+		Master_resource->Typewriter_forward[i] = loadSharedSound(Master_resource->Asset_registry, AUDIO_LOCATE("Typewriter_forward.wav"));
+		Master_resource->Typewriter_backward[i] = loadSharedSound(Master_resource->Asset_registry, AUDIO_LOCATE("Typewriter_backward.wav"));
 	}
 
-	// Create render textures for applying blur
+	// Create render textures for applying blur, filtered so they can be sampled between texels
 	Master_resource->Texture_Buffer1 = LoadRenderTexture(monitor->width, monitor->height);
-	Master_resource->Texture_Buffer2 = LoadRenderTexture(monitor->width, monitor->height);
+	Master_resource->Texture_BlurBuffer1 = LoadRenderTexture(std::max(1, (int)monitor->width / BLUR_DOWNSAMPLE), std::max(1, (int)monitor->height / BLUR_DOWNSAMPLE));
+	Master_resource->Texture_BlurBuffer2 = LoadRenderTexture(std::max(1, (int)monitor->width / BLUR_DOWNSAMPLE), std::max(1, (int)monitor->height / BLUR_DOWNSAMPLE));
+
+	SetTextureFilter(Master_resource->Texture_Buffer1.texture, TEXTURE_FILTER_BILINEAR);
+	SetTextureFilter(Master_resource->Texture_BlurBuffer1.texture, TEXTURE_FILTER_BILINEAR);
+	SetTextureFilter(Master_resource->Texture_BlurBuffer2.texture, TEXTURE_FILTER_BILINEAR);
+}
+
+/**
+ * @brief Decodes every pending font and model, spread over the job system.
+ * @param pending Pointer to the PendingAssets being filled.
+ */
+static void decode_pending_assets(PendingAssets *pending)
+{
+	parallelFor(getJobSystem(), 0, PENDING_FONT_COUNT + PENDING_MODEL_COUNT, 1, [=](unsigned int begin, unsigned int end)
+				{
+					for (unsigned int i = begin; i < end; i++)
+					{
+						if (i < PENDING_FONT_COUNT)
+							decodeFontFile(pending_fonts[i].file, pending_fonts[i].size, FONT_GLYPH_COUNT, &pending->fonts[i]);
+						else
+							decodeModelFile(pending_models[i - PENDING_FONT_COUNT], &pending->models[i - PENDING_FONT_COUNT]);
+					}
+				});
+}
+
+/**
+ * @brief Starts decoding the assets the intro does not use, on a thread of its own so the intro keeps playing.
+ * Only the CPU work runs there; the GPU uploads wait for finish_resources.
+ * @param Master_resource Pointer to resource_t structure that will hold the pending assets.
+ */
+static void start_pending_assets(resource_t *Master_resource)
+{
+	PendingAssets *pending = new PendingAssets;
+
+	Master_resource->Pending_assets = pending;
+	pending->thread = std::thread(decode_pending_assets, pending);
+}
+
+/**
+ * @brief Waits for the background decoding and uploads its fonts and models to the GPU.
+ * Must be called from the main thread before anything draws them.
+ * @param Master_resource Pointer to resource_t structure with pending assets.
+ */
+void finish_resources(resource_t *Master_resource)
+{
+	PendingAssets *pending = Master_resource->Pending_assets;
+
+	if (!pending)
+		return;
+
+	pending->thread.join();
+
+	// In the order of pending_fonts and pending_models
+	Font *fonts[PENDING_FONT_COUNT] = {&Master_resource->Font_Gothic, &Master_resource->Font_Golden};
+	Model *models[PENDING_MODEL_COUNT] = {
+		&Master_resource->Model_PepsiCan,
+		&Master_resource->Model_SpaceShip,
+		&Master_resource->Model_Sun,
+		&Master_resource->Model_Mercury,
+		&Master_resource->Model_Venus,
+		&Master_resource->Model_Earth,
+		&Master_resource->Model_Mars,
+		&Master_resource->Model_Jupiter,
+		&Master_resource->Model_Saturn,
+		&Master_resource->Model_Uranus,
+		&Master_resource->Model_Neptune,
+		&Master_resource->Models_Asteroids[0],
+		&Master_resource->Models_Asteroids[1],
+		&Master_resource->Models_Asteroids[2],
+		&Master_resource->Models_Asteroids[3],
+	};
+
+	for (int i = 0; i < PENDING_FONT_COUNT; i++)
+		*fonts[i] = uploadFontData(&pending->fonts[i]);
+
+	for (int i = 0; i < PENDING_MODEL_COUNT; i++)
+		*models[i] = uploadSharedModel(Master_resource->Asset_registry, &pending->models[i]);
+
+	for (int i = 0; i < ASTEROID_MODEL_COUNT; i++)
+	{
+		for (int j = 0; j < Master_resource->Models_Asteroids[i].materialCount; j++)
+			Master_resource->Models_Asteroids[i].materials[j].shader = Master_resource->Shader_instancing;
+	}
+
+	delete pending;
+	Master_resource->Pending_assets = NULL;
 }
 
 /**
@@ -110,44 +255,47 @@ static void intialize_resources(resource_t *Master_resource, monitor_t *monitor)
  */
 void kill_resources(resource_t *Master_resource)
 {
+	finish_resources(Master_resource); // Nothing may still be decoding
 
 	// Unload fonts
 	UnloadFont(Master_resource->Font_Gothic);
 	UnloadFont(Master_resource->Font_Golden);
 	UnloadFont(Master_resource->Font_Typerwriter);
 
-	// Unload models
-	UnloadModel(Master_resource->Model_PepsiCan);
-	UnloadModel(Master_resource->Model_SpaceShip);
-	UnloadModel(Master_resource->Model_Sun);
-	UnloadModel(Master_resource->Model_Mercury);
-	UnloadModel(Master_resource->Model_Venus);
-	UnloadModel(Master_resource->Model_Earth);
-	UnloadModel(Master_resource->Model_Mars);
-	UnloadModel(Master_resource->Model_Jupiter);
-	UnloadModel(Master_resource->Model_Saturn);
-	UnloadModel(Master_resource->Model_Uranus);
-	UnloadModel(Master_resource->Model_Neptune);
-
-	for (int i = 0; i < 4; i++)
+	// Unload models, their meshes belong to Asset_registry
+	unloadSharedModel(Master_resource->Model_PepsiCan);
+	unloadSharedModel(Master_resource->Model_SpaceShip);
+	unloadSharedModel(Master_resource->Model_Sun);
+	unloadSharedModel(Master_resource->Model_Mercury);
+	unloadSharedModel(Master_resource->Model_Venus);
+	unloadSharedModel(Master_resource->Model_Earth);
+	unloadSharedModel(Master_resource->Model_Mars);
+	unloadSharedModel(Master_resource->Model_Jupiter);
+	unloadSharedModel(Master_resource->Model_Saturn);
+	unloadSharedModel(Master_resource->Model_Uranus);
+	unloadSharedModel(Master_resource->Model_Neptune);
+
+	for (int i = 0; i < ASTEROID_MODEL_COUNT; i++)
 	{
-		UnloadModel(Master_resource->Models_Asteroids[i]);
+		unloadSharedModel(Master_resource->Models_Asteroids[i]);
 	}
 
+	UnloadMesh(Master_resource->Mesh_AsteroidSphere);
+
 	// Unload shaders
 	UnloadShader(Master_resource->Shader_blur_h);
 	UnloadShader(Master_resource->Shader_blur_v);
+	UnloadShader(Master_resource->Shader_downsample);
+	UnloadMaterial(Master_resource->Material_AsteroidSphere); // Also unloads Shader_instancing
+	UnloadShader(Master_resource->Shader_points);
 
 	// Unload render textures
 	UnloadRenderTexture(Master_resource->Texture_Buffer1);
-	UnloadRenderTexture(Master_resource->Texture_Buffer2);
+	UnloadRenderTexture(Master_resource->Texture_BlurBuffer1);
+	UnloadRenderTexture(Master_resource->Texture_BlurBuffer2);
 
-	// Unload sounds
-	for (int i = 0; i < TYPE_COUNTER; i++)
-	{
-		UnloadSound(Master_resource->Typewriter_forward[i]);
-		UnloadSound(Master_resource->Typewriter_backward[i]);
-	}
+	// Unload shared meshes and sounds
+	destroyAssetRegistry(Master_resource->Asset_registry);
 
 	delete Master_resource;
 }
@@ -260,33 +408,57 @@ static void animation_intro(resource_t *Master_resource, monitor_t *monitor)
 	}
 }
 
+/**
+ * @brief Draws a render texture over the whole current target, scaling it if the sizes differ.
+ * @param target Render texture to draw.
+ * @param width Width of the current target.
+ * @param height Height of the current target.
+ */
+static void draw_render_texture(RenderTexture2D target, float width, float height)
+{
+	// Render textures are stored upside down
+	DrawTexturePro(target.texture,
+				   (Rectangle){0, 0, (float)target.texture.width, (float)-target.texture.height},
+				   (Rectangle){0, 0, width, height},
+				   (Vector2){0, 0}, 0.0F, WHITE);
+}
+
 /**
  * @brief Begins a new drawing frame applying a two-pass blur effect using shaders.
+ * The scene is downsampled to 1 / BLUR_DOWNSAMPLE of its size, blurred there and scaled back up to the screen.
  * @param Master_resource Pointer to resource_t containing shader programs and render textures.
  */
 void BeginDrawing_with_blurry_filter(resource_t *Master_resource)
 {
-	// Render scene into Texture_Buffer2 applying horizontal blur
-	BeginTextureMode(Master_resource->Texture_Buffer2);
-	ClearBackground(BLACK);
+	float blurWidth = (float)Master_resource->Texture_BlurBuffer1.texture.width;
+	float blurHeight = (float)Master_resource->Texture_BlurBuffer1.texture.height;
+
+	// Downsample the scene into Texture_BlurBuffer1
+	BeginTextureMode(Master_resource->Texture_BlurBuffer1);
+	BeginShaderMode(Master_resource->Shader_downsample);
+	draw_render_texture(Master_resource->Texture_Buffer1, blurWidth, blurHeight);
+	EndShaderMode();
+	EndTextureMode();
 
+	// Horizontal blur into Texture_BlurBuffer2
+	BeginTextureMode(Master_resource->Texture_BlurBuffer2);
 	BeginShaderMode(Master_resource->Shader_blur_h);
-	DrawTextureRec(Master_resource->Texture_Buffer1.texture,
-				   (Rectangle){0, 0, (float)Master_resource->Texture_Buffer1.texture.width, (float)-Master_resource->Texture_Buffer1.texture.height},
-				   (Vector2){0, 0}, WHITE);
+	draw_render_texture(Master_resource->Texture_BlurBuffer1, blurWidth, blurHeight);
 	EndShaderMode();
+	EndTextureMode();
 
+	// Vertical blur back into Texture_BlurBuffer1
+	BeginTextureMode(Master_resource->Texture_BlurBuffer1);
+	BeginShaderMode(Master_resource->Shader_blur_v);
+	draw_render_texture(Master_resource->Texture_BlurBuffer2, blurWidth, blurHeight);
+	EndShaderMode();
 	EndTextureMode();
 
-	// Draw final result to the screen applying vertical blur
+	// Draw final result to the screen, scaled up with bilinear filtering
 	BeginDrawing();
 	ClearBackground(BLACK);
 
-	BeginShaderMode(Master_resource->Shader_blur_v);
-	DrawTextureRec(Master_resource->Texture_Buffer2.texture,
-				   (Rectangle){0, 0, (float)Master_resource->Texture_Buffer2.texture.width, (float)-Master_resource->Texture_Buffer2.texture.height},
-				   (Vector2){0, 0}, WHITE);
-	EndShaderMode();
+	draw_render_texture(Master_resource->Texture_BlurBuffer1, (float)Master_resource->Texture_Buffer1.texture.width, (float)Master_resource->Texture_Buffer1.texture.height);
 }
 
 /**
@@ -306,6 +478,7 @@ void BeginDrawing_without_blurry_filter(resource_t *Master_resource)
 
 /**
  * @brief Updates shader uniforms for horizontal and vertical blur shaders.
+ * The offsets are given in monitor pixels, so the blur keeps its size at any resolution of the blur buffers.
  * @param Master_resource Pointer to resource_t containing shader programs.
  * @param monitor Pointer to monitor_t providing render width and height for shader calculations.
  * @param factor Float value representing blur intensity.
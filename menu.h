@@ -27,6 +27,8 @@ long long timestamp_millis();
 
 bool isMouseHere(Vector2 mouse, Vector2 minXY, Vector2 maxXY);
 
+void finish_resources(resource_t *Master_resource);
+
 void kill_resources(resource_t *Master_resource);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,396 @@
+/**
+ * @brief Binary cache of decoded models, read through a memory mapping
+ * @author Mariano Caceres Smoler
+ * @author Enzo Nicolas Rosa Fernandez
+ * @author Francisco Chiusaroli
+ *
+ * The cache of model.obj is model.obj.cache, written by orbitalsim_cache. It
+ * holds the meshes with their vertices deduplicated and indexed, and the
+ * diffuse maps already decoded, so loading is mapping the file and pointing
+ * the Mesh and Image structs into it. Every array starts on a 16 byte
+ * boundary. The cache also lists the files it was built from (the OBJ, its MTL
+ * files and maps) with their modification times; if any of them changed, the
+ * cache is stale and the OBJ is parsed instead.
+ *
+ * Layout, in native byte order:
+ *   ModelCacheHeader
+ *   sourceCount x (ModelCacheSource, name)
+ *   meshCount x (ModelCacheMesh, vertices, texcoords, normals, indices if indexed)
+ *   materialCount x (ModelCacheMaterial, pixels)
+ */
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <unordered_map>
+
+#include "modelCache.h"
+
+#define MODEL_CACHE_MAGIC 0x434D534F // "OSMC" in little endian, so other byte orders are rejected
+#define MODEL_CACHE_VERSION 1
+#define MODEL_CACHE_ALIGNMENT 16
+#define MODEL_CACHE_EXTENSION ".cache"
+#define MODEL_CACHE_TEMPORARY_EXTENSION ".tmp"
+#define MAX_INDEXED_VERTICES 65536 // Mesh indices are unsigned short
+
+struct ModelCacheHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t sourceCount;
+	uint32_t meshCount;
+	uint32_t materialCount;
+	uint32_t reserved;
+};
+
+struct ModelCacheSource
+{
+	int64_t modTime; // As GetFileModTime, 0 if it did not exist
+	uint32_t nameLength;
+	uint32_t reserved;
+};
+
+struct ModelCacheMesh
+{
+	uint32_t vertexCount;
+	uint32_t triangleCount;
+	uint32_t indexed; // Otherwise every three vertices are a triangle
+	uint32_t material;
+};
+
+struct ModelCacheMaterial
+{
+	Color color;
+	int32_t width;
+	int32_t height;
+	int32_t mipmaps;
+	int32_t format;
+	uint32_t dataSize; // 0 if there is no diffuse map
+};
+
+// Position, texture coordinates and normal
+struct CacheVertex
+{
+	float values[8];
+
+	bool operator==(const CacheVertex &other) const
+	{
+		return !memcmp(values, other.values, sizeof(values));
+	}
+};
+
+struct CacheVertexHash
+{
+	size_t operator()(const CacheVertex &vertex) const
+	{
+		// FNV-1a
+		const unsigned char *bytes = (const unsigned char *)vertex.values;
+		uint64_t hash = 14695981039346656037ULL;
+
+		for (size_t i = 0; i < sizeof(vertex.values); i++)
+			hash = (hash ^ bytes[i]) * 1099511628211ULL;
+
+		return (size_t)hash;
+	}
+};
+
+struct CacheReader
+{
+	const unsigned char *data;
+	size_t size;
+	size_t offset;
+};
+
+/**
+ * @brief Takes the next block of a cache
+ *
+ * @param reader The cache being read
+ * @param size Bytes of the block
+ * @param alignment Boundary the block starts on
+ * @return The block, or NULL if the cache is too short
+ */
+static const void *readCacheBytes(CacheReader *reader, size_t size, size_t alignment)
+{
+	size_t offset = (reader->offset + alignment - 1) / alignment * alignment;
+
+	if (offset > reader->size || size > reader->size - offset)
+		return NULL;
+
+	reader->offset = offset + size;
+
+	return reader->data + offset;
+}
+
+static void appendCacheBytes(std::vector<unsigned char> &cache, const void *bytes, size_t size, size_t alignment)
+{
+	cache.resize((cache.size() + alignment - 1) / alignment * alignment, 0);
+	cache.insert(cache.end(), (const unsigned char *)bytes, (const unsigned char *)bytes + size);
+}
+
+/**
+ * @brief Gets where the cache of a model is
+ * @param fileName The OBJ file
+ * @return The cache file
+ */
+std::string getModelCachePath(const char *fileName)
+{
+	return std::string(fileName) + MODEL_CACHE_EXTENSION;
+}
+
+/**
+ * @brief Frees what readModelCache had allocated when the cache turns out to be unusable
+ * @return false
+ */
+static bool rejectModelCache(ModelData *data, MappedFile *cache)
+{
+	MemFree(data->meshes);
+	MemFree(data->meshMaterial);
+	MemFree(data->materialColor);
+	MemFree(data->materialImage);
+	destroyMappedFile(cache);
+
+	*data = {};
+
+	return false;
+}
+
+/**
+ * @brief Loads a model from its cache, if it is up to date
+ *
+ * Does not use the GPU, so it may run on any thread. The meshes and images
+ * point into the mapped cache until uploadModelData.
+ *
+ * @param fileName The OBJ file the cache was built from
+ * @param data Where the model is stored, empty on failure
+ * @return Whether the cache could be used
+ */
+bool readModelCache(const char *fileName, ModelData *data)
+{
+	*data = {};
+
+	MappedFile *cache = constructMappedFile(getModelCachePath(fileName).c_str());
+
+	if (!cache)
+		return false;
+
+	CacheReader reader = {cache->data, cache->size, 0};
+	const ModelCacheHeader *header = (const ModelCacheHeader *)readCacheBytes(&reader, sizeof(ModelCacheHeader), MODEL_CACHE_ALIGNMENT);
+
+	if (!header || header->magic != MODEL_CACHE_MAGIC || header->version != MODEL_CACHE_VERSION ||
+		!header->meshCount || !header->materialCount)
+		return rejectModelCache(data, cache);
+
+	std::string directory = getAssetDirectory(fileName);
+
+	for (uint32_t i = 0; i < header->sourceCount; i++)
+	{
+		const ModelCacheSource *source = (const ModelCacheSource *)readCacheBytes(&reader, sizeof(ModelCacheSource), 8);
+		const char *name = source ? (const char *)readCacheBytes(&reader, source->nameLength, 1) : NULL;
+
+		if (!name)
+			return rejectModelCache(data, cache);
+
+		std::string path = directory + std::string(name, source->nameLength);
+
+		if (GetFileModTime(path.c_str()) != source->modTime)
+			return rejectModelCache(data, cache); // Stale
+	}
+
+	data->meshCount = (int)header->meshCount;
+	data->meshes = (Mesh *)MemAlloc(header->meshCount * sizeof(Mesh));
+	data->meshMaterial = (int *)MemAlloc(header->meshCount * sizeof(int));
+	data->materialCount = (int)header->materialCount;
+	data->materialColor = (Color *)MemAlloc(header->materialCount * sizeof(Color));
+	data->materialImage = (Image *)MemAlloc(header->materialCount * sizeof(Image));
+
+	for (int i = 0; i < data->meshCount; i++)
+	{
+		const ModelCacheMesh *cacheMesh = (const ModelCacheMesh *)readCacheBytes(&reader, sizeof(ModelCacheMesh), MODEL_CACHE_ALIGNMENT);
+
+		if (!cacheMesh || cacheMesh->material >= header->materialCount)
+			return rejectModelCache(data, cache);
+
+		Mesh &mesh = data->meshes[i];
+		size_t vertexCount = cacheMesh->vertexCount;
+
+		mesh.vertexCount = (int)cacheMesh->vertexCount;
+		mesh.triangleCount = (int)cacheMesh->triangleCount;
+		mesh.vertices = (float *)readCacheBytes(&reader, vertexCount * 3 * sizeof(float), MODEL_CACHE_ALIGNMENT);
+		mesh.texcoords = (float *)readCacheBytes(&reader, vertexCount * 2 * sizeof(float), MODEL_CACHE_ALIGNMENT);
+		mesh.normals = (float *)readCacheBytes(&reader, vertexCount * 3 * sizeof(float), MODEL_CACHE_ALIGNMENT);
+
+		if (cacheMesh->indexed)
+			mesh.indices = (unsigned short *)readCacheBytes(&reader, (size_t)mesh.triangleCount * 3 * sizeof(unsigned short), MODEL_CACHE_ALIGNMENT);
+
+		if (!mesh.vertices || !mesh.texcoords || !mesh.normals || (cacheMesh->indexed && !mesh.indices))
+			return rejectModelCache(data, cache);
+
+		data->meshMaterial[i] = (int)cacheMesh->material;
+	}
+
+	for (int i = 0; i < data->materialCount; i++)
+	{
+		const ModelCacheMaterial *material = (const ModelCacheMaterial *)readCacheBytes(&reader, sizeof(ModelCacheMaterial), MODEL_CACHE_ALIGNMENT);
+
+		if (!material)
+			return rejectModelCache(data, cache);
+
+		data->materialColor[i] = material->color;
+
+		if (!material->dataSize)
+			continue;
+
+		Image &image = data->materialImage[i];
+
+		image.data = (void *)readCacheBytes(&reader, material->dataSize, MODEL_CACHE_ALIGNMENT);
+		image.width = material->width;
+		image.height = material->height;
+		image.mipmaps = material->mipmaps;
+		image.format = material->format;
+
+		if (!image.data || (int)material->dataSize != GetPixelDataSize(image.width, image.height, image.format))
+			return rejectModelCache(data, cache);
+	}
+
+	data->cache = cache;
+
+	return true;
+}
+
+/**
+ * @brief Writes the cache of a model parsed from its OBJ file
+ *
+ * @param fileName The OBJ file
+ * @param data The model, as decodeObjFile left it
+ * @param sources The files it was built from besides the OBJ, relative to its directory
+ * @return Whether the cache could be written
+ */
+bool writeModelCache(const char *fileName, const ModelData *data, const std::vector<std::string> &sources)
+{
+	std::string directory = getAssetDirectory(fileName);
+	std::vector<std::string> names(1, std::string(fileName).substr(directory.size()));
+	std::vector<unsigned char> cache;
+
+	names.insert(names.end(), sources.begin(), sources.end());
+
+	ModelCacheHeader header = {MODEL_CACHE_MAGIC, MODEL_CACHE_VERSION, (uint32_t)names.size(),
+							   (uint32_t)data->meshCount, (uint32_t)data->materialCount, 0};
+
+	appendCacheBytes(cache, &header, sizeof(header), MODEL_CACHE_ALIGNMENT);
+
+	for (size_t i = 0; i < names.size(); i++)
+	{
+		ModelCacheSource source = {(int64_t)GetFileModTime((directory + names[i]).c_str()), (uint32_t)names[i].size(), 0};
+
+		appendCacheBytes(cache, &source, sizeof(source), 8);
+		appendCacheBytes(cache, names[i].data(), names[i].size(), 1);
+	}
+
+	for (int i = 0; i < data->meshCount; i++)
+	{
+		const Mesh &mesh = data->meshes[i];
+		std::unordered_map<CacheVertex, unsigned short, CacheVertexHash> uniqueVertices;
+		std::vector<float> vertices;
+		std::vector<float> texcoords;
+		std::vector<float> normals;
+		std::vector<unsigned short> indices;
+
+		// Merge the corners the OBJ faces share
+		for (int j = 0; j < mesh.vertexCount; j++)
+		{
+			CacheVertex vertex = {};
+
+			memcpy(&vertex.values[0], &mesh.vertices[3 * j], 3 * sizeof(float));
+
+			if (mesh.texcoords)
+				memcpy(&vertex.values[3], &mesh.texcoords[2 * j], 2 * sizeof(float));
+
+			if (mesh.normals)
+				memcpy(&vertex.values[5], &mesh.normals[3 * j], 3 * sizeof(float));
+
+			std::unordered_map<CacheVertex, unsigned short, CacheVertexHash>::iterator found = uniqueVertices.find(vertex);
+
+			if (found != uniqueVertices.end())
+			{
+				indices.push_back(found->second);
+				continue;
+			}
+
+			if (uniqueVertices.size() >= MAX_INDEXED_VERTICES)
+				break;
+
+			unsigned short index = (unsigned short)uniqueVertices.size();
+
+			uniqueVertices[vertex] = index;
+			indices.push_back(index);
+			vertices.insert(vertices.end(), &vertex.values[0], &vertex.values[3]);
+			texcoords.insert(texcoords.end(), &vertex.values[3], &vertex.values[5]);
+			normals.insert(normals.end(), &vertex.values[5], &vertex.values[8]);
+		}
+
+		bool indexed = (indices.size() == (size_t)mesh.vertexCount);
+
+		// Too many distinct vertices for 16 bit indices: kept as they are
+		if (!indexed)
+		{
+			vertices.assign(mesh.vertices, mesh.vertices + 3 * mesh.vertexCount);
+			texcoords.assign(2 * mesh.vertexCount, 0.0F);
+			normals.assign(3 * mesh.vertexCount, 0.0F);
+
+			if (mesh.texcoords)
+				texcoords.assign(mesh.texcoords, mesh.texcoords + 2 * mesh.vertexCount);
+
+			if (mesh.normals)
+				normals.assign(mesh.normals, mesh.normals + 3 * mesh.vertexCount);
+		}
+
+		ModelCacheMesh cacheMesh = {(uint32_t)(vertices.size() / 3), (uint32_t)mesh.triangleCount,
+									indexed ? 1U : 0U, (uint32_t)data->meshMaterial[i]};
+
+		appendCacheBytes(cache, &cacheMesh, sizeof(cacheMesh), MODEL_CACHE_ALIGNMENT);
+		appendCacheBytes(cache, vertices.data(), vertices.size() * sizeof(float), MODEL_CACHE_ALIGNMENT);
+		appendCacheBytes(cache, texcoords.data(), texcoords.size() * sizeof(float), MODEL_CACHE_ALIGNMENT);
+		appendCacheBytes(cache, normals.data(), normals.size() * sizeof(float), MODEL_CACHE_ALIGNMENT);
+
+		if (indexed)
+			appendCacheBytes(cache, indices.data(), indices.size() * sizeof(unsigned short), MODEL_CACHE_ALIGNMENT);
+	}
+
+	for (int i = 0; i < data->materialCount; i++)
+	{
+		const Image &image = data->materialImage[i];
+		ModelCacheMaterial material = {data->materialColor[i], image.width, image.height, image.mipmaps, image.format, 0};
+
+		if (image.data)
+			material.dataSize = (uint32_t)GetPixelDataSize(image.width, image.height, image.format);
+
+		appendCacheBytes(cache, &material, sizeof(material), MODEL_CACHE_ALIGNMENT);
+		appendCacheBytes(cache, image.data, material.dataSize, MODEL_CACHE_ALIGNMENT);
+	}
+
+	// Written under a temporary name and renamed when complete, so a crash or a
+	// game starting meanwhile never finds a truncated cache
+	std::string cachePath = getModelCachePath(fileName);
+	std::string temporaryPath = cachePath + MODEL_CACHE_TEMPORARY_EXTENSION;
+	FILE *file = fopen(temporaryPath.c_str(), "wb");
+
+	if (!file)
+		return false;
+
+	bool written = (fwrite(cache.data(), 1, cache.size(), file) == cache.size());
+
+	written = !fclose(file) && written;
+
+#if defined(_WIN32)
+	// rename does not replace existing files on Windows
+	if (written)
+		remove(cachePath.c_str());
+#endif
+
+	written = written && !rename(temporaryPath.c_str(), cachePath.c_str());
+
+	if (!written)
+		remove(temporaryPath.c_str());
+
+	return written;
+}
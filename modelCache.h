@@ -0,0 +1,22 @@
+/**
+ * @brief Binary cache of decoded models, read through a memory mapping
+ * @author Mariano Caceres Smoler
+ * @author Enzo Nicolas Rosa Fernandez
+ * @author Francisco Chiusaroli
+ */
+
+#ifndef MODELCACHE_H
+#define MODELCACHE_H
+
+#include <string>
+#include <vector>
+
+#include "assetLoader.h"
+
+std::string getModelCachePath(const char *fileName);
+
+bool readModelCache(const char *fileName, ModelData *data);
+
+bool writeModelCache(const char *fileName, const ModelData *data, const std::vector<std::string> &sources);
+
+#endif
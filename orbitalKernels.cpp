@@ -0,0 +1,616 @@
+/**
+ * @brief Vectorized kernels for the orbital simulation
+ * @author Mariano Caceres Smoler
+ * @author Enzo Nicolas Rosa Fernandez
+ * @author Francisco Chiusaroli
+ *
+ * Each kernel is compiled for several instruction sets and the fastest one
+ * supported by the running CPU is picked the first time it is called.
+ *
+ * Sources:
+ * https://gcc.gnu.org/onlinedocs/gcc/x86-Function-Attributes.html ; Per-function target ISA
+ * https://en.wikipedia.org/wiki/Fast_inverse_square_root#Newton's_method ; Refining rsqrt estimates
+ */
+
+#include <atomic>
+#include <cmath>
+
+#include "configuration.h"
+#include "orbitalKernels.h"
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define ORBITALKERNELS_X86
+#include <immintrin.h>
+#endif
+
+/**
+ * @brief Finds the best instruction set supported by the running CPU
+ * @return The detected SIMD level
+ */
+static simd_level_t detectSimdLevel()
+{
+#ifdef ORBITALKERNELS_X86
+	__builtin_cpu_init();
+
+	if (__builtin_cpu_supports("avx512f"))
+		return SIMD_AVX512;
+	if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+		return SIMD_AVX2;
+	if (__builtin_cpu_supports("sse2"))
+		return SIMD_SSE2;
+#endif
+
+	return SIMD_SCALAR;
+}
+
+/**
+ * @brief Gets the best instruction set supported by the running CPU, detected once
+ *
+ * Kernels first run inside jobs, on several workers at once: the detection is
+ * left to the initialization of a local static, which C++11 makes thread-safe.
+ *
+ * @return The supported SIMD level
+ */
+static simd_level_t getSupportedSimdLevel()
+{
+	static const simd_level_t supportedLevel = detectSimdLevel();
+
+	return supportedLevel;
+}
+
+/**
+ * @brief Gets the level the kernels are dispatched to, which setSimdLevel may lower
+ * @return The selected level, shared by every thread
+ */
+static std::atomic<simd_level_t> &getSelectedSimdLevel()
+{
+	static std::atomic<simd_level_t> selectedLevel(getSupportedSimdLevel());
+
+	return selectedLevel;
+}
+
+/**
+ * @brief Gets the SIMD level the kernels are dispatched to
+ * @return The active SIMD level
+ */
+simd_level_t getSimdLevel()
+{
+	return getSelectedSimdLevel().load(std::memory_order_relaxed);
+}
+
+/**
+ * @brief Forces the kernels down to a given SIMD level (useful for benchmarking)
+ *
+ * @param level Requested level, clamped to what the CPU supports
+ * @return The level actually selected
+ */
+simd_level_t setSimdLevel(simd_level_t level)
+{
+	simd_level_t supported = getSupportedSimdLevel();
+	simd_level_t selected = (level < supported) ? level : supported;
+
+	getSelectedSimdLevel().store(selected, std::memory_order_relaxed);
+
+	return selected;
+}
+
+/**
+ * @brief Gets a printable name for a SIMD level
+ * @param level The SIMD level
+ * @return The name of the level
+ */
+const char *getSimdLevelName(simd_level_t level)
+{
+	switch (level)
+	{
+	case SIMD_SSE2:
+		return "sse2";
+	case SIMD_AVX2:
+		return "avx2";
+	case SIMD_AVX512:
+		return "avx512";
+	default:
+		return "scalar";
+	}
+}
+
+/**
+ * @brief Drifts and kicks bodies [first, count) around a single attractor, one at a time
+ *
+ * Offsets from the attractor are taken at position precision and the force is
+ * computed at velocity precision.
+ */
+template <typename position_t, typename velocity_t>
+static void updateCentralGravityScalar(position_t *posX, position_t *posY, position_t *posZ,
+									   velocity_t *velX, velocity_t *velY, velocity_t *velZ,
+									   unsigned int first, unsigned int count,
+									   position_t centerX, position_t centerY, position_t centerZ,
+									   velocity_t centerGM, velocity_t drift, velocity_t kick)
+{
+	for (unsigned int i = first; i < count; i++)
+	{
+		posX[i] += velX[i] * drift;
+		posY[i] += velY[i] * drift;
+		posZ[i] += velZ[i] * drift;
+
+		velocity_t dx = (velocity_t)(posX[i] - centerX);
+		velocity_t dy = (velocity_t)(posY[i] - centerY);
+		velocity_t dz = (velocity_t)(posZ[i] - centerZ);
+
+		velocity_t norm = NORM(dx, dy, dz);
+
+		if (norm != 0)
+		{
+			// Divided in two steps so norm^3 does not overflow a float far from the center
+			velocity_t factor = (centerGM * kick / norm) / (norm * norm);
+
+			velX[i] += dx * factor;
+			velY[i] += dy * factor;
+			velZ[i] += dz * factor;
+		}
+	}
+}
+
+#ifdef ORBITALKERNELS_X86
+
+/**
+ * @brief SSE2 version: 8 bodies per iteration (two 4-wide registers)
+ * @return Index of the first body left for the scalar tail
+ */
+__attribute__((target("sse2"))) static unsigned int updateCentralGravitySSE2(float *posX, float *posY, float *posZ,
+																			   float *velX, float *velY, float *velZ,
+																			   unsigned int count,
+																			   float centerX, float centerY, float centerZ,
+																			   float centerGM, float drift, float kick)
+{
+	const __m128 dt = _mm_set1_ps(drift);
+	const __m128 cx = _mm_set1_ps(centerX);
+	const __m128 cy = _mm_set1_ps(centerY);
+	const __m128 cz = _mm_set1_ps(centerZ);
+	const __m128 gmdt = _mm_set1_ps(centerGM * kick);
+	const __m128 half = _mm_set1_ps(0.5F);
+	const __m128 threeHalves = _mm_set1_ps(1.5F);
+	const __m128 zero = _mm_setzero_ps();
+
+	unsigned int i = 0;
+
+	for (; i + 8 <= count; i += 8)
+	{
+		for (unsigned int j = i; j < i + 8; j += 4)
+		{
+			__m128 px = _mm_loadu_ps(posX + j);
+			__m128 py = _mm_loadu_ps(posY + j);
+			__m128 pz = _mm_loadu_ps(posZ + j);
+			__m128 vx = _mm_loadu_ps(velX + j);
+			__m128 vy = _mm_loadu_ps(velY + j);
+			__m128 vz = _mm_loadu_ps(velZ + j);
+
+			px = _mm_add_ps(px, _mm_mul_ps(vx, dt));
+			py = _mm_add_ps(py, _mm_mul_ps(vy, dt));
+			pz = _mm_add_ps(pz, _mm_mul_ps(vz, dt));
+
+			__m128 dx = _mm_sub_ps(px, cx);
+			__m128 dy = _mm_sub_ps(py, cy);
+			__m128 dz = _mm_sub_ps(pz, cz);
+			__m128 r2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+
+			// 1/r from the hardware estimate plus one Newton-Raphson step
+			__m128 inv = _mm_rsqrt_ps(r2);
+			inv = _mm_mul_ps(inv, _mm_sub_ps(threeHalves, _mm_mul_ps(_mm_mul_ps(half, r2), _mm_mul_ps(inv, inv))));
+
+			__m128 factor = _mm_mul_ps(_mm_mul_ps(gmdt, inv), _mm_mul_ps(inv, inv));
+			factor = _mm_and_ps(factor, _mm_cmpgt_ps(r2, zero));
+
+			_mm_storeu_ps(posX + j, px);
+			_mm_storeu_ps(posY + j, py);
+			_mm_storeu_ps(posZ + j, pz);
+			_mm_storeu_ps(velX + j, _mm_add_ps(vx, _mm_mul_ps(dx, factor)));
+			_mm_storeu_ps(velY + j, _mm_add_ps(vy, _mm_mul_ps(dy, factor)));
+			_mm_storeu_ps(velZ + j, _mm_add_ps(vz, _mm_mul_ps(dz, factor)));
+		}
+	}
+
+	return i;
+}
+
+/**
+ * @brief AVX2 version: 8 bodies per iteration
+ * @return Index of the first body left for the scalar tail
+ */
+__attribute__((target("avx2,fma"))) static unsigned int updateCentralGravityAVX2(float *posX, float *posY, float *posZ,
+																				   float *velX, float *velY, float *velZ,
+																				   unsigned int count,
+																				   float centerX, float centerY, float centerZ,
+																				   float centerGM, float drift, float kick)
+{
+	const __m256 dt = _mm256_set1_ps(drift);
+	const __m256 cx = _mm256_set1_ps(centerX);
+	const __m256 cy = _mm256_set1_ps(centerY);
+	const __m256 cz = _mm256_set1_ps(centerZ);
+	const __m256 gmdt = _mm256_set1_ps(centerGM * kick);
+	const __m256 half = _mm256_set1_ps(0.5F);
+	const __m256 threeHalves = _mm256_set1_ps(1.5F);
+	const __m256 zero = _mm256_setzero_ps();
+
+	unsigned int i = 0;
+
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256 vx = _mm256_loadu_ps(velX + i);
+		__m256 vy = _mm256_loadu_ps(velY + i);
+		__m256 vz = _mm256_loadu_ps(velZ + i);
+		__m256 px = _mm256_fmadd_ps(vx, dt, _mm256_loadu_ps(posX + i));
+		__m256 py = _mm256_fmadd_ps(vy, dt, _mm256_loadu_ps(posY + i));
+		__m256 pz = _mm256_fmadd_ps(vz, dt, _mm256_loadu_ps(posZ + i));
+
+		__m256 dx = _mm256_sub_ps(px, cx);
+		__m256 dy = _mm256_sub_ps(py, cy);
+		__m256 dz = _mm256_sub_ps(pz, cz);
+		__m256 r2 = _mm256_fmadd_ps(dz, dz, _mm256_fmadd_ps(dy, dy, _mm256_mul_ps(dx, dx)));
+
+		// 1/r from the hardware estimate plus one Newton-Raphson step
+		__m256 inv = _mm256_rsqrt_ps(r2);
+		inv = _mm256_mul_ps(inv, _mm256_fnmadd_ps(_mm256_mul_ps(half, r2), _mm256_mul_ps(inv, inv), threeHalves));
+
+		__m256 factor = _mm256_mul_ps(_mm256_mul_ps(gmdt, inv), _mm256_mul_ps(inv, inv));
+		factor = _mm256_and_ps(factor, _mm256_cmp_ps(r2, zero, _CMP_GT_OQ));
+
+		_mm256_storeu_ps(posX + i, px);
+		_mm256_storeu_ps(posY + i, py);
+		_mm256_storeu_ps(posZ + i, pz);
+		_mm256_storeu_ps(velX + i, _mm256_fmadd_ps(dx, factor, vx));
+		_mm256_storeu_ps(velY + i, _mm256_fmadd_ps(dy, factor, vy));
+		_mm256_storeu_ps(velZ + i, _mm256_fmadd_ps(dz, factor, vz));
+	}
+
+	return i;
+}
+
+/**
+ * @brief AVX-512 version: 16 bodies per iteration
+ * @return Index of the first body left for the scalar tail
+ */
+__attribute__((target("avx512f"))) static unsigned int updateCentralGravityAVX512(float *posX, float *posY, float *posZ,
+																					float *velX, float *velY, float *velZ,
+																					unsigned int count,
+																					float centerX, float centerY, float centerZ,
+																					float centerGM, float drift, float kick)
+{
+	const __m512 dt = _mm512_set1_ps(drift);
+	const __m512 cx = _mm512_set1_ps(centerX);
+	const __m512 cy = _mm512_set1_ps(centerY);
+	const __m512 cz = _mm512_set1_ps(centerZ);
+	const __m512 gmdt = _mm512_set1_ps(centerGM * kick);
+	const __m512 half = _mm512_set1_ps(0.5F);
+	const __m512 threeHalves = _mm512_set1_ps(1.5F);
+	const __m512 zero = _mm512_setzero_ps();
+
+	unsigned int i = 0;
+
+	for (; i + 16 <= count; i += 16)
+	{
+		__m512 vx = _mm512_loadu_ps(velX + i);
+		__m512 vy = _mm512_loadu_ps(velY + i);
+		__m512 vz = _mm512_loadu_ps(velZ + i);
+		__m512 px = _mm512_fmadd_ps(vx, dt, _mm512_loadu_ps(posX + i));
+		__m512 py = _mm512_fmadd_ps(vy, dt, _mm512_loadu_ps(posY + i));
+		__m512 pz = _mm512_fmadd_ps(vz, dt, _mm512_loadu_ps(posZ + i));
+
+		__m512 dx = _mm512_sub_ps(px, cx);
+		__m512 dy = _mm512_sub_ps(py, cy);
+		__m512 dz = _mm512_sub_ps(pz, cz);
+		__m512 r2 = _mm512_fmadd_ps(dz, dz, _mm512_fmadd_ps(dy, dy, _mm512_mul_ps(dx, dx)));
+
+		// 1/r from the 14-bit hardware estimate plus one Newton-Raphson step
+		__m512 inv = _mm512_rsqrt14_ps(r2);
+		inv = _mm512_mul_ps(inv, _mm512_fnmadd_ps(_mm512_mul_ps(half, r2), _mm512_mul_ps(inv, inv), threeHalves));
+
+		__mmask16 valid = _mm512_cmp_ps_mask(r2, zero, _CMP_GT_OQ);
+		__m512 factor = _mm512_maskz_mul_ps(valid, _mm512_mul_ps(gmdt, inv), _mm512_mul_ps(inv, inv));
+
+		_mm512_storeu_ps(posX + i, px);
+		_mm512_storeu_ps(posY + i, py);
+		_mm512_storeu_ps(posZ + i, pz);
+		_mm512_storeu_ps(velX + i, _mm512_fmadd_ps(dx, factor, vx));
+		_mm512_storeu_ps(velY + i, _mm512_fmadd_ps(dy, factor, vy));
+		_mm512_storeu_ps(velZ + i, _mm512_fmadd_ps(dz, factor, vz));
+	}
+
+	return i;
+}
+
+#endif
+
+/**
+ * @brief Advances bodies orbiting a single attractor by one integrator stage
+ *
+ * Positions are drifted with the current velocity, then velocities are kicked
+ * with the attractor's acceleration at the new position (same scheme as the
+ * rest of the simulation).
+ *
+ * @param posX, posY, posZ Body positions, updated in place
+ * @param velX, velY, velZ Body velocities, updated in place
+ * @param count Number of bodies in the arrays
+ * @param centerX, centerY, centerZ Position of the attractor
+ * @param centerGM -G * mass of the attractor
+ * @param drift Time the positions advance
+ * @param kick Time the velocities advance
+ */
+void updateCentralGravity(float *posX, float *posY, float *posZ,
+						  float *velX, float *velY, float *velZ,
+						  unsigned int count,
+						  float centerX, float centerY, float centerZ,
+						  float centerGM, float drift, float kick)
+{
+	unsigned int done = 0;
+
+#ifdef ORBITALKERNELS_X86
+	switch (getSimdLevel())
+	{
+	case SIMD_AVX512:
+		done = updateCentralGravityAVX512(posX, posY, posZ, velX, velY, velZ, count, centerX, centerY, centerZ, centerGM, drift, kick);
+		break;
+	case SIMD_AVX2:
+		done = updateCentralGravityAVX2(posX, posY, posZ, velX, velY, velZ, count, centerX, centerY, centerZ, centerGM, drift, kick);
+		break;
+	case SIMD_SSE2:
+		done = updateCentralGravitySSE2(posX, posY, posZ, velX, velY, velZ, count, centerX, centerY, centerZ, centerGM, drift, kick);
+		break;
+	default:
+		break;
+	}
+#endif
+
+	updateCentralGravityScalar(posX, posY, posZ, velX, velY, velZ, done, count, centerX, centerY, centerZ, centerGM, drift, kick);
+}
+
+/**
+ * @brief updateCentralGravity that also adds the conserved quantities of the
+ *        bodies after the step to a running sum
+ *
+ * The sums reuse the distance the force needs, so measuring costs no extra
+ * pass over the bodies. With kick = 0 the bodies are only drifted. Only used
+ * on the steps that are measured, so there is no SIMD path.
+ *
+ * @param mass Masses of the bodies
+ * @param sums Running sums; the potential energy is the one with the attractor
+ */
+template <typename position_t, typename velocity_t>
+void updateCentralGravityWithSums(position_t *posX, position_t *posY, position_t *posZ,
+								  velocity_t *velX, velocity_t *velY, velocity_t *velZ,
+								  const float *mass, unsigned int count,
+								  position_t centerX, position_t centerY, position_t centerZ,
+								  velocity_t centerGM, velocity_t drift, velocity_t kick,
+								  ConservationSums *sums)
+{
+	ConservationSums local = {};
+
+	for (unsigned int i = 0; i < count; i++)
+	{
+		posX[i] += velX[i] * drift;
+		posY[i] += velY[i] * drift;
+		posZ[i] += velZ[i] * drift;
+
+		double dx = (double)posX[i] - centerX;
+		double dy = (double)posY[i] - centerY;
+		double dz = (double)posZ[i] - centerZ;
+		double r2 = dx * dx + dy * dy + dz * dz;
+
+		if (r2 == 0)
+			continue;
+
+		// A single division serves the force and the potential
+		double inverse = 1 / sqrt(r2);
+
+		if (kick != 0)
+		{
+			double factor = centerGM * (double)kick * inverse * inverse * inverse;
+
+			velX[i] += (velocity_t)(dx * factor);
+			velY[i] += (velocity_t)(dy * factor);
+			velZ[i] += (velocity_t)(dz * factor);
+		}
+
+		double m = mass[i];
+		double vx = velX[i], vy = velY[i], vz = velZ[i];
+		double x = posX[i], y = posY[i], z = posZ[i];
+
+		local.mass += m;
+		local.kineticEnergy += 0.5 * m * (vx * vx + vy * vy + vz * vz);
+		local.potentialEnergy += centerGM * m * inverse;
+		local.momentumX += m * vx;
+		local.momentumY += m * vy;
+		local.momentumZ += m * vz;
+		local.angularMomentumX += m * (y * vz - z * vy);
+		local.angularMomentumY += m * (z * vx - x * vz);
+		local.angularMomentumZ += m * (x * vy - y * vx);
+	}
+
+	sums->mass += local.mass;
+	sums->kineticEnergy += local.kineticEnergy;
+	sums->potentialEnergy += local.potentialEnergy;
+	sums->momentumX += local.momentumX;
+	sums->momentumY += local.momentumY;
+	sums->momentumZ += local.momentumZ;
+	sums->angularMomentumX += local.angularMomentumX;
+	sums->angularMomentumY += local.angularMomentumY;
+	sums->angularMomentumZ += local.angularMomentumZ;
+}
+
+// One instance per precision_type_t
+template void updateCentralGravityWithSums(float *, float *, float *, float *, float *, float *,
+										   const float *, unsigned int, float, float, float,
+										   float, float, float, ConservationSums *);
+template void updateCentralGravityWithSums(double *, double *, double *, float *, float *, float *,
+										   const float *, unsigned int, double, double, double,
+										   float, float, float, ConservationSums *);
+template void updateCentralGravityWithSums(double *, double *, double *, double *, double *, double *,
+										   const float *, unsigned int, double, double, double,
+										   double, double, double, ConservationSums *);
+
+/**
+ * @brief Moves bodies [first, count) with their current velocity, one at a time
+ */
+template <typename position_t, typename velocity_t>
+static void driftPositionsScalar(position_t *posX, position_t *posY, position_t *posZ,
+								 const velocity_t *velX, const velocity_t *velY, const velocity_t *velZ,
+								 unsigned int first, unsigned int count, velocity_t drift)
+{
+	for (unsigned int i = first; i < count; i++)
+	{
+		posX[i] += velX[i] * drift;
+		posY[i] += velY[i] * drift;
+		posZ[i] += velZ[i] * drift;
+	}
+}
+
+#ifdef ORBITALKERNELS_X86
+
+/**
+ * @brief SSE2 version: 4 bodies per iteration
+ * @return Index of the first body left for the scalar tail
+ */
+__attribute__((target("sse2"))) static unsigned int driftPositionsSSE2(float *posX, float *posY, float *posZ,
+																		 const float *velX, const float *velY, const float *velZ,
+																		 unsigned int count, float drift)
+{
+	const __m128 dt = _mm_set1_ps(drift);
+
+	unsigned int i = 0;
+
+	for (; i + 4 <= count; i += 4)
+	{
+		_mm_storeu_ps(posX + i, _mm_add_ps(_mm_loadu_ps(posX + i), _mm_mul_ps(_mm_loadu_ps(velX + i), dt)));
+		_mm_storeu_ps(posY + i, _mm_add_ps(_mm_loadu_ps(posY + i), _mm_mul_ps(_mm_loadu_ps(velY + i), dt)));
+		_mm_storeu_ps(posZ + i, _mm_add_ps(_mm_loadu_ps(posZ + i), _mm_mul_ps(_mm_loadu_ps(velZ + i), dt)));
+	}
+
+	return i;
+}
+
+/**
+ * @brief AVX2 version: 8 bodies per iteration
+ * @return Index of the first body left for the scalar tail
+ */
+__attribute__((target("avx2,fma"))) static unsigned int driftPositionsAVX2(float *posX, float *posY, float *posZ,
+																			 const float *velX, const float *velY, const float *velZ,
+																			 unsigned int count, float drift)
+{
+	const __m256 dt = _mm256_set1_ps(drift);
+
+	unsigned int i = 0;
+
+	for (; i + 8 <= count; i += 8)
+	{
+		_mm256_storeu_ps(posX + i, _mm256_fmadd_ps(_mm256_loadu_ps(velX + i), dt, _mm256_loadu_ps(posX + i)));
+		_mm256_storeu_ps(posY + i, _mm256_fmadd_ps(_mm256_loadu_ps(velY + i), dt, _mm256_loadu_ps(posY + i)));
+		_mm256_storeu_ps(posZ + i, _mm256_fmadd_ps(_mm256_loadu_ps(velZ + i), dt, _mm256_loadu_ps(posZ + i)));
+	}
+
+	return i;
+}
+
+/**
+ * @brief AVX-512 version: 16 bodies per iteration
+ * @return Index of the first body left for the scalar tail
+ */
+__attribute__((target("avx512f"))) static unsigned int driftPositionsAVX512(float *posX, float *posY, float *posZ,
+																			  const float *velX, const float *velY, const float *velZ,
+																			  unsigned int count, float drift)
+{
+	const __m512 dt = _mm512_set1_ps(drift);
+
+	unsigned int i = 0;
+
+	for (; i + 16 <= count; i += 16)
+	{
+		_mm512_storeu_ps(posX + i, _mm512_fmadd_ps(_mm512_loadu_ps(velX + i), dt, _mm512_loadu_ps(posX + i)));
+		_mm512_storeu_ps(posY + i, _mm512_fmadd_ps(_mm512_loadu_ps(velY + i), dt, _mm512_loadu_ps(posY + i)));
+		_mm512_storeu_ps(posZ + i, _mm512_fmadd_ps(_mm512_loadu_ps(velZ + i), dt, _mm512_loadu_ps(posZ + i)));
+	}
+
+	return i;
+}
+
+#endif
+
+/**
+ * @brief Moves bodies with their current velocity, without computing any force
+ *
+ * @param posX, posY, posZ Body positions, updated in place
+ * @param velX, velY, velZ Body velocities
+ * @param count Number of bodies in the arrays
+ * @param drift Time the positions advance
+ */
+void driftPositions(float *posX, float *posY, float *posZ,
+					const float *velX, const float *velY, const float *velZ,
+					unsigned int count, float drift)
+{
+	unsigned int done = 0;
+
+#ifdef ORBITALKERNELS_X86
+	switch (getSimdLevel())
+	{
+	case SIMD_AVX512:
+		done = driftPositionsAVX512(posX, posY, posZ, velX, velY, velZ, count, drift);
+		break;
+	case SIMD_AVX2:
+		done = driftPositionsAVX2(posX, posY, posZ, velX, velY, velZ, count, drift);
+		break;
+	case SIMD_SSE2:
+		done = driftPositionsSSE2(posX, posY, posZ, velX, velY, velZ, count, drift);
+		break;
+	default:
+		break;
+	}
+#endif
+
+	driftPositionsScalar(posX, posY, posZ, velX, velY, velZ, done, count, drift);
+}
+
+/**
+ * @brief Mixed precision version of updateCentralGravity: double positions, float velocities
+ *
+ * Only the float version has hand-written SIMD paths; the others use the
+ * generic loop.
+ */
+void updateCentralGravity(double *posX, double *posY, double *posZ,
+						  float *velX, float *velY, float *velZ,
+						  unsigned int count,
+						  double centerX, double centerY, double centerZ,
+						  float centerGM, float drift, float kick)
+{
+	updateCentralGravityScalar(posX, posY, posZ, velX, velY, velZ, 0, count, centerX, centerY, centerZ, centerGM, drift, kick);
+}
+
+/**
+ * @brief Double precision version of updateCentralGravity
+ */
+void updateCentralGravity(double *posX, double *posY, double *posZ,
+						  double *velX, double *velY, double *velZ,
+						  unsigned int count,
+						  double centerX, double centerY, double centerZ,
+						  double centerGM, double drift, double kick)
+{
+	updateCentralGravityScalar<double, double>(posX, posY, posZ, velX, velY, velZ, 0, count, centerX, centerY, centerZ, centerGM, drift, kick);
+}
+
+/**
+ * @brief Mixed precision version of driftPositions: double positions, float velocities
+ */
+void driftPositions(double *posX, double *posY, double *posZ,
+					const float *velX, const float *velY, const float *velZ,
+					unsigned int count, float drift)
+{
+	driftPositionsScalar(posX, posY, posZ, velX, velY, velZ, 0, count, drift);
+}
+
+/**
+ * @brief Double precision version of driftPositions
+ */
+void driftPositions(double *posX, double *posY, double *posZ,
+					const double *velX, const double *velY, const double *velZ,
+					unsigned int count, double drift)
+{
+	driftPositionsScalar<double, double>(posX, posY, posZ, velX, velY, velZ, 0, count, drift);
+}
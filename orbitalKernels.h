@@ -0,0 +1,77 @@
+/**
+ * @brief Vectorized kernels for the orbital simulation
+ * @author Mariano Caceres Smoler
+ * @author Enzo Nicolas Rosa Fernandez
+ * @author Francisco Chiusaroli
+ */
+
+#ifndef ORBITALKERNELS_H
+#define ORBITALKERNELS_H
+
+// Instruction sets the kernels can be dispatched to, from slowest to fastest
+enum simd_level_t
+{
+	SIMD_SCALAR,
+	SIMD_SSE2,
+	SIMD_AVX2,
+	SIMD_AVX512
+};
+
+/**
+ * @brief Conserved quantities summed over a group of bodies, in double
+ */
+struct ConservationSums
+{
+	double mass;
+	double kineticEnergy;
+	double potentialEnergy;
+	double momentumX, momentumY, momentumZ;
+	double angularMomentumX, angularMomentumY, angularMomentumZ; // About the origin
+};
+
+simd_level_t getSimdLevel();
+
+simd_level_t setSimdLevel(simd_level_t level);
+
+const char *getSimdLevelName(simd_level_t level);
+
+void updateCentralGravity(float *posX, float *posY, float *posZ,
+						  float *velX, float *velY, float *velZ,
+						  unsigned int count,
+						  float centerX, float centerY, float centerZ,
+						  float centerGM, float drift, float kick);
+
+void updateCentralGravity(double *posX, double *posY, double *posZ,
+						  float *velX, float *velY, float *velZ,
+						  unsigned int count,
+						  double centerX, double centerY, double centerZ,
+						  float centerGM, float drift, float kick);
+
+void updateCentralGravity(double *posX, double *posY, double *posZ,
+						  double *velX, double *velY, double *velZ,
+						  unsigned int count,
+						  double centerX, double centerY, double centerZ,
+						  double centerGM, double drift, double kick);
+
+// Instantiated for float, mixed and double precision (see precision_type_t)
+template <typename position_t, typename velocity_t>
+void updateCentralGravityWithSums(position_t *posX, position_t *posY, position_t *posZ,
+								  velocity_t *velX, velocity_t *velY, velocity_t *velZ,
+								  const float *mass, unsigned int count,
+								  position_t centerX, position_t centerY, position_t centerZ,
+								  velocity_t centerGM, velocity_t drift, velocity_t kick,
+								  ConservationSums *sums);
+
+void driftPositions(float *posX, float *posY, float *posZ,
+					const float *velX, const float *velY, const float *velZ,
+					unsigned int count, float drift);
+
+void driftPositions(double *posX, double *posY, double *posZ,
+					const float *velX, const float *velY, const float *velZ,
+					unsigned int count, float drift);
+
+void driftPositions(double *posX, double *posY, double *posZ,
+					const double *velX, const double *velY, const double *velZ,
+					unsigned int count, double drift);
+
+#endif
@@ -10,43 +10,142 @@
 
 #include <cmath>
 #include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
 #include <math.h>
 #include <stdlib.h>
 
+#include "barnesHut.h"
 #include "configuration.h"
+#include "counterRandom.h"
+#include "directGravity.h"
 #include "ephemerides.h"
+#include "orbitalKernels.h"
 #include "orbitalSim.h"
 
 // Constant definitions
-#define GRAVITATIONAL_CONSTANT 6.6743E-11F
 #define ELASTIC_CONSTANT_PLANETS 5e12
 #define ELASTIC_CONSTANT_ASTEROIDS 10
 #define ASTEROIDS_MEAN_RADIUS 4E11F
 #define ASTEROIDS_APPLIED_RADIUS 5.0 * ASTEROIDS_MEAN_RADIUS
-#define ASTEROIDS_BODYNUM 3000
+#define BODIES_PER_JOB 1024 // Bodies updated by each job of a parallel step
+#define BARNES_HUT_DEFAULT_THETA 0.5F
+#define BLOCK_CHUNK_SIZE 64			  // Asteroids sharing a step level
+#define BLOCK_TIMESTEP_ACCURACY 0.02F // Longest step allowed, as a fraction of the dynamical time
+#define ASTEROID_RADIX_BITS 12		  // Digits of the sort of the asteroids by distance
+
+// Random draws of every asteroid
+#define ASTEROID_DRAW_RADIUS 0
+#define ASTEROID_DRAW_ANGLE 1
+#define ASTEROID_DRAW_SPEED 2
+#define ASTEROID_DRAW_VERTICAL_SPEED 3
+#define ASTEROID_DRAW_COUNT 4
+
+/**
+ * @brief One drift + kick stage of an integrator: positions advance drift * dt
+ *        with the current velocities, then velocities advance kick * dt with the
+ *        accelerations at the new positions
+ */
+struct IntegratorStage
+{
+	double drift;
+	double kick;
+};
+
+// 2^(1/3) based coefficients of the 4th order triple jump (Yoshida / Forest-Ruth)
+#define TRIPLE_JUMP_OUTER 1.3512071919596578  // 1 / (2 - 2^(1/3))
+#define TRIPLE_JUMP_INNER -1.7024143839193153 // -2^(1/3) / (2 - 2^(1/3))
+
+// The original scheme: drift, then kick with the new positions (1st order)
+static const IntegratorStage eulerStages[] = {{1.0, 1.0}};
+
+// Kick-drift-kick leapfrog (2nd order); the opening kick reuses the last step's accelerations
+static const IntegratorStage leapfrogStages[] = {{0.0, 0.5}, {1.0, 0.5}};
+
+// Yoshida: three leapfrog steps of w1, w0, w1 * dt, written in kick-drift-kick form (4th order)
+static const IntegratorStage yoshidaStages[] = {
+	{0.0F, TRIPLE_JUMP_OUTER / 2},
+	{TRIPLE_JUMP_OUTER, (TRIPLE_JUMP_OUTER + TRIPLE_JUMP_INNER) / 2},
+	{TRIPLE_JUMP_INNER, (TRIPLE_JUMP_INNER + TRIPLE_JUMP_OUTER) / 2},
+	{TRIPLE_JUMP_OUTER, TRIPLE_JUMP_OUTER / 2}};
+
+// Forest-Ruth: the same composition in drift-kick-drift (position) form (4th order)
+static const IntegratorStage forestRuthStages[] = {
+	{TRIPLE_JUMP_OUTER / 2, TRIPLE_JUMP_OUTER},
+	{(1 - TRIPLE_JUMP_OUTER) / 2, 1 - 2 * TRIPLE_JUMP_OUTER},
+	{(1 - TRIPLE_JUMP_OUTER) / 2, TRIPLE_JUMP_OUTER},
+	{TRIPLE_JUMP_OUTER / 2, 0.0}};
+
+/**
+ * @brief Runs an integrator stage using gravitational force model
+ * @param sim The orbital simulation
+ * @param state Body state of the current precision
+ * @param drift Drift time
+ * @param kick Kick time
+ * @param lastStage Whether the stage ends the step
+ * @param sums Where to add the conserved quantities after the stage, or NULL
+ */
+template <typename position_t, typename velocity_t>
+static void updateUsingGravity(OrbitalSim *sim, BodyState<position_t, velocity_t> *state, velocity_t drift, velocity_t kick,
+							   bool lastStage, ConservationSums *sums);
 
 /**
- * @brief Updates simulation using gravitational force model
+ * @brief Gives the opening half kick of their block to the asteroid chunks on longer blocks
  * @param sim The orbital simulation
+ * @param state Body state of the current precision
  */
-static void updateUsingGravity(OrbitalSim *sim);
+template <typename position_t, typename velocity_t>
+static void openAsteroidBlocks(OrbitalSim *sim, BodyState<position_t, velocity_t> *state);
 
 /**
- * @brief Updates simulation using springs elastic force model
+ * @brief Runs an integrator stage using springs elastic force model
  * @param sim The orbital simulation
+ * @param state Body state of the current precision
+ * @param drift Drift time
+ * @param kick Kick time
  */
-static void updateUsingSprings(OrbitalSim *sim);
+template <typename position_t, typename velocity_t>
+static void updateUsingSprings(OrbitalSim *sim, BodyState<position_t, velocity_t> *state, velocity_t drift, velocity_t kick);
 
 /**
- * @brief Gets a uniform random value in a range
+ * @brief Runs an integrator stage with accelerations from a separate pass over all
+ *        bodies (exact all-pairs or Barnes-Hut gravity)
+ * @param sim The orbital simulation
+ * @param state Body state of the current precision
+ * @param simType The force model
+ * @param drift Drift time
+ * @param kick Kick time
+ */
+template <typename position_t, typename velocity_t>
+static void updateUsingAccelerations(OrbitalSim *sim, BodyState<position_t, velocity_t> *state, int simType, velocity_t drift, velocity_t kick);
+
+/**
+ * @brief Gets a draw of an asteroid
  *
+ * @param key Key of the random stream
+ * @param asteroid Index of the asteroid in the stream
+ * @param draw Which of its draws, below ASTEROID_DRAW_COUNT
+ * @return 32 random bits
+ */
+static uint32_t getAsteroidDraw(uint64_t key, unsigned int asteroid, int draw)
+{
+	return getCounterRandom(key, (uint64_t)asteroid * ASTEROID_DRAW_COUNT + draw);
+}
+
+/**
+ * @brief Gets a uniform random value in a range, from a draw of an asteroid
+ *
+ * @param key Key of the random stream
+ * @param asteroid Index of the asteroid in the stream
+ * @param draw Which of its draws, below ASTEROID_DRAW_COUNT
  * @param min Minimum value
- * @param max Maximum value
+ * @param max Maximum value, never reached
  * @return The random value
  */
-float getRandomFloat(float min, float max)
+static float getAsteroidRandomFloat(uint64_t key, unsigned int asteroid, int draw, float min, float max)
 {
-	return min + (max - min) * rand() / (float)RAND_MAX;
+	return min + (max - min) * getCounterRandomUnit(getAsteroidDraw(key, asteroid, draw));
 }
 
 /**
@@ -54,23 +153,25 @@ float getRandomFloat(float min, float max)
  *
  * @param body An orbital body
  * @param centerMass The mass of the most massive object in the star system
+ * @param key Key of the random stream, see getCounterRandomKey
+ * @param asteroid Index of the asteroid in the stream: the same index always gives the same asteroid
  */
-void configureAsteroid(OrbitalBody *body, float centerMass)
+void configureAsteroid(OrbitalBody *body, float centerMass, uint64_t key, unsigned int asteroid)
 {
 	// Logit distribution
-	float x = getRandomFloat(0.3F, 1.0F);
+	float x = getAsteroidRandomFloat(key, asteroid, ASTEROID_DRAW_RADIUS, 0.3F, 1.0F);
 	float l = logf(x) - logf(1 - x) + 0.85F;
 
 	// https://mathworld.wolfram.com/DiskPointPicking.html
 	float r = ASTEROIDS_APPLIED_RADIUS * sqrtf(fabsf(l));
-	float phi = getRandomFloat(0, 2.0F * (float)M_PI);
+	float phi = getAsteroidRandomFloat(key, asteroid, ASTEROID_DRAW_ANGLE, 0, 2.0F * (float)M_PI);
 
 	// Surprise!
 	// phi = 0;
 
 	// https://en.wikipedia.org/wiki/Circular_orbit#Velocity
-	float v = sqrtf(GRAVITATIONAL_CONSTANT * centerMass / r) * getRandomFloat(0.6F, 1.2F);
-	float vy = getRandomFloat(-1E2F, 1E2F);
+	float v = sqrtf((float)GRAVITATIONAL_CONSTANT * centerMass / r) * getAsteroidRandomFloat(key, asteroid, ASTEROID_DRAW_SPEED, 0.6F, 1.2F);
+	float vy = getAsteroidRandomFloat(key, asteroid, ASTEROID_DRAW_VERTICAL_SPEED, -1E2F, 1E2F);
 
 	// Fill in with your own fields:
 	body->mass = 1E12F;	 // Typical asteroid weight: 1 billion tons
@@ -82,173 +183,1230 @@ void configureAsteroid(OrbitalBody *body, float centerMass)
 }
 
 /**
- * @brief Constructs an orbital simulation
+ * @brief Places random asteroids in a simulation, from the center outwards
  *
- * @param float The time step
- * @return The orbital simulation
+ * The distance of an asteroid to the center only grows with its radius draw,
+ * so the draws alone give the order: a radix sort of their 24 bits, ties in
+ * index order. Each job then configures and stores a range of asteroids. The
+ * asteroids only depend on the seed, not on the number of threads.
+ *
+ * @param sim The orbital simulation
+ * @param first Index of the first asteroid in the simulation
+ * @param count Number of asteroids
+ * @param centerMass The mass of the most massive object in the star system
+ * @param seed Seed of the random stream
+ */
+void configureAsteroids(OrbitalSim *sim, unsigned int first, unsigned int count, float centerMass, unsigned int seed)
+{
+	struct AsteroidOrder
+	{
+		uint32_t radiusBits; // The 24 bits of the radius draw that set the distance
+		uint32_t asteroid;
+	};
+
+	uint64_t key = getCounterRandomKey(seed);
+	std::vector<AsteroidOrder> order(count);
+	std::vector<AsteroidOrder> sorted(count);
+
+	parallelFor(sim->jobSystem, 0, count, BODIES_PER_JOB, [&](unsigned int begin, unsigned int end)
+				{
+					for (unsigned int i = begin; i < end; i++)
+						order[i] = {getAsteroidDraw(key, i, ASTEROID_DRAW_RADIUS) >> 8, i};
+				});
+
+	// Stored from the center outwards, so the asteroids of a chunk need similar steps
+	for (int shift = 0; shift < 24; shift += ASTEROID_RADIX_BITS)
+	{
+		std::vector<unsigned int> offsets(1 << ASTEROID_RADIX_BITS, 0);
+		unsigned int mask = (1 << ASTEROID_RADIX_BITS) - 1;
+
+		for (const AsteroidOrder &entry : order)
+			offsets[(entry.radiusBits >> shift) & mask]++;
+
+		unsigned int offset = 0;
+
+		for (unsigned int &digitOffset : offsets)
+		{
+			unsigned int digitCount = digitOffset;
+
+			digitOffset = offset;
+			offset += digitCount;
+		}
+
+		for (const AsteroidOrder &entry : order)
+			sorted[offsets[(entry.radiusBits >> shift) & mask]++] = entry;
+
+		order.swap(sorted);
+	}
+
+	const AsteroidOrder *orderData = order.data();
+
+	parallelFor(sim->jobSystem, 0, count, BODIES_PER_JOB, [=](unsigned int begin, unsigned int end)
+				{
+					for (unsigned int i = begin; i < end; i++)
+					{
+						OrbitalBody body;
+
+						configureAsteroid(&body, centerMass, key, orderData[i].asteroid);
+						setOrbitalBody(sim, first + i, &body);
+					}
+				});
+}
+
+/**
+ * @brief Gets the index of the most massive body of the star system
+ * @param sim The orbital simulation
+ * @return Index of the body of the star system
+ */
+static int getCentralBody(const OrbitalSim *sim)
+{
+	float biggestMass = 0;
+	int indexOfMostMassiveBody = 0;
+
+	for (unsigned int i = 0; i < sim->starSystemCount; i++)
+	{
+		if (sim->bodiesList.mass[i] > biggestMass)
+		{
+			biggestMass = sim->bodiesList.mass[i];
+			indexOfMostMassiveBody = i;
+		}
+	}
+
+	return indexOfMostMassiveBody;
+}
+
+/**
+ * @brief Gets the number of asteroid chunks with their own step level
+ * @param sim The orbital simulation
+ * @return The number of chunks, the size of chunkLevel
+ */
+unsigned int getOrbitalSimChunkCount(const OrbitalSim *sim)
+{
+	return (sim->bodyCount - sim->starSystemCount + BLOCK_CHUNK_SIZE - 1) / BLOCK_CHUNK_SIZE;
+}
+
+/**
+ * @brief Picks the step level of every asteroid chunk for the next block
+ *
+ * The local dynamical time sqrt(r^3 / GM) sets the step: an asteroid at level L
+ * takes steps of 2^L timesteps, the longest that stay below a fraction of it.
+ * A chunk steps at the level of its most demanding asteroid. Levels are compared
+ * on r^6 so no square root is needed.
+ *
+ * @param sim The orbital simulation
+ * @param state Body state of the current precision
+ */
+template <typename position_t, typename velocity_t>
+static void updateStepLevels(OrbitalSim *sim, const BodyState<position_t, velocity_t> *state)
+{
+	int center = getCentralBody(sim);
+	double centerX = state->positionX[center];
+	double centerY = state->positionY[center];
+	double centerZ = state->positionZ[center];
+	double centerGM = GRAVITATIONAL_CONSTANT * (double)sim->bodiesList.mass[center];
+
+	// Level L is allowed from r^6 >= (GM * (2^L * timeStep / accuracy)^2)^2
+	double levelLimit[BLOCK_LEVEL_COUNT];
+
+	for (int level = 0; level < BLOCK_LEVEL_COUNT; level++)
+	{
+		double step = sim->timeStep * (double)(1 << level) / BLOCK_TIMESTEP_ACCURACY;
+
+		levelLimit[level] = (centerGM * step * step) * (centerGM * step * step);
+	}
+
+	parallelFor(sim->jobSystem, 0, getOrbitalSimChunkCount(sim), BODIES_PER_JOB / BLOCK_CHUNK_SIZE,
+				[&](unsigned int begin, unsigned int end)
+				{
+					for (unsigned int chunk = begin; chunk < end; chunk++)
+					{
+						unsigned int first = sim->starSystemCount + chunk * BLOCK_CHUNK_SIZE;
+						unsigned int last = std::min(sim->bodyCount, first + BLOCK_CHUNK_SIZE);
+						int chunkLevel = BLOCK_LEVEL_COUNT - 1;
+
+						for (unsigned int i = first; i < last; i++)
+						{
+							double dx = (double)state->positionX[i] - centerX;
+							double dy = (double)state->positionY[i] - centerY;
+							double dz = (double)state->positionZ[i] - centerZ;
+							double r2 = dx * dx + dy * dy + dz * dz;
+
+							while (chunkLevel > 0 && r2 * r2 * r2 < levelLimit[chunkLevel])
+								chunkLevel--;
+						}
+
+						sim->chunkLevel[chunk] = (unsigned char)chunkLevel;
+					}
+				});
+}
+
+/**
+ * @brief Gets the room the hot body arrays of a precision take in an arena
+ * @param bodyCount Number of bodies
+ * @return Bytes
+ */
+template <typename position_t, typename velocity_t>
+static size_t getBodyStateSize(unsigned int bodyCount)
+{
+	return 3 * getMemoryArenaAllocationSize(sizeof(position_t) * (size_t)bodyCount) +
+		   6 * getMemoryArenaAllocationSize(sizeof(velocity_t) * (size_t)bodyCount);
+}
+
+/**
+ * @brief Takes an array from the start of a region, keeping the next one aligned
+ *
+ * @param cursor Start of the free part of the region, moved past the array
+ * @param size Bytes of the array
+ * @return The array
+ */
+static void *takeArray(unsigned char **cursor, size_t size)
+{
+	void *array = *cursor;
+
+	*cursor += getMemoryArenaAllocationSize(size);
+
+	return array;
+}
+
+/**
+ * @brief Places the hot body arrays of a precision in a state slot
+ *
+ * @param state The body state to fill in
+ * @param bodyCount Number of bodies
+ * @param slot The slot, with room for getBodyStateSize bytes
+ */
+template <typename position_t, typename velocity_t>
+static void placeBodyState(BodyState<position_t, velocity_t> *state, unsigned int bodyCount, unsigned char *slot)
+{
+	size_t positionSize = sizeof(position_t) * (size_t)bodyCount;
+	size_t velocitySize = sizeof(velocity_t) * (size_t)bodyCount;
+
+	state->positionX = (position_t *)takeArray(&slot, positionSize);
+	state->positionY = (position_t *)takeArray(&slot, positionSize);
+	state->positionZ = (position_t *)takeArray(&slot, positionSize);
+	state->velocityX = (velocity_t *)takeArray(&slot, velocitySize);
+	state->velocityY = (velocity_t *)takeArray(&slot, velocitySize);
+	state->velocityZ = (velocity_t *)takeArray(&slot, velocitySize);
+	state->accelerationX = (velocity_t *)takeArray(&slot, velocitySize);
+	state->accelerationY = (velocity_t *)takeArray(&slot, velocitySize);
+	state->accelerationZ = (velocity_t *)takeArray(&slot, velocitySize);
+}
+
+/**
+ * @brief Zeroes a range of the hot body arrays of a precision
+ *
+ * @param state The body state
+ * @param first Index of the first body
+ * @param last Index past the last body
+ */
+template <typename position_t, typename velocity_t>
+static void clearBodyState(BodyState<position_t, velocity_t> *state, unsigned int first, unsigned int last)
+{
+	size_t positionSize = sizeof(position_t) * (last - first);
+	size_t velocitySize = sizeof(velocity_t) * (last - first);
+
+	memset(state->positionX + first, 0, positionSize);
+	memset(state->positionY + first, 0, positionSize);
+	memset(state->positionZ + first, 0, positionSize);
+	memset(state->velocityX + first, 0, velocitySize);
+	memset(state->velocityY + first, 0, velocitySize);
+	memset(state->velocityZ + first, 0, velocitySize);
+	memset(state->accelerationX + first, 0, velocitySize);
+	memset(state->accelerationY + first, 0, velocitySize);
+	memset(state->accelerationZ + first, 0, velocitySize);
+}
+
+/**
+ * @brief Copies positions and velocities between two precisions
+ *
+ * The destination is written by ranges across the job system, which is also
+ * its first touch (see touchOrbitalBodies).
+ *
+ * @param jobSystem Workers the copy is split across
+ * @param from The source state
+ * @param to The destination state
+ * @param bodyCount Number of bodies
+ */
+template <typename position_t, typename velocity_t, typename toPosition_t, typename toVelocity_t>
+static void copyBodyState(JobSystem *jobSystem, const BodyState<position_t, velocity_t> *from,
+						  BodyState<toPosition_t, toVelocity_t> *to, unsigned int bodyCount)
+{
+	parallelFor(jobSystem, 0, bodyCount, BODIES_PER_JOB, [=](unsigned int begin, unsigned int end)
+				{
+					for (unsigned int i = begin; i < end; i++)
+					{
+						to->positionX[i] = (toPosition_t)from->positionX[i];
+						to->positionY[i] = (toPosition_t)from->positionY[i];
+						to->positionZ[i] = (toPosition_t)from->positionZ[i];
+						to->velocityX[i] = (toVelocity_t)from->velocityX[i];
+						to->velocityY[i] = (toVelocity_t)from->velocityY[i];
+						to->velocityZ[i] = (toVelocity_t)from->velocityZ[i];
+					}
+				});
+}
+
+/**
+ * @brief Allocates the body arrays of a simulation
+ *
+ * @param bodies The body storage to fill in
+ * @param bodyCount Number of bodies
+ * @param precision The precision_type_t of the hot arrays
+ * @return Whether the arena could be mapped
+ */
+static bool allocateOrbitalBodies(OrbitalBodies *bodies, unsigned int bodyCount, int precision)
+{
+	size_t coldSize = 3 * getMemoryArenaAllocationSize(sizeof(float) * (size_t)bodyCount) +
+					  getMemoryArenaAllocationSize(sizeof(Vector3) * (size_t)bodyCount);
+
+	// Room for the widest precision, whichever is used
+	bodies->stateSlotSize = getBodyStateSize<double, double>(bodyCount);
+	bodies->arena = constructMemoryArena(coldSize + 2 * bodies->stateSlotSize);
+
+	if (!bodies->arena)
+		return false;
+
+	bodies->precision = precision;
+	bodies->mass = (float *)allocateFromMemoryArena(bodies->arena, sizeof(float) * (size_t)bodyCount);
+	bodies->initialPosition = (Vector3 *)allocateFromMemoryArena(bodies->arena, sizeof(Vector3) * (size_t)bodyCount);
+	bodies->radius = (float *)allocateFromMemoryArena(bodies->arena, sizeof(float) * (size_t)bodyCount);
+	bodies->color = (Color *)allocateFromMemoryArena(bodies->arena, sizeof(Color) * (size_t)bodyCount);
+	bodies->stateSlots[0] = (unsigned char *)allocateFromMemoryArena(bodies->arena, bodies->stateSlotSize);
+	bodies->stateSlots[1] = (unsigned char *)allocateFromMemoryArena(bodies->arena, bodies->stateSlotSize);
+	bodies->stateSlot = 0;
+
+	switch (precision)
+	{
+	case PRECISION_MIXED:
+		placeBodyState(&bodies->mixedState, bodyCount, bodies->stateSlots[0]);
+		break;
+	case PRECISION_DOUBLE:
+		placeBodyState(&bodies->doubleState, bodyCount, bodies->stateSlots[0]);
+		break;
+	default:
+		placeBodyState(&bodies->floatState, bodyCount, bodies->stateSlots[0]);
+		break;
+	}
+
+	return true;
+}
+
+/**
+ * @brief Writes every body array once, split across the job system as the steps are
+ *
+ * A page is only backed by memory when first written, and on NUMA systems it
+ * goes to the node of the thread that wrote it. Zeroing the arrays by ranges of
+ * bodies from the workers, instead of filling them in from one thread, spreads
+ * the pages across the nodes of the workers that step those bodies.
+ *
+ * @param sim The orbital simulation
+ */
+static void touchOrbitalBodies(OrbitalSim *sim)
+{
+	OrbitalBodies *bodies = &sim->bodiesList;
+
+	parallelFor(sim->jobSystem, 0, sim->bodyCount, BODIES_PER_JOB, [=](unsigned int begin, unsigned int end)
+				{
+					memset(bodies->mass + begin, 0, sizeof(float) * (end - begin));
+					memset(bodies->initialPosition + begin, 0, sizeof(Vector3) * (end - begin));
+					memset(bodies->radius + begin, 0, sizeof(float) * (end - begin));
+					memset(bodies->color + begin, 0, sizeof(Color) * (end - begin));
+
+					switch (bodies->precision)
+					{
+					case PRECISION_MIXED:
+						clearBodyState(&bodies->mixedState, begin, end);
+						break;
+					case PRECISION_DOUBLE:
+						clearBodyState(&bodies->doubleState, begin, end);
+						break;
+					default:
+						clearBodyState(&bodies->floatState, begin, end);
+						break;
+					}
+				});
+}
+
+/**
+ * @brief Releases the body arrays of a simulation
+ * @param bodies The body storage
+ */
+static void freeOrbitalBodies(OrbitalBodies *bodies)
+{
+	destroyMemoryArena(bodies->arena);
+
+	*bodies = OrbitalBodies();
+}
+
+/**
+ * @brief Gathers a body from the simulation arrays
+ *
+ * @param sim The orbital simulation
+ * @param i Index of the body
+ * @return A copy of the body
+ */
+OrbitalBody getOrbitalBody(const OrbitalSim *sim, unsigned int i)
+{
+	OrbitalBody body;
+
+	body.position = getBodyPosition(sim, i);
+	body.initialPosition = getBodyInitialPosition(sim, i);
+	body.velocity = getBodyVelocity(sim, i);
+	body.mass = getBodyMass(sim, i);
+	body.radius = getBodyRadius(sim, i);
+	body.color = getBodyColor(sim, i);
+
+	return body;
+}
+
+/**
+ * @brief Scatters a body into the simulation arrays
+ *
+ * @param sim The orbital simulation
+ * @param i Index of the body
+ * @param body The body to store
+ */
+void setOrbitalBody(OrbitalSim *sim, unsigned int i, const OrbitalBody *body)
+{
+	setBodyPosition(sim, i, body->position);
+	setBodyVelocity(sim, i, body->velocity);
+	sim->bodiesList.mass[i] = body->mass;
+	sim->bodiesList.initialPosition[i] = body->initialPosition;
+	sim->bodiesList.radius[i] = body->radius;
+	sim->bodiesList.color[i] = body->color;
+}
+
+/**
+ * @brief Converts a range of positions to the scalar type of the output
+ */
+template <typename position_t, typename velocity_t, typename output_t>
+static void copyPositions(const BodyState<position_t, velocity_t> *state, unsigned int first, unsigned int last,
+						  output_t *positionX, output_t *positionY, output_t *positionZ)
+{
+	for (unsigned int i = first; i < last; i++)
+	{
+		positionX[i] = (output_t)state->positionX[i];
+		positionY[i] = (output_t)state->positionY[i];
+		positionZ[i] = (output_t)state->positionZ[i];
+	}
+}
+
+/**
+ * @brief Gets the positions of a range of bodies, in any scalar type
+ */
+template <typename output_t>
+static void getPositions(const OrbitalSim *sim, unsigned int first, unsigned int last,
+						 output_t *positionX, output_t *positionY, output_t *positionZ)
+{
+	switch (sim->bodiesList.precision)
+	{
+	case PRECISION_MIXED:
+		copyPositions(&sim->bodiesList.mixedState, first, last, positionX, positionY, positionZ);
+		break;
+	case PRECISION_DOUBLE:
+		copyPositions(&sim->bodiesList.doubleState, first, last, positionX, positionY, positionZ);
+		break;
+	default:
+		copyPositions(&sim->bodiesList.floatState, first, last, positionX, positionY, positionZ);
+		break;
+	}
+}
+
+/**
+ * @brief Gets the positions of a range of bodies in float precision
+ *
+ * @param sim The orbital simulation
+ * @param first Index of the first body
+ * @param last Index past the last body
+ * @param positionX, positionY, positionZ Output arrays, indexed like the bodies
+ */
+void getOrbitalSimPositions(const OrbitalSim *sim, unsigned int first, unsigned int last,
+							float *positionX, float *positionY, float *positionZ)
+{
+	getPositions(sim, first, last, positionX, positionY, positionZ);
+}
+
+/**
+ * @brief Gets the positions of a range of bodies in double precision, as recorded
+ *
+ * @param sim The orbital simulation
+ * @param first Index of the first body
+ * @param last Index past the last body
+ * @param positionX, positionY, positionZ Output arrays, indexed like the bodies
+ */
+void getOrbitalSimPositions(const OrbitalSim *sim, unsigned int first, unsigned int last,
+							double *positionX, double *positionY, double *positionZ)
+{
+	getPositions(sim, first, last, positionX, positionY, positionZ);
+}
+
+/**
+ * @brief Allocates an orbital simulation without placing any body
+ *
+ * Every body array is zeroed, to be filled in by the caller, as
+ * constructOrbitalSim, scenarios and checkpoints do.
+ *
+ * @param timeStep The time step
+ * @param starSystemCount Number of bodies of the star system, stored first
+ * @param bodyCount Number of bodies, the star system included
+ * @param precision The precision_type_t to run with
+ * @return The orbital simulation, or NULL if it could not be allocated or the
+ *         star system is empty, too large or does not fit in bodyCount
  */
-OrbitalSim *constructOrbitalSim(float timeStep)
+OrbitalSim *allocateOrbitalSim(double timeStep, unsigned int starSystemCount, unsigned int bodyCount, int precision)
 {
+	if (!starSystemCount || starSystemCount > STAR_SYSTEM_MAX_BODYNUM || bodyCount < starSystemCount)
+		return NULL;
+
 	OrbitalSim *simulation = new OrbitalSim();
 
 	if (simulation)
 	{
 		simulation->timeStep = timeStep;
 		simulation->totalTime = 0;
-		simulation->bodyCount = SOLARSYSTEM_BODYNUM + ASTEROIDS_BODYNUM;
-		simulation->bodiesList = new OrbitalBody[simulation->bodyCount];
+		simulation->bodyCount = bodyCount;
+		simulation->starSystemCount = starSystemCount;
+		simulation->jobSystem = getJobSystem();
+		simulation->openingAngle = BARNES_HUT_DEFAULT_THETA;
+		simulation->barnesHutTree = constructBarnesHutTree();
+		simulation->integrator = INTEGRATOR_EULER;
+		simulation->accelerationsType = LOGIC_STANDBY;
+		simulation->chunkLevel = NULL;
+		simulation->blockStep = 0;
+		simulation->blockSimType = LOGIC_STANDBY;
+		simulation->diagnosticsInterval = 0;
+		simulation->diagnosticsCountdown = 0;
+		simulation->diagnostics = {};
+		simulation->diagnosticsReference = {};
 
-		if (simulation->bodiesList)
+		if (allocateOrbitalBodies(&simulation->bodiesList, bodyCount, precision))
 		{
-			for (int i = 0; i < SOLARSYSTEM_BODYNUM; i++)
-			{
-				simulation->bodiesList[i].position = solarSystem[i].position;
-				simulation->bodiesList[i].initialPosition = solarSystem[i].position;
-				simulation->bodiesList[i].velocity = solarSystem[i].velocity;
-				simulation->bodiesList[i].mass = solarSystem[i].mass;
-				simulation->bodiesList[i].radius = solarSystem[i].radius;
-				simulation->bodiesList[i].color = solarSystem[i].color;
-			}
+			simulation->chunkLevel = new unsigned char[getOrbitalSimChunkCount(simulation)];
 
-			for (int i = SOLARSYSTEM_BODYNUM; i < SOLARSYSTEM_BODYNUM + ASTEROIDS_BODYNUM; i++)
-			{
-				configureAsteroid(&simulation->bodiesList[i], simulation->bodiesList[0].mass);
-			}
+			touchOrbitalBodies(simulation);
 
 			return simulation;
 		}
+
+		freeOrbitalBodies(&simulation->bodiesList);
+		destroyBarnesHutTree(simulation->barnesHutTree);
+		delete simulation;
 	}
 
 	return NULL;
 }
 
+/**
+ * @brief Gets the bodies of a built-in star system
+ *
+ * @param starSystem The star_system_type_t
+ * @param bodies Filled in with the bodies, room for STAR_SYSTEM_MAX_BODYNUM
+ * @return Number of bodies, 0 for an unknown star system
+ */
+unsigned int getStarSystem(int starSystem, OrbitalBody *bodies)
+{
+	const EphemeridesBody *ephemerides;
+	unsigned int bodyCount;
+
+	switch (starSystem)
+	{
+	case STAR_SYSTEM_SOLAR:
+		ephemerides = solarSystem;
+		bodyCount = SOLARSYSTEM_BODYNUM;
+		break;
+	case STAR_SYSTEM_ALPHA_CENTAURI:
+		ephemerides = alphaCentauriSystem;
+		bodyCount = ALPHACENTAURISYSTEM_BODYNUM;
+		break;
+	default:
+		return 0;
+	}
+
+	for (unsigned int i = 0; i < bodyCount; i++)
+	{
+		bodies[i].position = ephemerides[i].position;
+		bodies[i].initialPosition = ephemerides[i].position;
+		bodies[i].velocity = ephemerides[i].velocity;
+		bodies[i].mass = ephemerides[i].mass;
+		bodies[i].radius = ephemerides[i].radius;
+		bodies[i].color = ephemerides[i].color;
+	}
+
+	return bodyCount;
+}
+
+/**
+ * @brief Constructs an orbital simulation
+ *
+ * @param timeStep The time step
+ * @param asteroidCount Number of asteroids added to the star system
+ * @param seed Seed of the asteroids: the same seed gives the same simulation
+ * @return The orbital simulation
+ */
+OrbitalSim *constructOrbitalSim(double timeStep, unsigned int asteroidCount, unsigned int seed)
+{
+	OrbitalBody starSystem[STAR_SYSTEM_MAX_BODYNUM];
+	unsigned int starSystemCount = getStarSystem(STAR_SYSTEM_SOLAR, starSystem);
+	OrbitalSim *simulation = allocateOrbitalSim(timeStep, starSystemCount, starSystemCount + asteroidCount, PRECISION_FLOAT);
+
+	if (simulation)
+	{
+		for (unsigned int i = 0; i < starSystemCount; i++)
+			setOrbitalBody(simulation, i, &starSystem[i]);
+
+		configureAsteroids(simulation, starSystemCount, asteroidCount, simulation->bodiesList.mass[0], seed);
+	}
+
+	return simulation;
+}
+
 /**
  * @brief Destroys an orbital simulation
  * @param sim Pointer to OrbitalSim simulation
  */
 void destroyOrbitalSim(OrbitalSim *sim)
 {
-	delete[] sim->bodiesList;
+	freeOrbitalBodies(&sim->bodiesList);
+	destroyBarnesHutTree(sim->barnesHutTree);
+	delete[] sim->chunkLevel;
 	//   delete sim->asteroidClusters;
 	delete sim;
 }
 
+/**
+ * @brief Moves the body state of a simulation into another precision
+ *
+ * The new state goes into the free slot of the arena, and the memory of the
+ * old one is given back to the system.
+ *
+ * @param sim The orbital simulation
+ * @param to The (unplaced) state of the new precision
+ */
+template <typename position_t, typename velocity_t>
+static void convertBodyState(OrbitalSim *sim, BodyState<position_t, velocity_t> *to)
+{
+	OrbitalBodies *bodies = &sim->bodiesList;
+	int slot = 1 - bodies->stateSlot;
+
+	placeBodyState(to, sim->bodyCount, bodies->stateSlots[slot]);
+
+	switch (bodies->precision)
+	{
+	case PRECISION_MIXED:
+		copyBodyState(sim->jobSystem, &bodies->mixedState, to, sim->bodyCount);
+		bodies->mixedState = MixedBodyState();
+		break;
+	case PRECISION_DOUBLE:
+		copyBodyState(sim->jobSystem, &bodies->doubleState, to, sim->bodyCount);
+		bodies->doubleState = DoubleBodyState();
+		break;
+	default:
+		copyBodyState(sim->jobSystem, &bodies->floatState, to, sim->bodyCount);
+		bodies->floatState = FloatBodyState();
+		break;
+	}
+
+	discardMemoryArenaRange(bodies->arena, bodies->stateSlots[bodies->stateSlot], bodies->stateSlotSize);
+	bodies->stateSlot = slot;
+
+	sim->accelerationsType = LOGIC_STANDBY;
+}
+
+/**
+ * @brief Changes the scalar types the simulation runs with
+ *
+ * @param sim The orbital simulation
+ * @param precision The precision_type_t
+ * @return Whether the simulation now runs with that precision
+ */
+bool setOrbitalSimPrecision(OrbitalSim *sim, int precision)
+{
+	if (precision == sim->bodiesList.precision)
+		return true;
+
+	switch (precision)
+	{
+	case PRECISION_MIXED:
+		convertBodyState(sim, &sim->bodiesList.mixedState);
+		break;
+	case PRECISION_DOUBLE:
+		convertBodyState(sim, &sim->bodiesList.doubleState);
+		break;
+	case PRECISION_FLOAT:
+		convertBodyState(sim, &sim->bodiesList.floatState);
+		break;
+	default:
+		return false;
+	}
+
+	sim->bodiesList.precision = precision;
+
+	return true;
+}
+
+/**
+ * @brief Stores the conserved quantities of a step and their drift since the reference
+ *
+ * @param sim The orbital simulation
+ * @param sums The quantities summed over every body
+ */
+static void updateDiagnostics(OrbitalSim *sim, const ConservationSums *sums)
+{
+	OrbitalDiagnostics *diagnostics = &sim->diagnostics;
+	OrbitalDiagnostics *reference = &sim->diagnosticsReference;
+
+	diagnostics->valid = true;
+	diagnostics->kineticEnergy = sums->kineticEnergy;
+	diagnostics->potentialEnergy = sums->potentialEnergy;
+	diagnostics->energy = sums->kineticEnergy + sums->potentialEnergy;
+	diagnostics->momentumX = sums->momentumX;
+	diagnostics->momentumY = sums->momentumY;
+	diagnostics->momentumZ = sums->momentumZ;
+	diagnostics->angularMomentumX = sums->angularMomentumX;
+	diagnostics->angularMomentumY = sums->angularMomentumY;
+	diagnostics->angularMomentumZ = sums->angularMomentumZ;
+	diagnostics->momentumScale = sqrt(2 * sums->mass * sums->kineticEnergy);
+
+	if (!reference->valid)
+		*reference = *diagnostics;
+
+	double angularMomentum0 = sqrt(reference->angularMomentumX * reference->angularMomentumX +
+								   reference->angularMomentumY * reference->angularMomentumY +
+								   reference->angularMomentumZ * reference->angularMomentumZ);
+
+	diagnostics->energyDrift = (reference->energy != 0)
+								   ? (diagnostics->energy - reference->energy) / fabs(reference->energy)
+								   : 0;
+	diagnostics->momentumDrift = (reference->momentumScale != 0)
+									 ? NORM(diagnostics->momentumX - reference->momentumX,
+											diagnostics->momentumY - reference->momentumY,
+											diagnostics->momentumZ - reference->momentumZ) /
+										   reference->momentumScale
+									 : 0;
+	diagnostics->angularMomentumDrift = (angularMomentum0 != 0)
+											? NORM(diagnostics->angularMomentumX - reference->angularMomentumX,
+												   diagnostics->angularMomentumY - reference->angularMomentumY,
+												   diagnostics->angularMomentumZ - reference->angularMomentumZ) /
+												  angularMomentum0
+											: 0;
+}
+
+/**
+ * @brief Runs the stages of an integrator step with the scalar types of a precision
+ *
+ * @param sim The orbital simulation
+ * @param state Body state of the current precision
+ * @param simType The force model
+ * @param stages The integrator stages
+ * @param stageCount Number of stages
+ */
+template <typename position_t, typename velocity_t>
+static void runStages(OrbitalSim *sim, BodyState<position_t, velocity_t> *state, int simType,
+					  const IntegratorStage *stages, int stageCount)
+{
+	// Blocks restart when the force model changes (only at the end of the longest
+	// block, see updateOrbitalSim); step levels are only picked when every level
+	// is synchronized
+	if (simType != sim->blockSimType)
+	{
+		sim->blockStep = 0;
+		sim->blockSimType = simType;
+
+		// Another force model conserves another energy
+		sim->diagnostics.valid = false;
+		sim->diagnosticsReference.valid = false;
+	}
+
+	if (simType == GRAVITATIONAL_SIMULATION && sim->blockStep == 0)
+	{
+		updateStepLevels(sim, state);
+		openAsteroidBlocks(sim, state);
+	}
+
+	// Measured while the last stage runs, when positions and velocities are at the end
+	// of the step. Asteroids on longer blocks are owed part of their kicks until the
+	// end of the longest block, so a measurement that is due waits for it
+	bool measured = false;
+	ConservationSums sums = {};
+
+	if (sim->diagnosticsInterval)
+	{
+		bool synchronized = (sim->blockStep + 1 == 1 << (BLOCK_LEVEL_COUNT - 1));
+
+		measured = (sim->diagnosticsCountdown == 0) && (simType == GRAVITATIONAL_SIMULATION) && synchronized;
+
+		if (measured)
+			sim->diagnosticsCountdown = sim->diagnosticsInterval - 1;
+		else if (sim->diagnosticsCountdown)
+			sim->diagnosticsCountdown--;
+	}
+
+	for (int i = 0; i < stageCount; i++)
+	{
+		// Rounded to float only in the float and mixed instances
+		velocity_t drift = (velocity_t)(stages[i].drift * sim->timeStep);
+		velocity_t kick = (velocity_t)(stages[i].kick * sim->timeStep);
+
+		switch (simType)
+		{
+		case GRAVITATIONAL_SIMULATION:
+			updateUsingGravity(sim, state, drift, kick, i == stageCount - 1, (measured && i == stageCount - 1) ? &sums : NULL);
+			break;
+		case DIRECT_GRAVITY_SIMULATION:
+		case BARNES_HUT_SIMULATION:
+			updateUsingAccelerations(sim, state, simType, drift, kick);
+			break;
+		default:
+			updateUsingSprings(sim, state, drift, kick);
+			break;
+		}
+	}
+
+	if (measured)
+		updateDiagnostics(sim, &sums);
+}
+
 /**
  * @brief Simulates a timestep
  * @param sim The orbital simulation
  */
 void updateOrbitalSim(OrbitalSim *sim, int simType)
 {
-	if (simType == GRAVITATIONAL_SIMULATION)
+	const IntegratorStage *stages;
+	int stageCount;
+
+	switch (sim->integrator)
 	{
-		updateUsingGravity(sim);
+	case INTEGRATOR_LEAPFROG:
+		stages = leapfrogStages;
+		stageCount = sizeof(leapfrogStages) / sizeof(IntegratorStage);
+		break;
+	case INTEGRATOR_YOSHIDA4:
+		stages = yoshidaStages;
+		stageCount = sizeof(yoshidaStages) / sizeof(IntegratorStage);
+		break;
+	case INTEGRATOR_FOREST_RUTH:
+		stages = forestRuthStages;
+		stageCount = sizeof(forestRuthStages) / sizeof(IntegratorStage);
+		break;
+	default:
+		stages = eulerStages;
+		stageCount = sizeof(eulerStages) / sizeof(IntegratorStage);
+		break;
 	}
-	else
+
+	// Asteroids on longer blocks only have their velocities in step with their
+	// positions at the end of the longest block, so the gravity mode runs on until then
+	if (sim->blockSimType == GRAVITATIONAL_SIMULATION && sim->blockStep != 0)
+		simType = GRAVITATIONAL_SIMULATION;
+
+	switch (sim->bodiesList.precision)
 	{
-		updateUsingSprings(sim);
+	case PRECISION_MIXED:
+		runStages(sim, &sim->bodiesList.mixedState, simType, stages, stageCount);
+		break;
+	case PRECISION_DOUBLE:
+		runStages(sim, &sim->bodiesList.doubleState, simType, stages, stageCount);
+		break;
+	default:
+		runStages(sim, &sim->bodiesList.floatState, simType, stages, stageCount);
+		break;
 	}
+
+	sim->totalTime += sim->timeStep;
+	sim->blockStep = (sim->blockStep + 1) % (1 << (BLOCK_LEVEL_COUNT - 1));
+}
+
+/**
+ * @brief Turns the conservation diagnostics on or off
+ *
+ * Measured gravity mode steps also sum the energy, linear momentum and angular
+ * momentum of the bodies. They skip the SIMD kernels, so measuring only some
+ * steps keeps the cost low. Only steps that end the longest asteroid block are
+ * measured, when every velocity is in step with its position. Turning the
+ * diagnostics on takes a new reference on the next step measured.
+ *
+ * @param sim The orbital simulation
+ * @param interval Steps between measurements, rounded up to the end of a longest
+ *                 block (every 16 steps); 0 to turn them off
+ */
+void setOrbitalSimDiagnostics(OrbitalSim *sim, unsigned int interval)
+{
+	if (interval && !sim->diagnosticsInterval)
+		sim->diagnosticsReference.valid = false;
+
+	if (!interval)
+		sim->diagnostics.valid = false;
+
+	sim->diagnosticsInterval = interval;
+	sim->diagnosticsCountdown = 0;
+}
+
+/**
+ * @brief Gets the conservation diagnostics of the last step measured
+ * @param sim The orbital simulation
+ * @return The diagnostics; not valid until a step of the current force model is measured
+ */
+OrbitalDiagnostics getOrbitalSimDiagnostics(const OrbitalSim *sim)
+{
+	return sim->diagnostics;
+}
+
+/**
+ * @brief Gives the opening half kick of their block to the asteroid chunks on longer blocks
+ *
+ * Run when every level is synchronized, once the levels of the new blocks are
+ * picked, with the accelerations at the start of the blocks.
+ *
+ * @param sim The orbital simulation
+ * @param state Body state of the current precision
+ */
+template <typename position_t, typename velocity_t>
+static void openAsteroidBlocks(OrbitalSim *sim, BodyState<position_t, velocity_t> *state)
+{
+	const int j = getCentralBody(sim);
+	const position_t centerX = state->positionX[j];
+	const position_t centerY = state->positionY[j];
+	const position_t centerZ = state->positionZ[j];
+	const velocity_t centerGM = (velocity_t)(-GRAVITATIONAL_CONSTANT * sim->bodiesList.mass[j]);
+	const double timeStep = sim->timeStep;
+
+	parallelFor(sim->jobSystem, 0, getOrbitalSimChunkCount(sim), BODIES_PER_JOB / BLOCK_CHUNK_SIZE,
+				[=](unsigned int begin, unsigned int end)
+				{
+					for (unsigned int chunk = begin; chunk < end; chunk++)
+					{
+						unsigned int first = sim->starSystemCount + chunk * BLOCK_CHUNK_SIZE;
+						unsigned int count = std::min(sim->bodyCount - first, (unsigned int)BLOCK_CHUNK_SIZE);
+						unsigned int blockLength = 1 << sim->chunkLevel[chunk];
+
+						if (blockLength > 1)
+						{
+							updateCentralGravity(state->positionX + first, state->positionY + first, state->positionZ + first,
+												 state->velocityX + first, state->velocityY + first, state->velocityZ + first,
+												 count,
+												 centerX, centerY, centerZ,
+												 centerGM, 0, (velocity_t)(timeStep * blockLength / 2));
+						}
+					}
+				});
 }
 
 /**
  * @brief Updates interactions between present bodies using Gravitational forces
  * @param sim The orbital simulation
+ * @param state Body state of the current precision
+ * @param drift Drift time
+ * @param kick Kick time
+ * @param lastStage Whether the stage ends the step
+ * @param sums Where to add the conserved quantities after the stage, or NULL
  */
-static void updateUsingGravity(OrbitalSim *sim)
+template <typename position_t, typename velocity_t>
+static void updateUsingGravity(OrbitalSim *sim, BodyState<position_t, velocity_t> *state, velocity_t drift, velocity_t kick,
+							   bool lastStage, ConservationSums *sums)
 {
-	Vector3 gravAcc;
-	Vector3 acceleration;
-	float norm;
-	float biggestMass = 0;
-	int indexOfMostMassiveBody;
+	position_t *posX = state->positionX;
+	position_t *posY = state->positionY;
+	position_t *posZ = state->positionZ;
+	velocity_t *velX = state->velocityX;
+	velocity_t *velY = state->velocityY;
+	velocity_t *velZ = state->velocityZ;
+	const float *mass = sim->bodiesList.mass;
 
-	sim->totalTime += sim->timeStep;
+	velocity_t norm;
 
-	for (int i = 0; i < sim->bodyCount; i++)
+	sim->accelerationsType = LOGIC_STANDBY;
+
+	unsigned int starSystemCount = sim->starSystemCount;
+
+	// Planets and sun: attraction between themselves only
+	for (unsigned int i = 0; i < starSystemCount; i++)
 	{
-		acceleration = {0, 0, 0};
-		sim->bodiesList[i].position += sim->bodiesList[i].velocity * sim->timeStep;
+		posX[i] += velX[i] * drift;
+		posY[i] += velY[i] * drift;
+		posZ[i] += velZ[i] * drift;
+	}
 
-		if (i < SOLARSYSTEM_BODYNUM)
+	velocity_t accX[STAR_SYSTEM_MAX_BODYNUM] = {0};
+	velocity_t accY[STAR_SYSTEM_MAX_BODYNUM] = {0};
+	velocity_t accZ[STAR_SYSTEM_MAX_BODYNUM] = {0};
+
+	for (unsigned int i = 0; i < starSystemCount; i++)
+	{
+		for (unsigned int j = 0; j < starSystemCount; j++)
 		{
-			if (sim->bodiesList[i].mass > biggestMass)
+			if (i != j)
 			{
-				biggestMass = sim->bodiesList[i].mass;
-				indexOfMostMassiveBody = i;
-			}
+				velocity_t dx = (velocity_t)(posX[i] - posX[j]);
+				velocity_t dy = (velocity_t)(posY[i] - posY[j]);
+				velocity_t dz = (velocity_t)(posZ[i] - posZ[j]);
 
-			for (int j = 0; j < SOLARSYSTEM_BODYNUM; j++)
-			{
-				if (i != j)
+				norm = NORM(dx, dy, dz);
+
+				if (norm != 0)
 				{
-					norm = NORM(sim->bodiesList[i].position.x - sim->bodiesList[j].position.x, sim->bodiesList[i].position.y - sim->bodiesList[j].position.y, sim->bodiesList[i].position.z - sim->bodiesList[j].position.z);
+					velocity_t factor = (velocity_t)(-GRAVITATIONAL_CONSTANT * mass[j]) / (norm * norm * norm);
 
-					if (norm != 0)
-					{
-						gravAcc = ((sim->bodiesList[i].position - sim->bodiesList[j].position) * (-GRAVITATIONAL_CONSTANT * sim->bodiesList[j].mass)) / (norm * norm * norm);
-						acceleration += gravAcc;
-					}
+					accX[i] += dx * factor;
+					accY[i] += dy * factor;
+					accZ[i] += dz * factor;
+
+					// Every pair is visited twice
+					if (sums)
+						sums->potentialEnergy -= 0.5 * GRAVITATIONAL_CONSTANT * mass[i] * mass[j] / norm;
 				}
 			}
 		}
-		else
-		{
-			int j = indexOfMostMassiveBody;
+	}
 
-			norm = NORM(sim->bodiesList[i].position.x - sim->bodiesList[j].position.x, sim->bodiesList[i].position.y - sim->bodiesList[j].position.y, sim->bodiesList[i].position.z - sim->bodiesList[j].position.z);
+	for (unsigned int i = 0; i < starSystemCount; i++)
+	{
+		velX[i] += accX[i] * kick;
+		velY[i] += accY[i] * kick;
+		velZ[i] += accZ[i] * kick;
 
-			if (norm != 0)
-			{
-				gravAcc = ((sim->bodiesList[i].position - sim->bodiesList[j].position) * (-GRAVITATIONAL_CONSTANT * sim->bodiesList[j].mass)) / (norm * norm * norm);
-				acceleration += gravAcc;
-			}
+		if (sums)
+		{
+			double m = mass[i];
+			double vx = velX[i], vy = velY[i], vz = velZ[i];
+			double x = posX[i], y = posY[i], z = posZ[i];
+
+			sums->mass += m;
+			sums->kineticEnergy += 0.5 * m * (vx * vx + vy * vy + vz * vz);
+			sums->momentumX += m * vx;
+			sums->momentumY += m * vy;
+			sums->momentumZ += m * vz;
+			sums->angularMomentumX += m * (y * vz - z * vy);
+			sums->angularMomentumY += m * (z * vx - x * vz);
+			sums->angularMomentumZ += m * (x * vy - y * vx);
 		}
+	}
+
+	// Asteroids: attraction to the most massive body only, several bodies at a time.
+	// Chunks stepping every timestep run the stages of the integrator, as the star
+	// system. Longer blocks are a kick-drift-kick leapfrog of the whole block:
+	// half a kick at its start (openAsteroidBlocks), a drift of a timestep at the
+	// end of each step and half a kick at its end. Inside the longest block levels
+	// do not change, so the closing and opening kicks of two blocks add up to one
+	const int j = getCentralBody(sim);
+	const position_t centerX = posX[j];
+	const position_t centerY = posY[j];
+	const position_t centerZ = posZ[j];
+	const velocity_t centerGM = (velocity_t)(-GRAVITATIONAL_CONSTANT * mass[j]);
+	const double timeStep = sim->timeStep;
+	const unsigned int blockStep = sim->blockStep + 1;
+	const bool synchronized = (blockStep == 1 << (BLOCK_LEVEL_COUNT - 1));
+
+	// Measured per chunk and added up in chunk order, so the sums do not depend on the threads
+	std::vector<ConservationSums> chunkSums(sums ? getOrbitalSimChunkCount(sim) : 0, ConservationSums());
+	ConservationSums *chunkSum = sums ? chunkSums.data() : NULL;
+
+	parallelFor(sim->jobSystem, 0, getOrbitalSimChunkCount(sim), BODIES_PER_JOB / BLOCK_CHUNK_SIZE,
+				[=](unsigned int begin, unsigned int end)
+				{
+					for (unsigned int chunk = begin; chunk < end; chunk++)
+					{
+						unsigned int first = sim->starSystemCount + chunk * BLOCK_CHUNK_SIZE;
+						unsigned int count = std::min(sim->bodyCount - first, (unsigned int)BLOCK_CHUNK_SIZE);
+						unsigned int blockLength = 1 << sim->chunkLevel[chunk];
+						velocity_t chunkDrift = drift;
+						velocity_t chunkKick = kick;
 
-		sim->bodiesList[i].velocity += acceleration * sim->timeStep;
+						if (blockLength > 1)
+						{
+							if (!lastStage)
+								continue;
+
+							chunkDrift = (velocity_t)timeStep;
+
+							if (blockStep % blockLength != 0)
+								chunkKick = 0;
+							else
+								chunkKick = (velocity_t)(synchronized ? timeStep * blockLength / 2 : timeStep * blockLength);
+						}
+
+						if (chunkSum)
+						{
+							updateCentralGravityWithSums(posX + first, posY + first, posZ + first,
+														 velX + first, velY + first, velZ + first,
+														 mass + first, count,
+														 centerX, centerY, centerZ,
+														 centerGM, chunkDrift, chunkKick,
+														 &chunkSum[chunk]);
+						}
+						else if (chunkKick != 0 || blockLength == 1)
+						{
+							updateCentralGravity(posX + first, posY + first, posZ + first,
+												 velX + first, velY + first, velZ + first,
+												 count,
+												 centerX, centerY, centerZ,
+												 centerGM, chunkDrift, chunkKick);
+						}
+						else
+						{
+							driftPositions(posX + first, posY + first, posZ + first,
+										   velX + first, velY + first, velZ + first,
+										   count, chunkDrift);
+						}
+					}
+				});
+
+	for (size_t chunk = 0; chunk < chunkSums.size(); chunk++)
+	{
+		sums->mass += chunkSums[chunk].mass;
+		sums->kineticEnergy += chunkSums[chunk].kineticEnergy;
+		sums->potentialEnergy += chunkSums[chunk].potentialEnergy;
+		sums->momentumX += chunkSums[chunk].momentumX;
+		sums->momentumY += chunkSums[chunk].momentumY;
+		sums->momentumZ += chunkSums[chunk].momentumZ;
+		sums->angularMomentumX += chunkSums[chunk].angularMomentumX;
+		sums->angularMomentumY += chunkSums[chunk].angularMomentumY;
+		sums->angularMomentumZ += chunkSums[chunk].angularMomentumZ;
 	}
 }
 
 /**
  * @brief Updates interactions between present bodies using a mass-spring physical model
  * @param sim The orbital simulation
+ * @param state Body state of the current precision
+ * @param drift Drift time
+ * @param kick Kick time
  */
-static void updateUsingSprings(OrbitalSim *sim)
+template <typename position_t, typename velocity_t>
+static void updateUsingSprings(OrbitalSim *sim, BodyState<position_t, velocity_t> *state, velocity_t drift, velocity_t kick)
 {
-	Vector3 gravAcc;
-	float acceleration;
-	float norm;
-	int j;
+	// The anchor is never accelerated, so its position after the drift is known upfront
+	const position_t anchorX = state->positionX[0] + state->velocityX[0] * drift;
+	const position_t anchorY = state->positionY[0] + state->velocityY[0] * drift;
+	const position_t anchorZ = state->positionZ[0] + state->velocityZ[0] * drift;
 
-	sim->totalTime += sim->timeStep;
+	sim->accelerationsType = LOGIC_STANDBY;
 
-	for (int i = 0; i < sim->bodyCount; i++)
-	{
-		j = 0;
-		acceleration = 0;
-		Vector3 dist = sim->bodiesList[i].position - sim->bodiesList[j].position;
-		Vector3 distRelative = sim->bodiesList[i].initialPosition - sim->bodiesList[j].position;
+	// Every body only depends on itself and the anchor, so each one can be
+	// updated on its own and ranges can go to different workers
+	parallelFor(sim->jobSystem, 0, sim->bodyCount, BODIES_PER_JOB,
+				[=](unsigned int begin, unsigned int end)
+				{
+					for (unsigned int i = begin; i < end; i++)
+					{
+						state->positionX[i] += state->velocityX[i] * drift;
+						state->positionY[i] += state->velocityY[i] * drift;
+						state->positionZ[i] += state->velocityZ[i] * drift;
 
-		Vector3 versor = dist / NORM(dist.x, dist.y, dist.z);
-		double distMag = sqrt(dist.x * dist.x + dist.y * dist.y + dist.z * dist.z);
+						velocity_t distX = (velocity_t)(state->positionX[i] - anchorX);
+						velocity_t distY = (velocity_t)(state->positionY[i] - anchorY);
+						velocity_t distZ = (velocity_t)(state->positionZ[i] - anchorZ);
 
-		if (distMag == 0)
-			continue;
+						Vector3 initialPosition = getBodyInitialPosition(sim, i);
+						velocity_t relativeX = (velocity_t)(initialPosition.x - anchorX);
+						velocity_t relativeY = (velocity_t)(initialPosition.y - anchorY);
+						velocity_t relativeZ = (velocity_t)(initialPosition.z - anchorZ);
 
-		int j = 0;
+						double distMag = NORM(distX, distY, distZ);
 
-		if (i < SOLARSYSTEM_BODYNUM)
+						if (distMag != 0)
+						{
+							velocity_t acceleration;
+
+							if (i < sim->starSystemCount)
+							{
+								acceleration = -((distMag - NORM(relativeX, relativeY, relativeZ)) * ELASTIC_CONSTANT_PLANETS) / sim->bodiesList.mass[i];
+							}
+							else
+							{
+								acceleration = -((distMag - NORM(relativeX, relativeY, relativeZ)) * ELASTIC_CONSTANT_ASTEROIDS) / sim->bodiesList.mass[i];
+							}
+
+							state->velocityX[i] += (velocity_t)(distX / distMag) * acceleration * kick;
+							state->velocityY[i] += (velocity_t)(distY / distMag) * acceleration * kick;
+							state->velocityZ[i] += (velocity_t)(distZ / distMag) * acceleration * kick;
+						}
+					}
+				});
+}
+
+/**
+ * @brief Moves every body with its current velocity
+ * @param sim The orbital simulation
+ * @param state Body state of the current precision
+ * @param drift Drift time
+ */
+template <typename position_t, typename velocity_t>
+static void driftBodies(OrbitalSim *sim, BodyState<position_t, velocity_t> *state, velocity_t drift)
+{
+	parallelFor(sim->jobSystem, 0, sim->bodyCount, BODIES_PER_JOB,
+				[=](unsigned int begin, unsigned int end)
+				{
+					for (unsigned int i = begin; i < end; i++)
+					{
+						state->positionX[i] += state->velocityX[i] * drift;
+						state->positionY[i] += state->velocityY[i] * drift;
+						state->positionZ[i] += state->velocityZ[i] * drift;
+					}
+				});
+}
+
+/**
+ * @brief Accelerates every body with the accelerations left in the scratch arrays
+ * @param sim The orbital simulation
+ * @param state Body state of the current precision
+ * @param kick Kick time
+ */
+template <typename position_t, typename velocity_t>
+static void kickBodies(OrbitalSim *sim, BodyState<position_t, velocity_t> *state, velocity_t kick)
+{
+	parallelFor(sim->jobSystem, 0, sim->bodyCount, BODIES_PER_JOB,
+				[=](unsigned int begin, unsigned int end)
+				{
+					for (unsigned int i = begin; i < end; i++)
+					{
+						state->velocityX[i] += state->accelerationX[i] * kick;
+						state->velocityY[i] += state->accelerationY[i] * kick;
+						state->velocityZ[i] += state->accelerationZ[i] * kick;
+					}
+				});
+}
+
+/**
+ * @brief Updates interactions between all present bodies using Gravitational forces,
+ *        either exact or with far away groups of bodies approximated by their center of mass
+ * @param sim The orbital simulation
+ * @param state Body state of the current precision
+ * @param simType DIRECT_GRAVITY_SIMULATION or BARNES_HUT_SIMULATION
+ * @param drift Drift time
+ * @param kick Kick time
+ */
+template <typename position_t, typename velocity_t>
+static void updateUsingAccelerations(OrbitalSim *sim, BodyState<position_t, velocity_t> *state, int simType, velocity_t drift, velocity_t kick)
+{
+	if (drift != 0)
+	{
+		driftBodies(sim, state, drift);
+		sim->accelerationsType = LOGIC_STANDBY;
+	}
+
+	if (kick == 0)
+		return;
+
+	// Accelerations are still valid when the previous stage ended at these same positions
+	if (sim->accelerationsType != simType)
+	{
+		if (simType == BARNES_HUT_SIMULATION)
 		{
-			acceleration = -((NORM(dist.x, dist.y, dist.z) - NORM(distRelative.x, distRelative.y, distRelative.z)) * ELASTIC_CONSTANT_PLANETS) / sim->bodiesList[i].mass;
+			computeBarnesHutAccelerations(sim->barnesHutTree, sim->jobSystem,
+										  state->positionX, state->positionY, state->positionZ, sim->bodiesList.mass,
+										  sim->bodyCount, sim->openingAngle,
+										  state->accelerationX, state->accelerationY, state->accelerationZ);
 		}
 		else
 		{
-			acceleration = -((NORM(dist.x, dist.y, dist.z) - NORM(distRelative.x, distRelative.y, distRelative.z)) * ELASTIC_CONSTANT_ASTEROIDS) / sim->bodiesList[i].mass;
+			computeDirectAccelerations(sim->jobSystem,
+									   state->positionX, state->positionY, state->positionZ, sim->bodiesList.mass,
+									   sim->bodyCount,
+									   state->accelerationX, state->accelerationY, state->accelerationZ);
 		}
 
-		sim->bodiesList[i].velocity += versor * acceleration * sim->timeStep;
+		sim->accelerationsType = simType;
 	}
 
-	for (int i = 0; i < sim->bodyCount; i++)
-	{
-		sim->bodiesList[i].position += sim->bodiesList[i].velocity * sim->timeStep;
-	}
+	kickBodies(sim, state, kick);
 }
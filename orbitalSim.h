@@ -9,11 +9,23 @@
 #define ORBITALSIM_H
 
 #include "raylib.h"
+#include "barnesHut.h"
+#include "configuration.h"
+#include "jobSystem.h"
+#include "memoryArena.h"
 #include "raymath.h"
+#include <cstdint>
 #include <vector>
 
+#define ASTEROIDS_BODYNUM 3000 // Asteroids of the interactive simulation
+#define STAR_SYSTEM_MAX_BODYNUM 32 // Bodies that attract each other, ahead of the asteroids
+#define BLOCK_LEVEL_COUNT 5 // Asteroid step levels: every 1, 2, 4, 8 or 16 steps
+
 /**
  * @brief Orbital body definition
+ *
+ * Used to build or inspect a single body. The simulation itself stores
+ * bodies as a structure of arrays (see OrbitalBodies).
  */
 struct OrbitalBody
 {
@@ -25,21 +37,269 @@ struct OrbitalBody
 	Color color;
 };
 
+/**
+ * @brief Hot body data, read and written on every simulation step
+ *
+ * The simulation core is templated on these scalar types, so one build runs
+ * any precision_type_t.
+ */
+template <typename position_t, typename velocity_t>
+struct BodyState
+{
+	position_t *positionX;
+	position_t *positionY;
+	position_t *positionZ;
+	velocity_t *velocityX;
+	velocity_t *velocityY;
+	velocity_t *velocityZ;
+
+	// Scratch space for force models that compute accelerations in a separate pass
+	velocity_t *accelerationX;
+	velocity_t *accelerationY;
+	velocity_t *accelerationZ;
+};
+
+typedef BodyState<float, float> FloatBodyState;
+typedef BodyState<double, float> MixedBodyState;
+typedef BodyState<double, double> DoubleBodyState;
+
+/**
+ * @brief Orbital bodies storage, laid out as a structure of arrays
+ *
+ * Every array comes from one arena and starts on a MEMORY_ARENA_ALIGNMENT
+ * boundary. The arena holds two slots for hot arrays, each with room for the
+ * widest precision: the current state lives in one, and changing precision
+ * fills the other. Only pages written are backed by memory.
+ */
+struct OrbitalBodies
+{
+	MemoryArena *arena;
+	unsigned char *stateSlots[2];
+	size_t stateSlotSize;
+	int stateSlot; // Slot of the current state
+
+	// Only the state of the current precision is set
+	int precision; // precision_type_t
+	FloatBodyState floatState;
+	MixedBodyState mixedState;
+	DoubleBodyState doubleState;
+
+	float *mass;
+
+	// Cold data: only read by the springs model and the view
+	Vector3 *initialPosition;
+	float *radius;
+	Color *color;
+};
+
+/**
+ * @brief Conservation diagnostics of the last step measured
+ *
+ * Only the gravity mode measures them, fused into its force loop. The drifts
+ * compare against the first step measured since diagnostics were enabled or
+ * the force model changed.
+ */
+struct OrbitalDiagnostics
+{
+	bool valid; // Whether a step was measured with the current force model
+
+	double kineticEnergy;
+	double potentialEnergy;
+	double energy;
+	double momentumX, momentumY, momentumZ;
+	double angularMomentumX, angularMomentumY, angularMomentumZ;
+	double momentumScale; // sqrt(2 * mass * kinetic energy), a bound of the sum of |m v|
+
+	double energyDrift;			 // (E - E0) / |E0|
+	double momentumDrift;		 // |P - P0| / momentum scale at E0
+	double angularMomentumDrift; // |L - L0| / |L0|
+};
+
 /**
  * @brief Orbital simulation definition
  */
 struct OrbitalSim
 {
-	float timeStep;
-	float totalTime;
+	double timeStep;
+	double totalTime; // Kept in double, as a float loses whole seconds per step after a few decades
 	unsigned int bodyCount;
-	OrbitalBody *bodiesList;
+	unsigned int starSystemCount; // The first bodies, which attract each other; the rest are asteroids
+	OrbitalBodies bodiesList;
+	JobSystem *jobSystem; // Workers the steps are split across
+
+	float openingAngle;			  // Barnes-Hut theta: lower is more accurate and slower
+	BarnesHutTree *barnesHutTree; // Rebuilt on every Barnes-Hut step
+
+	int integrator;			// integrator_type_t
+	int accelerationsType; // Force model the scratch accelerations belong to, if still valid
+
+	// Block timesteps of the asteroids in the gravity mode
+	unsigned char *chunkLevel; // Each chunk of asteroids takes steps of 2^level timesteps
+	unsigned int blockStep;	   // Steps taken into the longest block
+	int blockSimType;		   // Force model the current block started with
+
+	// Conservation diagnostics
+	unsigned int diagnosticsInterval;  // Steps between measurements, 0 when off
+	unsigned int diagnosticsCountdown; // Steps until the next measurement is due
+	OrbitalDiagnostics diagnostics;
+	OrbitalDiagnostics diagnosticsReference; // Values the drifts are measured against
 };
 
-OrbitalSim *constructOrbitalSim(float timeStep);
+// Body state of a precision
+template <typename position_t, typename velocity_t>
+BodyState<position_t, velocity_t> *getBodyState(OrbitalSim *sim);
+
+template <>
+inline FloatBodyState *getBodyState<float, float>(OrbitalSim *sim)
+{
+	return &sim->bodiesList.floatState;
+}
+
+template <>
+inline MixedBodyState *getBodyState<double, float>(OrbitalSim *sim)
+{
+	return &sim->bodiesList.mixedState;
+}
+
+template <>
+inline DoubleBodyState *getBodyState<double, double>(OrbitalSim *sim)
+{
+	return &sim->bodiesList.doubleState;
+}
+
+// Body accessors, converting from and to the current precision
+template <typename position_t, typename velocity_t>
+inline Vector3 getStatePosition(const BodyState<position_t, velocity_t> *state, unsigned int i)
+{
+	return {(float)state->positionX[i], (float)state->positionY[i], (float)state->positionZ[i]};
+}
+
+template <typename position_t, typename velocity_t>
+inline Vector3 getStateVelocity(const BodyState<position_t, velocity_t> *state, unsigned int i)
+{
+	return {(float)state->velocityX[i], (float)state->velocityY[i], (float)state->velocityZ[i]};
+}
+
+inline Vector3 getBodyPosition(const OrbitalSim *sim, unsigned int i)
+{
+	switch (sim->bodiesList.precision)
+	{
+	case PRECISION_MIXED:
+		return getStatePosition(&sim->bodiesList.mixedState, i);
+	case PRECISION_DOUBLE:
+		return getStatePosition(&sim->bodiesList.doubleState, i);
+	default:
+		return getStatePosition(&sim->bodiesList.floatState, i);
+	}
+}
+
+inline void setBodyPosition(OrbitalSim *sim, unsigned int i, Vector3 position)
+{
+	switch (sim->bodiesList.precision)
+	{
+	case PRECISION_MIXED:
+		sim->bodiesList.mixedState.positionX[i] = position.x;
+		sim->bodiesList.mixedState.positionY[i] = position.y;
+		sim->bodiesList.mixedState.positionZ[i] = position.z;
+		break;
+	case PRECISION_DOUBLE:
+		sim->bodiesList.doubleState.positionX[i] = position.x;
+		sim->bodiesList.doubleState.positionY[i] = position.y;
+		sim->bodiesList.doubleState.positionZ[i] = position.z;
+		break;
+	default:
+		sim->bodiesList.floatState.positionX[i] = position.x;
+		sim->bodiesList.floatState.positionY[i] = position.y;
+		sim->bodiesList.floatState.positionZ[i] = position.z;
+		break;
+	}
+}
+
+inline Vector3 getBodyVelocity(const OrbitalSim *sim, unsigned int i)
+{
+	switch (sim->bodiesList.precision)
+	{
+	case PRECISION_MIXED:
+		return getStateVelocity(&sim->bodiesList.mixedState, i);
+	case PRECISION_DOUBLE:
+		return getStateVelocity(&sim->bodiesList.doubleState, i);
+	default:
+		return getStateVelocity(&sim->bodiesList.floatState, i);
+	}
+}
+
+inline void setBodyVelocity(OrbitalSim *sim, unsigned int i, Vector3 velocity)
+{
+	switch (sim->bodiesList.precision)
+	{
+	case PRECISION_MIXED:
+		sim->bodiesList.mixedState.velocityX[i] = velocity.x;
+		sim->bodiesList.mixedState.velocityY[i] = velocity.y;
+		sim->bodiesList.mixedState.velocityZ[i] = velocity.z;
+		break;
+	case PRECISION_DOUBLE:
+		sim->bodiesList.doubleState.velocityX[i] = velocity.x;
+		sim->bodiesList.doubleState.velocityY[i] = velocity.y;
+		sim->bodiesList.doubleState.velocityZ[i] = velocity.z;
+		break;
+	default:
+		sim->bodiesList.floatState.velocityX[i] = velocity.x;
+		sim->bodiesList.floatState.velocityY[i] = velocity.y;
+		sim->bodiesList.floatState.velocityZ[i] = velocity.z;
+		break;
+	}
+}
+
+inline float getBodyMass(const OrbitalSim *sim, unsigned int i)
+{
+	return sim->bodiesList.mass[i];
+}
+
+inline Vector3 getBodyInitialPosition(const OrbitalSim *sim, unsigned int i)
+{
+	return sim->bodiesList.initialPosition[i];
+}
+
+inline float getBodyRadius(const OrbitalSim *sim, unsigned int i)
+{
+	return sim->bodiesList.radius[i];
+}
+
+inline Color getBodyColor(const OrbitalSim *sim, unsigned int i)
+{
+	return sim->bodiesList.color[i];
+}
+
+OrbitalBody getOrbitalBody(const OrbitalSim *sim, unsigned int i);
+
+void setOrbitalBody(OrbitalSim *sim, unsigned int i, const OrbitalBody *body);
+
+void getOrbitalSimPositions(const OrbitalSim *sim, unsigned int first, unsigned int last,
+							float *positionX, float *positionY, float *positionZ);
+
+void getOrbitalSimPositions(const OrbitalSim *sim, unsigned int first, unsigned int last,
+							double *positionX, double *positionY, double *positionZ);
+
+void configureAsteroid(OrbitalBody *body, float centerMass, uint64_t key, unsigned int asteroid);
+
+void configureAsteroids(OrbitalSim *sim, unsigned int first, unsigned int count, float centerMass, unsigned int seed);
+
+unsigned int getStarSystem(int starSystem, OrbitalBody *bodies);
+
+OrbitalSim *allocateOrbitalSim(double timeStep, unsigned int starSystemCount, unsigned int bodyCount, int precision);
+
+OrbitalSim *constructOrbitalSim(double timeStep, unsigned int asteroidCount, unsigned int seed);
 
 void destroyOrbitalSim(OrbitalSim *sim);
 
 void updateOrbitalSim(OrbitalSim *sim, int simType);
 
+bool setOrbitalSimPrecision(OrbitalSim *sim, int precision);
+
+void setOrbitalSimDiagnostics(OrbitalSim *sim, unsigned int interval);
+
+OrbitalDiagnostics getOrbitalSimDiagnostics(const OrbitalSim *sim);
+
+unsigned int getOrbitalSimChunkCount(const OrbitalSim *sim);
+
 #endif
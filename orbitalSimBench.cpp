@@ -0,0 +1,363 @@
+/**
+ * @brief Headless physics benchmark: steps the simulation without a window
+ * @author Mariano Caceres Smoler
+ * @author Enzo Nicolas Rosa Fernandez
+ * @author Francisco Chiusaroli
+ *
+ * Usage: orbitalsim_bench [--asteroids N] [--steps N] [--warmup N] [--seed N]
+ *                         [--mode gravity|exact|springs|barnes-hut]
+ *                         [--integrator euler|leapfrog|yoshida4|forest-ruth]
+ *                         [--precision float|mixed|double]
+ *                         [--simd scalar|sse2|avx2|avx512] [--threads N] [--timestep S]
+ *                         [--diagnostics N] [--checkpoint-in FILE] [--checkpoint-out FILE]
+ *                         [--record FILE] [--record-interval N] [--scenario FILE]
+ *
+ * --diagnostics N measures the conserved quantities every N steps (gravity
+ * mode only, at the next step where every asteroid block ends) and reports
+ * their drift. --checkpoint-in resumes a saved run
+ * instead of building a new one (its timestep, integrator and precision win
+ * over the options) and reports how long restoring took; --checkpoint-out
+ * saves the run after the last step. --record records a frame of the
+ * trajectories every --record-interval steps (1 by default) while the measured
+ * steps run, and reports what was written. --scenario builds the run from a
+ * scenario file instead of --asteroids random asteroids, and reports how long
+ * loading took. Prints a single JSON object on stdout. Configure with
+ * -DORBITALSIM_SANITIZERS=OFF for meaningful numbers.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#include "checkpoint.h"
+#include "configuration.h"
+#include "jobSystem.h"
+#include "orbitalKernels.h"
+#include "orbitalSim.h"
+#include "scenario.h"
+#include "trajectoryRecorder.h"
+
+static const char *modeNames[LOGIC_TYPE_COUNT] = {"gravity", "exact", "springs", "barnes-hut"};
+static const char *integratorNames[INTEGRATOR_TYPE_COUNT] = {"euler", "leapfrog", "yoshida4", "forest-ruth"};
+static const char *precisionNames[PRECISION_TYPE_COUNT] = {"float", "mixed", "double"};
+static const char *simdNames[] = {"scalar", "sse2", "avx2", "avx512"};
+
+struct BenchOptions
+{
+	unsigned int asteroidCount;
+	unsigned int steps;
+	unsigned int warmupSteps;
+	unsigned int seed;
+	int simType;
+	int integrator;
+	int precision;
+	int simdLevel; // -1: best supported
+	unsigned int threads; // 0: shared job system
+	double timeStep;
+	unsigned int diagnosticsInterval; // 0: conservation not measured
+	const char *checkpointIn;		  // NULL: a new run
+	const char *checkpointOut;		  // NULL: not saved
+	const char *recordFile;			  // NULL: not recorded
+	unsigned int recordInterval;
+	const char *scenario; // NULL: the solar system and asteroidCount random asteroids
+};
+
+/**
+ * @brief Finds a name in a table
+ * @return Its index, or -1 if it is not there
+ */
+static int findName(const char *const *names, int count, const char *name)
+{
+	for (int i = 0; i < count; i++)
+	{
+		if (!strcmp(names[i], name))
+			return i;
+	}
+
+	return -1;
+}
+
+/**
+ * @brief Reads the command line
+ * @return Whether every option was valid
+ */
+static bool parseOptions(int argc, char **argv, BenchOptions *options)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		if (i + 1 >= argc)
+			return false;
+
+		const char *option = argv[i];
+		const char *value = argv[++i];
+
+		if (!strcmp(option, "--asteroids"))
+			options->asteroidCount = (unsigned int)strtoul(value, NULL, 10);
+		else if (!strcmp(option, "--steps"))
+			options->steps = (unsigned int)strtoul(value, NULL, 10);
+		else if (!strcmp(option, "--warmup"))
+			options->warmupSteps = (unsigned int)strtoul(value, NULL, 10);
+		else if (!strcmp(option, "--seed"))
+			options->seed = (unsigned int)strtoul(value, NULL, 10);
+		else if (!strcmp(option, "--threads"))
+			options->threads = (unsigned int)strtoul(value, NULL, 10);
+		else if (!strcmp(option, "--timestep"))
+			options->timeStep = strtod(value, NULL);
+		else if (!strcmp(option, "--mode"))
+			options->simType = findName(modeNames, LOGIC_TYPE_COUNT, value);
+		else if (!strcmp(option, "--integrator"))
+			options->integrator = findName(integratorNames, INTEGRATOR_TYPE_COUNT, value);
+		else if (!strcmp(option, "--precision"))
+			options->precision = findName(precisionNames, PRECISION_TYPE_COUNT, value);
+		else if (!strcmp(option, "--diagnostics"))
+			options->diagnosticsInterval = (unsigned int)strtoul(value, NULL, 10);
+		else if (!strcmp(option, "--checkpoint-in"))
+			options->checkpointIn = value;
+		else if (!strcmp(option, "--checkpoint-out"))
+			options->checkpointOut = value;
+		else if (!strcmp(option, "--record"))
+			options->recordFile = value;
+		else if (!strcmp(option, "--record-interval"))
+			options->recordInterval = (unsigned int)strtoul(value, NULL, 10);
+		else if (!strcmp(option, "--scenario"))
+			options->scenario = value;
+		else if (!strcmp(option, "--simd"))
+		{
+			options->simdLevel = findName(simdNames, SIMD_AVX512 + 1, value);
+
+			if (options->simdLevel < 0)
+				return false;
+		}
+		else
+			return false;
+	}
+
+	return options->simType >= 0 && options->integrator >= 0 && options->precision >= 0 &&
+		   options->steps > 0 && options->timeStep > 0;
+}
+
+/**
+ * @brief Gets the largest resident set the process has had
+ * @return Bytes, or 0 if unknown
+ */
+static unsigned long long getPeakResidentBytes()
+{
+#if defined(_WIN32)
+	PROCESS_MEMORY_COUNTERS counters;
+
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return counters.PeakWorkingSetSize;
+
+	return 0;
+#else
+	struct rusage usage;
+
+	if (getrusage(RUSAGE_SELF, &usage))
+		return 0;
+
+#if defined(__APPLE__)
+	return (unsigned long long)usage.ru_maxrss; // Bytes on macOS
+#else
+	return (unsigned long long)usage.ru_maxrss * 1024; // Kilobytes on Linux
+#endif
+#endif
+}
+
+int main(int argc, char **argv)
+{
+	BenchOptions options;
+
+	options.asteroidCount = ASTEROIDS_BODYNUM;
+	options.steps = 1000;
+	options.warmupSteps = 10;
+	options.seed = 1;
+	options.simType = GRAVITATIONAL_SIMULATION;
+	options.integrator = INTEGRATOR_EULER;
+	options.precision = PRECISION_FLOAT;
+	options.simdLevel = -1;
+	options.threads = 0;
+	options.timeStep = 10 * 86400 / 60.0; // As the interactive simulation: 10 days per second at 60 fps
+	options.diagnosticsInterval = 0;
+	options.checkpointIn = NULL;
+	options.checkpointOut = NULL;
+	options.recordFile = NULL;
+	options.recordInterval = 1;
+	options.scenario = NULL;
+
+	if (!parseOptions(argc, argv, &options))
+	{
+		fprintf(stderr, "usage: %s [--asteroids N] [--steps N] [--warmup N] [--seed N]\n"
+						"          [--mode gravity|exact|springs|barnes-hut]\n"
+						"          [--integrator euler|leapfrog|yoshida4|forest-ruth]\n"
+						"          [--precision float|mixed|double]\n"
+						"          [--simd scalar|sse2|avx2|avx512] [--threads N] [--timestep S]\n"
+						"          [--diagnostics N] [--checkpoint-in FILE] [--checkpoint-out FILE]\n"
+						"          [--record FILE] [--record-interval N] [--scenario FILE]\n",
+				argv[0]);
+
+		return 1;
+	}
+
+	simd_level_t simdLevel = (options.simdLevel < 0) ? getSimdLevel() : setSimdLevel((simd_level_t)options.simdLevel);
+
+	OrbitalSim *sim;
+	double restoreSeconds = 0;
+	double loadSeconds = 0;
+
+	if (options.checkpointIn)
+	{
+		std::chrono::steady_clock::time_point restoreStart = std::chrono::steady_clock::now();
+
+		sim = loadOrbitalSimCheckpoint(options.checkpointIn);
+		restoreSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - restoreStart).count();
+
+		if (!sim)
+		{
+			fprintf(stderr, "could not restore %s\n", options.checkpointIn);
+
+			return 1;
+		}
+
+		options.timeStep = sim->timeStep;
+		options.integrator = sim->integrator;
+		options.precision = sim->bodiesList.precision;
+	}
+	else if (options.scenario)
+	{
+		std::chrono::steady_clock::time_point loadStart = std::chrono::steady_clock::now();
+
+		sim = loadOrbitalSimScenario(options.scenario, options.timeStep);
+		loadSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - loadStart).count();
+
+		if (!sim || !setOrbitalSimPrecision(sim, options.precision))
+		{
+			fprintf(stderr, "could not load %s\n", options.scenario);
+
+			return 1;
+		}
+	}
+	else
+	{
+		sim = constructOrbitalSim(options.timeStep, options.asteroidCount, options.seed);
+
+		if (!sim || !setOrbitalSimPrecision(sim, options.precision))
+		{
+			fprintf(stderr, "could not allocate %u asteroids\n", options.asteroidCount);
+
+			return 1;
+		}
+	}
+
+	JobSystem *jobSystem = NULL;
+	unsigned int threadCount = 1;
+
+	if (options.threads == 1)
+		sim->jobSystem = NULL; // Every job runs inline
+	else if (options.threads > 1)
+	{
+		// The calling thread helps too, so N threads means N - 1 workers
+		jobSystem = constructJobSystem(options.threads - 1);
+		sim->jobSystem = jobSystem;
+	}
+
+	if (sim->jobSystem)
+		threadCount = getJobSystemThreadCount(sim->jobSystem);
+
+	sim->integrator = options.integrator;
+	setOrbitalSimDiagnostics(sim, options.diagnosticsInterval);
+
+	for (unsigned int i = 0; i < options.warmupSteps; i++)
+		updateOrbitalSim(sim, options.simType);
+
+	TrajectoryRecorder *recorder = NULL;
+
+	if (options.recordFile)
+	{
+		recorder = constructTrajectoryRecorder(options.recordFile, sim, options.recordInterval);
+
+		if (!recorder)
+		{
+			fprintf(stderr, "could not create %s\n", options.recordFile);
+
+			return 1;
+		}
+	}
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	for (unsigned int i = 0; i < options.steps; i++)
+	{
+		updateOrbitalSim(sim, options.simType);
+
+		if (recorder)
+			recordOrbitalSim(recorder, sim);
+	}
+
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	TrajectoryStats recordStats = {};
+
+	// Outside the measured time: writes the frames still queued
+	if (recorder)
+		recordStats = destroyTrajectoryRecorder(recorder);
+	double bodySteps = (double)options.steps * sim->bodyCount;
+
+	OrbitalDiagnostics diagnostics = getOrbitalSimDiagnostics(sim);
+
+	if (options.checkpointOut)
+	{
+		CheckpointWriter *writer = constructCheckpointWriter();
+		bool saved = saveOrbitalSimCheckpoint(writer, sim, options.checkpointOut) && waitCheckpointWriter(writer);
+
+		destroyCheckpointWriter(writer);
+
+		if (!saved)
+			fprintf(stderr, "could not save %s\n", options.checkpointOut);
+	}
+
+	printf("{\"mode\": \"%s\", \"integrator\": \"%s\", \"precision\": \"%s\", \"simd\": \"%s\", "
+		   "\"threads\": %u, \"bodies\": %u, \"seed\": %u, \"time_step\": %g, \"steps\": %u, "
+		   "\"seconds\": %.6f, \"steps_per_second\": %.3f, \"ns_per_body_step\": %.3f, "
+		   "\"peak_rss_bytes\": %llu, \"huge_pages\": %s",
+		   modeNames[options.simType], integratorNames[options.integrator], precisionNames[options.precision],
+		   getSimdLevelName(simdLevel), threadCount, sim->bodyCount, options.seed,
+		   options.timeStep, options.steps,
+		   seconds, options.steps / seconds, seconds * 1E9 / bodySteps,
+		   getPeakResidentBytes(), sim->bodiesList.arena->hugePages ? "true" : "false");
+
+	if (options.recordFile)
+	{
+		printf(", \"frames_recorded\": %llu, \"frames_dropped\": %llu, \"bytes_recorded\": %llu",
+			   recordStats.framesRecorded, recordStats.framesDropped, recordStats.bytesWritten);
+	}
+
+	if (options.checkpointIn)
+		printf(", \"simulated_seconds\": %g, \"restore_seconds\": %.6f", sim->totalTime, restoreSeconds);
+	else if (options.scenario)
+		printf(", \"load_seconds\": %.6f", loadSeconds);
+
+	// Against the first warmup step
+	if (diagnostics.valid)
+	{
+		printf(", \"energy_drift\": %.3e, \"momentum_drift\": %.3e, \"angular_momentum_drift\": %.3e",
+			   diagnostics.energyDrift, diagnostics.momentumDrift, diagnostics.angularMomentumDrift);
+	}
+
+	printf("}\n");
+
+	destroyOrbitalSim(sim);
+
+	if (jobSystem)
+		destroyJobSystem(jobSystem);
+
+	shutdownJobSystem();
+
+	return 0;
+}
@@ -0,0 +1,57 @@
+/**
+ * @brief Offline converter: writes the binary cache of OBJ models
+ * @author Mariano Caceres Smoler
+ * @author Enzo Nicolas Rosa Fernandez
+ * @author Francisco Chiusaroli
+ *
+ * Usage: orbitalsim_cache model.obj [model.obj ...]
+ *
+ * Writes model.obj.cache next to every model (see modelCache.cpp). The game
+ * loads it instead of parsing the OBJ while neither the OBJ, its MTL files nor
+ * its maps change. Needs no window.
+ */
+
+#include <cstdio>
+
+#include "assetLoader.h"
+#include "modelCache.h"
+
+int main(int argc, char **argv)
+{
+	if (argc < 2)
+	{
+		fprintf(stderr, "usage: %s model.obj [model.obj ...]\n", argv[0]);
+
+		return 1;
+	}
+
+	SetTraceLogLevel(LOG_WARNING);
+
+	int failures = 0;
+
+	for (int i = 1; i < argc; i++)
+	{
+		ModelData data;
+		std::vector<std::string> sources;
+
+		if (!decodeObjFile(argv[i], &data, &sources))
+		{
+			fprintf(stderr, "%s: could not read the model\n", argv[i]);
+			failures++;
+
+			continue;
+		}
+
+		if (writeModelCache(argv[i], &data, sources))
+			printf("%s -> %s\n", argv[i], getModelCachePath(argv[i]).c_str());
+		else
+		{
+			fprintf(stderr, "%s: could not write the cache\n", argv[i]);
+			failures++;
+		}
+
+		unloadModelData(&data);
+	}
+
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,73 @@
+/**
+ * @brief Offline decoder: prints a recorded trajectory as CSV
+ * @author Mariano Caceres Smoler
+ * @author Enzo Nicolas Rosa Fernandez
+ * @author Francisco Chiusaroli
+ *
+ * Usage: orbitalsim_trajectory FILE [--body N]
+ *
+ * Prints one line per body and frame, "time,body,x,y,z" in seconds and meters,
+ * or only the lines of body N. See trajectoryRecorder.cpp for the format.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "trajectoryReplay.h"
+
+int main(int argc, char **argv)
+{
+	long selectedBody = -1;
+
+	if (argc == 4 && !strcmp(argv[2], "--body"))
+		selectedBody = strtol(argv[3], NULL, 10);
+	else if (argc != 2)
+	{
+		fprintf(stderr, "usage: %s FILE [--body N]\n", argv[0]);
+
+		return 1;
+	}
+
+	TrajectoryReplay *replay = constructTrajectoryReplay(argv[1]);
+
+	if (!replay)
+	{
+		fprintf(stderr, "%s: not a trajectory file\n", argv[1]);
+
+		return 1;
+	}
+
+	unsigned int bodyCount = getTrajectoryReplayBodyCount(replay);
+	unsigned int frameCount = getTrajectoryReplayFrameCount(replay);
+	int result = 0;
+
+	printf("time,body,x,y,z\n");
+
+	for (unsigned int frame = 0; frame < frameCount; frame++)
+	{
+		double time = getTrajectoryReplayFrameTime(replay, frame);
+		const double *positions = decodeTrajectoryReplayFrame(replay, frame);
+
+		if (!positions)
+		{
+			fprintf(stderr, "%s: damaged frame at %g s\n", argv[1], time);
+			result = 1;
+
+			break;
+		}
+
+		for (unsigned int body = 0; body < bodyCount; body++)
+		{
+			if (selectedBody >= 0 && body != (unsigned long)selectedBody)
+				continue;
+
+			printf("%.0f,%u,%.0f,%.0f,%.0f\n", time, body,
+				   positions[body], positions[bodyCount + body], positions[2 * (size_t)bodyCount + body]);
+		}
+	}
+
+	destroyTrajectoryReplay(replay);
+
+	return result;
+}
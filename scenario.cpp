@@ -0,0 +1,636 @@
+/**
+ * @brief Loads orbital simulations from scenario files and orbital element catalogs
+ * @author Mariano Caceres Smoler
+ * @author Enzo Nicolas Rosa Fernandez
+ * @author Francisco Chiusaroli
+ *
+ * A scenario is a text file with one directive per line, # starts a comment:
+ *   system solar|alpha-centauri  Appends a built-in star system
+ *   body NAME MASS RADIUS R G B X Y Z VX VY VZ
+ *                                Appends a body to the star system, in SI units
+ *                                and simulation axes (y is the ecliptic north)
+ *   asteroids COUNT              Adds random asteroids, as the default simulation
+ *   seed SEED                    Seed of the random asteroids, 1 by default
+ *   catalog FILE [LIMIT]         Adds the asteroids of an MPCORB file, or its first LIMIT
+ * Catalog paths are relative to the scenario.
+ *
+ * Catalogs are mapped and read in rounds of blocks of lines, each block parsed
+ * by its own job. Lines that are not elliptic orbits, like the header and the
+ * blank lines between groups, are skipped. The elements are propagated to the
+ * epoch of the ephemerides and, once the simulation is allocated, every job
+ * converts a range of them to state vectors around the most massive body and
+ * writes them straight into the body arrays.
+ */
+
+#define _USE_MATH_DEFINES
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "mappedFile.h"
+#include "scenario.h"
+
+#define SCENARIO_MAX_LINE 1024
+#define SCENARIO_EPOCH_JD 2459580.5 // 2022-01-01T00:00:00, as the ephemerides
+
+#define CATALOG_BLOCK_SIZE (1 << 20)  // Bytes of lines parsed by each job
+#define CATALOG_BLOCKS_PER_ROUND 64	  // Blocks parsed before the limit is checked
+#define CATALOG_BODIES_PER_JOB 4096	  // Asteroids converted by each job
+#define CATALOG_MIN_LINE_LENGTH 103	  // Up to the semi-major axis
+#define ASTRONOMICAL_UNIT 1.495978707E11 // [m]
+#define ASTEROID_ALBEDO 0.14	 // Typical geometric albedo, to size asteroids from their magnitude
+#define ASTEROID_DENSITY 2000.0 // [kg/m^3]
+#define KEPLER_MAX_ITERATIONS 32
+#define KEPLER_TOLERANCE 1E-12
+
+/**
+ * @brief Orbit of a catalog asteroid around the most massive body
+ */
+struct CatalogElements
+{
+	double semiMajorAxis; // [m]
+	double eccentricity;
+	double inclination;		   // [rad]
+	double ascendingNode;	   // [rad]
+	double perihelionArgument; // [rad]
+	double meanAnomaly;		   // [rad], at the epoch of the ephemerides
+	float radius;			   // [m], 0 if the catalog has no magnitude
+};
+
+/**
+ * @brief Everything a scenario file asks for
+ */
+struct ScenarioDescription
+{
+	std::vector<OrbitalBody> starSystem;
+	unsigned int asteroidCount; // Random ones
+	unsigned int seed;
+	std::vector<CatalogElements> catalog;
+};
+
+/**
+ * @brief Parses a fixed point decimal, as the catalog columns
+ *
+ * Faster than strtod, which catalogs of a million lines would spend most of
+ * their loading time in.
+ *
+ * @param line The line
+ * @param first First column, counting from 1
+ * @param last Last column
+ * @param value Filled in with the value
+ * @return Whether the columns hold a number, padded with spaces
+ */
+static bool parseCatalogField(const char *line, int first, int last, double *value)
+{
+	static const double powersOfTen[] = {1E0, 1E1, 1E2, 1E3, 1E4, 1E5, 1E6, 1E7, 1E8, 1E9, 1E10, 1E11, 1E12};
+
+	const char *c = line + first - 1;
+	const char *end = line + last;
+
+	while (c < end && *c == ' ')
+		c++;
+
+	bool negative = (c < end && *c == '-');
+
+	if (c < end && (*c == '-' || *c == '+'))
+		c++;
+
+	long long digits = 0;
+	int digitCount = 0;
+	int decimals = -1; // Digits after the point, -1 before it
+
+	for (; c < end && *c != ' '; c++)
+	{
+		if (*c == '.' && decimals < 0)
+			decimals = 0;
+		else if (*c >= '0' && *c <= '9')
+		{
+			digits = 10 * digits + (*c - '0');
+			digitCount++;
+
+			if (decimals >= 0)
+				decimals++;
+		}
+		else
+			return false;
+	}
+
+	for (const char *padding = c; padding < end; padding++)
+	{
+		if (*padding != ' ')
+			return false;
+	}
+
+	if (!digitCount || decimals > 12)
+		return false;
+
+	*value = (double)digits / powersOfTen[std::max(decimals, 0)];
+
+	if (negative)
+		*value = -*value;
+
+	return true;
+}
+
+/**
+ * @brief Gets the Julian date of the start of a day
+ */
+static double getJulianDate(int year, int month, int day)
+{
+	int a = (14 - month) / 12;
+	int y = year + 4800 - a;
+	int m = month + 12 * a - 3;
+
+	// Day number at noon
+	long dayNumber = day + (153 * m + 2) / 5 + 365L * y + y / 4 - y / 100 + y / 400 - 32045;
+
+	return dayNumber - 0.5;
+}
+
+/**
+ * @brief Decodes a packed epoch: century letter, year, month and day, e.g. K239D for 2023-09-13
+ *
+ * @param packed The 5 packed characters
+ * @param julianDate Filled in with the Julian date
+ * @return Whether the epoch is valid
+ */
+static bool parsePackedEpoch(const char *packed, double *julianDate)
+{
+	if (packed[0] < 'I' || packed[0] > 'L' ||
+		packed[1] < '0' || packed[1] > '9' || packed[2] < '0' || packed[2] > '9')
+		return false;
+
+	int values[2]; // Month and day: 1 to 9, then A for 10 onwards
+
+	for (int i = 0; i < 2; i++)
+	{
+		char c = packed[3 + i];
+
+		if (c >= '1' && c <= '9')
+			values[i] = c - '0';
+		else if (c >= 'A' && c <= 'V')
+			values[i] = c - 'A' + 10;
+		else
+			return false;
+	}
+
+	if (values[0] > 12)
+		return false;
+
+	int year = 100 * (packed[0] - 'I' + 18) + 10 * (packed[1] - '0') + (packed[2] - '0');
+
+	*julianDate = getJulianDate(year, values[0], values[1]);
+
+	return true;
+}
+
+/**
+ * @brief Parses a line of an MPCORB file
+ *
+ * @param line The line, without its line break
+ * @param length Characters in the line
+ * @param elements Filled in with the orbit
+ * @return Whether the line holds an elliptic orbit
+ */
+static bool parseCatalogLine(const char *line, size_t length, CatalogElements *elements)
+{
+	double magnitude, epoch, meanAnomaly, perihelionArgument, ascendingNode, inclination;
+	double eccentricity, meanMotion, semiMajorAxis;
+
+	if (length < CATALOG_MIN_LINE_LENGTH ||
+		!parsePackedEpoch(line + 20, &epoch) ||
+		!parseCatalogField(line, 27, 35, &meanAnomaly) ||
+		!parseCatalogField(line, 38, 46, &perihelionArgument) ||
+		!parseCatalogField(line, 49, 57, &ascendingNode) ||
+		!parseCatalogField(line, 60, 68, &inclination) ||
+		!parseCatalogField(line, 71, 79, &eccentricity) ||
+		!parseCatalogField(line, 81, 91, &meanMotion) ||
+		!parseCatalogField(line, 93, 103, &semiMajorAxis))
+		return false;
+
+	if (!(eccentricity >= 0 && eccentricity < 1) || !(semiMajorAxis > 0))
+		return false;
+
+	double degrees = M_PI / 180;
+
+	// Moved along the orbit from the epoch of the catalog to the one of the ephemerides
+	meanAnomaly = fmod((meanAnomaly + meanMotion * (SCENARIO_EPOCH_JD - epoch)) * degrees, 2 * M_PI);
+
+	if (meanAnomaly > M_PI)
+		meanAnomaly -= 2 * M_PI;
+	else if (meanAnomaly < -M_PI)
+		meanAnomaly += 2 * M_PI;
+
+	elements->semiMajorAxis = semiMajorAxis * ASTRONOMICAL_UNIT;
+	elements->eccentricity = eccentricity;
+	elements->inclination = inclination * degrees;
+	elements->ascendingNode = ascendingNode * degrees;
+	elements->perihelionArgument = perihelionArgument * degrees;
+	elements->meanAnomaly = meanAnomaly;
+
+	// https://en.wikipedia.org/wiki/Absolute_magnitude#Solar_System_bodies_(H)
+	if (parseCatalogField(line, 9, 13, &magnitude))
+		elements->radius = (float)(1329E3 / 2 / sqrt(ASTEROID_ALBEDO) * pow(10, -magnitude / 5));
+	else
+		elements->radius = 0;
+
+	return true;
+}
+
+/**
+ * @brief Parses the lines that start inside a block of a catalog
+ *
+ * @param data The catalog
+ * @param size Bytes in the catalog
+ * @param begin Offset of the block
+ * @param end Offset past the block; its last line is read to the end
+ * @param elements Filled in with the orbits, in file order
+ */
+static void parseCatalogBlock(const char *data, size_t size, size_t begin, size_t end, std::vector<CatalogElements> *elements)
+{
+	size_t offset = begin;
+
+	// A line that started in the block before belongs to it
+	if (offset > 0 && data[offset - 1] != '\n')
+	{
+		const char *lineBreak = (const char *)memchr(data + offset, '\n', size - offset);
+
+		offset = lineBreak ? (size_t)(lineBreak - data) + 1 : size;
+	}
+
+	end = std::min(end, size);
+
+	while (offset < end)
+	{
+		const char *line = data + offset;
+		const char *lineBreak = (const char *)memchr(line, '\n', size - offset);
+		size_t length = lineBreak ? (size_t)(lineBreak - line) : size - offset;
+
+		offset += length + 1;
+
+		if (length && line[length - 1] == '\r')
+			length--;
+
+		CatalogElements lineElements;
+
+		if (parseCatalogLine(line, length, &lineElements))
+			elements->push_back(lineElements);
+	}
+}
+
+/**
+ * @brief Reads the orbits of an MPCORB file, in parallel
+ *
+ * @param fileName The catalog
+ * @param limit Orbits to read at most, from the start of the file
+ * @param elements Appended with the orbits
+ * @return Whether the file could be mapped
+ */
+static bool loadCatalog(const char *fileName, unsigned int limit, std::vector<CatalogElements> *elements)
+{
+	MappedFile *mappedFile = constructMappedFile(fileName);
+
+	if (!mappedFile)
+		return false;
+
+	const char *data = (const char *)mappedFile->data;
+	size_t size = mappedFile->size;
+	size_t read = 0;
+
+	// In rounds, so a limit stops the reading early and only a round of blocks waits to be appended
+	for (size_t offset = 0; offset < size && read < limit; offset += (size_t)CATALOG_BLOCKS_PER_ROUND * CATALOG_BLOCK_SIZE)
+	{
+		unsigned int blockCount = (unsigned int)std::min((size_t)CATALOG_BLOCKS_PER_ROUND,
+														 (size - offset + CATALOG_BLOCK_SIZE - 1) / CATALOG_BLOCK_SIZE);
+		std::vector<std::vector<CatalogElements>> blocks(blockCount);
+
+		parallelFor(getJobSystem(), 0, blockCount, 1, [&](unsigned int begin, unsigned int end)
+					{
+						for (unsigned int block = begin; block < end; block++)
+						{
+							size_t blockOffset = offset + (size_t)block * CATALOG_BLOCK_SIZE;
+
+							parseCatalogBlock(data, size, blockOffset, blockOffset + CATALOG_BLOCK_SIZE, &blocks[block]);
+						}
+					});
+
+		for (std::vector<CatalogElements> &block : blocks)
+		{
+			size_t count = std::min(block.size(), (size_t)(limit - read));
+
+			elements->insert(elements->end(), block.begin(), block.begin() + count);
+			read += count;
+		}
+	}
+
+	destroyMappedFile(mappedFile);
+
+	return true;
+}
+
+/**
+ * @brief Gets the state of a catalog asteroid around the most massive body
+ *
+ * @param elements The orbit
+ * @param centerGM Gravitational parameter of the most massive body
+ * @param position, velocity Filled in, in ecliptic axes (z is the ecliptic north)
+ */
+static void getCatalogState(const CatalogElements *elements, double centerGM, double position[3], double velocity[3])
+{
+	double a = elements->semiMajorAxis;
+	double e = elements->eccentricity;
+	double meanAnomaly = elements->meanAnomaly;
+
+	// Kepler's equation, M = E - e sin(E), by Newton's method
+	double E = (e < 0.8) ? meanAnomaly : M_PI;
+
+	for (int i = 0; i < KEPLER_MAX_ITERATIONS; i++)
+	{
+		double delta = (E - e * sin(E) - meanAnomaly) / (1 - e * cos(E));
+
+		E -= delta;
+
+		if (fabs(delta) < KEPLER_TOLERANCE)
+			break;
+	}
+
+	double cosE = cos(E), sinE = sin(E);
+	double b = sqrt(1 - e * e);
+	double r = a * (1 - e * cosE);
+
+	// In the plane of the orbit, x towards the perihelion
+	double x = a * (cosE - e);
+	double y = a * b * sinE;
+	double speed = sqrt(centerGM * a) / r;
+	double vx = -speed * sinE;
+	double vy = speed * b * cosE;
+
+	// Rotated by the argument of perihelion, the inclination and the ascending node
+	double cosW = cos(elements->perihelionArgument), sinW = sin(elements->perihelionArgument);
+	double cosI = cos(elements->inclination), sinI = sin(elements->inclination);
+	double cosO = cos(elements->ascendingNode), sinO = sin(elements->ascendingNode);
+
+	double p[3] = {cosO * cosW - sinO * sinW * cosI, sinO * cosW + cosO * sinW * cosI, sinW * sinI};
+	double q[3] = {-cosO * sinW - sinO * cosW * cosI, -sinO * sinW + cosO * cosW * cosI, cosW * sinI};
+
+	for (int axis = 0; axis < 3; axis++)
+	{
+		position[axis] = p[axis] * x + q[axis] * y;
+		velocity[axis] = p[axis] * vx + q[axis] * vy;
+	}
+}
+
+/**
+ * @brief Prints a scenario error
+ */
+static void reportScenarioError(const char *fileName, unsigned int lineNumber, const char *message, const char *detail)
+{
+	fprintf(stderr, "%s:%u: %s%s\n", fileName, lineNumber, message, detail);
+}
+
+/**
+ * @brief Resolves a path of a scenario, relative to the scenario file
+ */
+static std::string getScenarioPath(const char *scenarioFileName, const char *path)
+{
+	std::string scenario = scenarioFileName;
+	size_t separator = scenario.find_last_of("/\\");
+
+	if (path[0] == '/' || path[0] == '\\' || (path[0] && path[1] == ':') || separator == std::string::npos)
+		return path;
+
+	return scenario.substr(0, separator + 1) + path;
+}
+
+/**
+ * @brief Reads a scenario file and the catalogs it names
+ *
+ * @param fileName The scenario
+ * @param description Filled in with the bodies
+ * @return Whether the scenario is valid, errors are printed to stderr
+ */
+static bool readScenario(const char *fileName, ScenarioDescription *description)
+{
+	FILE *file = fopen(fileName, "r");
+
+	if (!file)
+	{
+		fprintf(stderr, "%s: could not open\n", fileName);
+
+		return false;
+	}
+
+	char line[SCENARIO_MAX_LINE];
+	unsigned int lineNumber = 0;
+	bool valid = true;
+
+	description->asteroidCount = 0;
+	description->seed = 1;
+
+	while (valid && fgets(line, sizeof(line), file))
+	{
+		lineNumber++;
+
+		char *comment = strchr(line, '#');
+
+		if (comment)
+			*comment = '\0';
+
+		char directive[32];
+		char name[SCENARIO_MAX_LINE];
+
+		if (sscanf(line, "%31s", directive) != 1)
+			continue;
+
+		if (!strcmp(directive, "system"))
+		{
+			OrbitalBody bodies[STAR_SYSTEM_MAX_BODYNUM];
+			unsigned int bodyCount = 0;
+
+			if (sscanf(line, "%*s %1023s", name) == 1)
+			{
+				if (!strcmp(name, "solar"))
+					bodyCount = getStarSystem(STAR_SYSTEM_SOLAR, bodies);
+				else if (!strcmp(name, "alpha-centauri"))
+					bodyCount = getStarSystem(STAR_SYSTEM_ALPHA_CENTAURI, bodies);
+			}
+
+			if (!bodyCount)
+			{
+				reportScenarioError(fileName, lineNumber, "expected system solar|alpha-centauri", "");
+				valid = false;
+			}
+
+			description->starSystem.insert(description->starSystem.end(), bodies, bodies + bodyCount);
+		}
+		else if (!strcmp(directive, "body"))
+		{
+			OrbitalBody body;
+			int red, green, blue;
+
+			if (sscanf(line, "%*s %1023s %f %f %d %d %d %f %f %f %f %f %f", name, &body.mass, &body.radius,
+					   &red, &green, &blue, &body.position.x, &body.position.y, &body.position.z,
+					   &body.velocity.x, &body.velocity.y, &body.velocity.z) != 12 ||
+				!(body.mass > 0))
+			{
+				reportScenarioError(fileName, lineNumber, "expected body NAME MASS RADIUS R G B X Y Z VX VY VZ", "");
+				valid = false;
+			}
+
+			body.initialPosition = body.position;
+			body.color = {(unsigned char)red, (unsigned char)green, (unsigned char)blue, 255};
+
+			description->starSystem.push_back(body);
+		}
+		else if (!strcmp(directive, "asteroids"))
+		{
+			unsigned int count;
+
+			if (sscanf(line, "%*s %u", &count) != 1)
+			{
+				reportScenarioError(fileName, lineNumber, "expected asteroids COUNT", "");
+				valid = false;
+			}
+
+			description->asteroidCount += count;
+		}
+		else if (!strcmp(directive, "seed"))
+		{
+			if (sscanf(line, "%*s %u", &description->seed) != 1)
+			{
+				reportScenarioError(fileName, lineNumber, "expected seed SEED", "");
+				valid = false;
+			}
+		}
+		else if (!strcmp(directive, "catalog"))
+		{
+			unsigned int limit = ~0U;
+
+			if (sscanf(line, "%*s %1023s %u", name, &limit) < 1)
+			{
+				reportScenarioError(fileName, lineNumber, "expected catalog FILE [LIMIT]", "");
+				valid = false;
+			}
+			else if (!loadCatalog(getScenarioPath(fileName, name).c_str(), limit, &description->catalog))
+			{
+				reportScenarioError(fileName, lineNumber, "could not open ", name);
+				valid = false;
+			}
+		}
+		else
+		{
+			reportScenarioError(fileName, lineNumber, "unknown directive ", directive);
+			valid = false;
+		}
+
+		if (description->starSystem.size() > STAR_SYSTEM_MAX_BODYNUM)
+		{
+			reportScenarioError(fileName, lineNumber, "too many bodies in the star system", "");
+			valid = false;
+		}
+	}
+
+	fclose(file);
+
+	if (valid && description->starSystem.empty())
+	{
+		fprintf(stderr, "%s: no star system\n", fileName);
+		valid = false;
+	}
+
+	return valid;
+}
+
+/**
+ * @brief Constructs an orbital simulation from a scenario file
+ *
+ * Star system bodies come first, in the order of the file. Catalog asteroids
+ * follow, from the smallest orbit outwards, and random asteroids after them
+ * from the center outwards, so the asteroids of a chunk need similar steps.
+ *
+ * @param fileName The scenario
+ * @param timeStep The time step
+ * @return The orbital simulation, or NULL if the scenario is invalid (errors
+ *         are printed to stderr) or could not be allocated
+ */
+OrbitalSim *loadOrbitalSimScenario(const char *fileName, double timeStep)
+{
+	ScenarioDescription description;
+
+	if (!readScenario(fileName, &description))
+		return NULL;
+
+	std::vector<CatalogElements> &catalog = description.catalog;
+	unsigned int starSystemCount = (unsigned int)description.starSystem.size();
+	unsigned long long bodyCount = (unsigned long long)starSystemCount + catalog.size() + description.asteroidCount;
+
+	if (bodyCount > ~0U)
+	{
+		fprintf(stderr, "%s: too many bodies\n", fileName);
+
+		return NULL;
+	}
+
+	OrbitalSim *sim = allocateOrbitalSim(timeStep, starSystemCount, (unsigned int)bodyCount, PRECISION_FLOAT);
+
+	if (!sim)
+	{
+		fprintf(stderr, "%s: could not allocate %llu bodies\n", fileName, bodyCount);
+
+		return NULL;
+	}
+
+	const OrbitalBody *center = &description.starSystem[0];
+
+	for (unsigned int i = 0; i < starSystemCount; i++)
+	{
+		setOrbitalBody(sim, i, &description.starSystem[i]);
+
+		if (description.starSystem[i].mass > center->mass)
+			center = &description.starSystem[i];
+	}
+
+	std::sort(catalog.begin(), catalog.end(), [](const CatalogElements &a, const CatalogElements &b)
+			  { return a.semiMajorAxis < b.semiMajorAxis; });
+
+	double centerGM = GRAVITATIONAL_CONSTANT * (double)center->mass;
+	Vector3 centerPosition = center->position;
+	Vector3 centerVelocity = center->velocity;
+	const CatalogElements *elements = catalog.data();
+
+	parallelFor(sim->jobSystem, 0, (unsigned int)catalog.size(), CATALOG_BODIES_PER_JOB, [=](unsigned int begin, unsigned int end)
+				{
+					for (unsigned int i = begin; i < end; i++)
+					{
+						double position[3], velocity[3];
+
+						getCatalogState(&elements[i], centerGM, position, velocity);
+
+						// Ecliptic axes to the ones of the simulation, where y is the ecliptic north
+						OrbitalBody body;
+						float radius = elements[i].radius;
+
+						body.position = {centerPosition.x + (float)position[0],
+										 centerPosition.y + (float)position[2],
+										 centerPosition.z + (float)position[1]};
+						body.initialPosition = body.position;
+						body.velocity = {centerVelocity.x + (float)velocity[0],
+										 centerVelocity.y + (float)velocity[2],
+										 centerVelocity.z + (float)velocity[1]};
+						body.radius = radius ? radius : 2E3F;
+						body.mass = radius ? (float)(ASTEROID_DENSITY * 4 / 3 * M_PI * radius * radius * radius) : 1E12F;
+						body.color = GRAY;
+
+						setOrbitalBody(sim, starSystemCount + i, &body);
+					}
+				});
+
+	configureAsteroids(sim, starSystemCount + (unsigned int)catalog.size(), description.asteroidCount,
+					   center->mass, description.seed);
+
+	return sim;
+}
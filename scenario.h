@@ -0,0 +1,15 @@
+/**
+ * @brief Loads orbital simulations from scenario files and orbital element catalogs
+ * @author Mariano Caceres Smoler
+ * @author Enzo Nicolas Rosa Fernandez
+ * @author Francisco Chiusaroli
+ */
+
+#ifndef SCENARIO_H
+#define SCENARIO_H
+
+#include "orbitalSim.h"
+
+OrbitalSim *loadOrbitalSimScenario(const char *fileName, double timeStep);
+
+#endif
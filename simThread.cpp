@@ -0,0 +1,323 @@
+/**
+ * @brief Runs the orbital simulation on its own thread
+ * @author Mariano Caceres Smoler
+ * @author Enzo Nicolas Rosa Fernandez
+ * @author Francisco Chiusaroli
+ *
+ * The simulation thread wakes up once per rendered frame, adds the elapsed wall
+ * clock time times the time warp to an accumulator, and runs as many fixed
+ * timesteps as the accumulator holds, but no more than fit in the frame budget
+ * given the measured cost of a step. Faster time warps mean more substeps, never
+ * a larger timestep. After every batch the positions are copied into a snapshot. Snapshots go through a
+ * lock-free triple buffer: the writer fills its back buffer and swaps it with
+ * the middle one, the reader swaps the middle one with its front buffer when a
+ * newer one is there. Neither side ever waits for the other.
+ *
+ * Sources:
+ * https://remis-thoughts.blogspot.com/2012/01/triple-buffering-as-concurrency_30.html ; Triple buffer
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#include "checkpoint.h"
+#include "configuration.h"
+#include "simThread.h"
+#include "trajectoryRecorder.h"
+
+#define SNAPSHOT_FRESH 4			// Set in middleSnapshot when the writer published a new one
+#define MAX_STEPS_PER_BATCH 4096	// Hard limit of substeps per frame
+#define FRAME_BUDGET_FRACTION 0.8	// Share of the frame period the substeps may take
+#define SMOOTHING_FACTOR 0.2		// Weight of the newest batch in the running averages
+
+typedef std::chrono::steady_clock sim_clock_t;
+
+struct SimThread
+{
+	OrbitalSim *sim;
+	std::thread thread;
+	std::atomic<bool> running;
+
+	// Triple buffer: back owned by the writer, front by the reader
+	SimSnapshot snapshots[3];
+	std::atomic<unsigned int> middleSnapshot;
+	unsigned int backSnapshot;
+	unsigned int frontSnapshot;
+
+	std::mutex commandLock;
+	std::deque<SimCommand> commands;
+
+	CheckpointWriter *checkpointWriter; // Writes the files while the simulation keeps stepping
+	TrajectoryRecorder *recorder;		// NULL while not recording
+
+	// Only touched by the simulation thread
+	int simType;
+	float timeWarp;		   // Requested simulated seconds per wall clock second
+	float framePeriod;	   // Wall clock seconds between batches
+	double stepCost;	   // Average wall clock seconds per step (0 until measured)
+	double timeAccumulator; // Simulated seconds owed to the simulation
+	float achievedWarp;
+	unsigned int lastSubSteps;
+};
+
+/**
+ * @brief Copies the current positions into the back snapshot and publishes it
+ */
+static void publishSnapshot(SimThread *simThread)
+{
+	OrbitalSim *sim = simThread->sim;
+	SimSnapshot *snapshot = &simThread->snapshots[simThread->backSnapshot];
+
+	snapshot->totalTime = sim->totalTime;
+	snapshot->timeWarp = simThread->achievedWarp;
+	snapshot->subSteps = simThread->lastSubSteps;
+	snapshot->diagnostics = getOrbitalSimDiagnostics(sim);
+
+	parallelFor(sim->jobSystem, 0, sim->bodyCount, 1 << 16, [=](unsigned int begin, unsigned int end)
+				{ getOrbitalSimPositions(sim, begin, end, snapshot->positionX, snapshot->positionY, snapshot->positionZ); });
+
+	unsigned int previous = simThread->middleSnapshot.exchange(simThread->backSnapshot | SNAPSHOT_FRESH);
+	simThread->backSnapshot = previous & ~SNAPSHOT_FRESH;
+}
+
+/**
+ * @brief Applies the commands sent since the last batch
+ */
+static void handleCommands(SimThread *simThread)
+{
+	std::lock_guard<std::mutex> guard(simThread->commandLock);
+
+	while (!simThread->commands.empty())
+	{
+		SimCommand command = simThread->commands.front();
+		simThread->commands.pop_front();
+
+		switch (command.type)
+		{
+		case SIM_COMMAND_SET_TYPE:
+			simThread->simType = (int)command.value;
+			simThread->stepCost = 0; // Each force model has its own cost
+			break;
+		case SIM_COMMAND_SET_TIME_WARP:
+			simThread->timeWarp = command.value;
+			break;
+		case SIM_COMMAND_SET_INTEGRATOR:
+			simThread->sim->integrator = (int)command.value;
+			simThread->stepCost = 0; // Higher orders take more force evaluations per step
+			break;
+		case SIM_COMMAND_SET_PRECISION:
+			setOrbitalSimPrecision(simThread->sim, (int)command.value);
+			simThread->stepCost = 0;
+			break;
+		case SIM_COMMAND_SET_DIAGNOSTICS:
+			setOrbitalSimDiagnostics(simThread->sim, (unsigned int)command.value);
+			simThread->stepCost = 0; // Measured steps skip the SIMD kernels
+			break;
+		case SIM_COMMAND_SAVE_CHECKPOINT:
+			// Skipped if the previous checkpoint is still being written
+			saveOrbitalSimCheckpoint(simThread->checkpointWriter, simThread->sim, CHECKPOINT_FILE);
+			break;
+		case SIM_COMMAND_SET_RECORDING:
+			if (simThread->recorder)
+				destroyTrajectoryRecorder(simThread->recorder);
+
+			simThread->recorder = (command.value > 0)
+									  ? constructTrajectoryRecorder(TRAJECTORY_FILE, simThread->sim, (unsigned int)command.value)
+									  : NULL;
+			break;
+		}
+	}
+}
+
+/**
+ * @brief Picks how many substeps to run this frame and runs them
+ *
+ * @param simThread The simulation thread
+ * @param elapsed Wall clock seconds since the previous batch
+ */
+static void runBatch(SimThread *simThread, double elapsed)
+{
+	OrbitalSim *sim = simThread->sim;
+
+	simThread->timeAccumulator += elapsed * simThread->timeWarp;
+
+	unsigned int due = (unsigned int)std::min(simThread->timeAccumulator / sim->timeStep, (double)MAX_STEPS_PER_BATCH);
+	unsigned int steps = std::min(due, 1U); // Cost not measured yet: a single probe step
+
+	if (simThread->stepCost > 0)
+	{
+		double affordable = FRAME_BUDGET_FRACTION * simThread->framePeriod / simThread->stepCost;
+
+		steps = std::min(due, (unsigned int)std::max(1.0, affordable));
+	}
+
+	sim_clock_t::time_point start = sim_clock_t::now();
+
+	for (unsigned int i = 0; i < steps; i++)
+	{
+		updateOrbitalSim(sim, simThread->simType);
+
+		if (simThread->recorder)
+			recordOrbitalSim(simThread->recorder, sim);
+	}
+
+	double cost = std::chrono::duration<double>(sim_clock_t::now() - start).count();
+
+	if (steps)
+	{
+		double newCost = cost / steps;
+
+		simThread->stepCost = (simThread->stepCost > 0)
+								  ? (1 - SMOOTHING_FACTOR) * simThread->stepCost + SMOOTHING_FACTOR * newCost
+								  : newCost;
+	}
+
+	simThread->timeAccumulator -= steps * (double)sim->timeStep;
+
+	// Over budget: forget the time we could not simulate instead of spiralling
+	if (steps < due)
+		simThread->timeAccumulator = std::min(simThread->timeAccumulator, (double)sim->timeStep);
+
+	double warp = (elapsed > 0) ? steps * sim->timeStep / elapsed : 0;
+
+	simThread->achievedWarp = (float)((1 - SMOOTHING_FACTOR) * simThread->achievedWarp + SMOOTHING_FACTOR * warp);
+	simThread->lastSubSteps = steps;
+}
+
+static void simulationLoop(SimThread *simThread)
+{
+	sim_clock_t::time_point last = sim_clock_t::now();
+	sim_clock_t::duration period = std::chrono::duration_cast<sim_clock_t::duration>(std::chrono::duration<double>(simThread->framePeriod));
+	sim_clock_t::time_point nextBatch = last + period;
+
+	while (simThread->running)
+	{
+		std::this_thread::sleep_until(nextBatch);
+
+		handleCommands(simThread);
+
+		sim_clock_t::time_point now = sim_clock_t::now();
+		double elapsed = std::chrono::duration<double>(now - last).count();
+
+		last = now;
+		nextBatch += period;
+
+		if (nextBatch < now)
+			nextBatch = now + period;
+
+		runBatch(simThread, elapsed);
+		publishSnapshot(simThread);
+	}
+}
+
+/**
+ * @brief Starts stepping a simulation on a separate thread
+ *
+ * @param sim The orbital simulation, owned by the thread until it is destroyed
+ * @param simType Initial logical_sim_type_t
+ * @param timeWarp Simulated seconds per wall clock second
+ * @param fps Rate at which snapshots are consumed
+ * @return The simulation thread
+ */
+SimThread *constructSimThread(OrbitalSim *sim, int simType, float timeWarp, int fps)
+{
+	SimThread *simThread = new SimThread();
+
+	simThread->sim = sim;
+	simThread->simType = simType;
+	simThread->timeWarp = timeWarp;
+	simThread->framePeriod = 1.0F / ((fps > 0) ? fps : 60);
+	simThread->stepCost = 0;
+	simThread->timeAccumulator = 0;
+	simThread->achievedWarp = 0;
+	simThread->lastSubSteps = 0;
+	simThread->checkpointWriter = constructCheckpointWriter();
+	simThread->recorder = NULL;
+
+	for (int i = 0; i < 3; i++)
+	{
+		SimSnapshot &snapshot = simThread->snapshots[i];
+
+		snapshot.bodyCount = sim->bodyCount;
+		snapshot.starSystemCount = sim->starSystemCount;
+		snapshot.positionX = new float[sim->bodyCount];
+		snapshot.positionY = new float[sim->bodyCount];
+		snapshot.positionZ = new float[sim->bodyCount];
+		snapshot.radius = sim->bodiesList.radius;
+		snapshot.color = sim->bodiesList.color;
+	}
+
+	simThread->frontSnapshot = 0;
+	simThread->middleSnapshot = 1;
+	simThread->backSnapshot = 2;
+
+	// The reader always has a valid snapshot, even before the first step
+	publishSnapshot(simThread);
+	acquireSimSnapshot(simThread);
+
+	simThread->running = true;
+	simThread->thread = std::thread(simulationLoop, simThread);
+
+	return simThread;
+}
+
+/**
+ * @brief Stops the simulation thread and releases its snapshots
+ * @param simThread The simulation thread
+ */
+void destroySimThread(SimThread *simThread)
+{
+	simThread->running = false;
+	simThread->thread.join();
+
+	destroyCheckpointWriter(simThread->checkpointWriter); // Finishes writing the last checkpoint
+
+	if (simThread->recorder)
+		destroyTrajectoryRecorder(simThread->recorder);
+
+	for (int i = 0; i < 3; i++)
+	{
+		delete[] simThread->snapshots[i].positionX;
+		delete[] simThread->snapshots[i].positionY;
+		delete[] simThread->snapshots[i].positionZ;
+	}
+
+	delete simThread;
+}
+
+/**
+ * @brief Queues a command for the simulation thread
+ *
+ * @param simThread The simulation thread
+ * @param command The command, applied before the next batch of steps
+ */
+void sendSimCommand(SimThread *simThread, SimCommand command)
+{
+	std::lock_guard<std::mutex> guard(simThread->commandLock);
+
+	simThread->commands.push_back(command);
+}
+
+/**
+ * @brief Gets the newest published snapshot
+ *
+ * Only one thread may read snapshots. The returned snapshot stays valid until
+ * the next call.
+ *
+ * @param simThread The simulation thread
+ * @return The snapshot
+ */
+const SimSnapshot *acquireSimSnapshot(SimThread *simThread)
+{
+	if (simThread->middleSnapshot.load() & SNAPSHOT_FRESH)
+	{
+		unsigned int previous = simThread->middleSnapshot.exchange(simThread->frontSnapshot);
+		simThread->frontSnapshot = previous & ~SNAPSHOT_FRESH;
+	}
+
+	return &simThread->snapshots[simThread->frontSnapshot];
+}
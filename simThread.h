@@ -0,0 +1,77 @@
+/**
+ * @brief Runs the orbital simulation on its own thread
+ * @author Mariano Caceres Smoler
+ * @author Enzo Nicolas Rosa Fernandez
+ * @author Francisco Chiusaroli
+ */
+
+#ifndef SIMTHREAD_H
+#define SIMTHREAD_H
+
+#include "orbitalSim.h"
+
+/**
+ * @brief Immutable copy of the simulation state, as published for rendering
+ */
+struct SimSnapshot
+{
+	unsigned int bodyCount;
+	unsigned int starSystemCount; // The first bodies, drawn as the sun and planets
+	double totalTime;
+	float timeWarp;		   // Simulated seconds per wall clock second actually achieved
+	unsigned int subSteps; // Steps run for this snapshot
+	OrbitalDiagnostics diagnostics; // Of the last step measured, if enabled
+	float *positionX;
+	float *positionY;
+	float *positionZ;
+
+	// Constant after construction, shared with the simulation
+	const float *radius;
+	const Color *color;
+};
+
+// Requests the simulation thread handles between steps
+enum sim_command_type_t
+{
+	SIM_COMMAND_SET_TYPE,	   // value: logical_sim_type_t
+	SIM_COMMAND_SET_TIME_WARP, // value: simulated seconds per wall clock second
+	SIM_COMMAND_SET_INTEGRATOR, // value: integrator_type_t
+	SIM_COMMAND_SET_PRECISION,	// value: precision_type_t
+	SIM_COMMAND_SET_DIAGNOSTICS, // value: steps between conservation measurements, 0 for none
+	SIM_COMMAND_SAVE_CHECKPOINT, // value: unused, saved to CHECKPOINT_FILE
+	SIM_COMMAND_SET_RECORDING,	 // value: steps between frames recorded to TRAJECTORY_FILE, 0 to stop
+};
+
+struct SimCommand
+{
+	sim_command_type_t type;
+	float value;
+};
+
+struct SimThread;
+
+SimThread *constructSimThread(OrbitalSim *sim, int simType, float timeWarp, int fps);
+
+void destroySimThread(SimThread *simThread);
+
+void sendSimCommand(SimThread *simThread, SimCommand command);
+
+const SimSnapshot *acquireSimSnapshot(SimThread *simThread);
+
+// Snapshot accessors
+inline Vector3 getSnapshotPosition(const SimSnapshot *snapshot, unsigned int i)
+{
+	return {snapshot->positionX[i], snapshot->positionY[i], snapshot->positionZ[i]};
+}
+
+inline float getSnapshotRadius(const SimSnapshot *snapshot, unsigned int i)
+{
+	return snapshot->radius[i];
+}
+
+inline Color getSnapshotColor(const SimSnapshot *snapshot, unsigned int i)
+{
+	return snapshot->color[i];
+}
+
+#endif
@@ -0,0 +1,286 @@
+/**
+ * @brief Records the trajectories of the bodies to disk, off the simulation thread
+ * @author Mariano Caceres Smoler
+ * @author Enzo Nicolas Rosa Fernandez
+ * @author Francisco Chiusaroli
+ *
+ * Every interval steps the simulation thread copies the positions into a slot
+ * of a single producer, single consumer ring buffer and moves on. It never
+ * waits: if the writer is behind and the ring is full, the frame is dropped and
+ * counted. A writer thread takes the frames out of the ring, quantizes them to
+ * a fixed number of meters and stores, column by column (every x, then every
+ * y, then every z), the difference against a prediction from the previous two
+ * frames. For bodies on smooth orbits the residuals are small, and they are
+ * written as zigzag varints, so most take one or two bytes instead of eight.
+ *
+ * The prediction starts over every keyInterval frames, so a reader can start
+ * decoding at any key frame. See trajectoryReplay.cpp for the decoder.
+ *
+ * Layout:
+ *   TrajectoryHeader
+ *   bodyCount x radius (float), bodyCount x color (Color), for replays
+ *   frames x (TrajectoryFrame, payloadSize bytes of residuals)
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "trajectoryRecorder.h"
+
+#define TRAJECTORY_QUANTUM 1000.0		  // Meters: far below the size of a body on screen
+#define TRAJECTORY_KEY_INTERVAL 64		  // Frames between key frames
+#define TRAJECTORY_RING_BYTES (64 << 20) // Memory for frames waiting to be written
+#define TRAJECTORY_RING_MAX_FRAMES 64
+#define TRAJECTORY_MAX_RESIDUAL_BYTES 10 // Of a 64 bit varint
+#define TRAJECTORY_WRITER_WAIT 10		  // Milliseconds the writer sleeps with nothing to write
+
+/**
+ * @brief A frame waiting in the ring buffer
+ */
+struct TrajectorySlot
+{
+	double time;
+	std::vector<double> positionX;
+	std::vector<double> positionY;
+	std::vector<double> positionZ;
+};
+
+struct TrajectoryRecorder
+{
+	FILE *file;
+	unsigned int bodyCount;
+	unsigned int interval;
+	unsigned int countdown; // Steps until the next frame, only touched by the simulation thread
+
+	// Ring buffer: head written by the simulation thread, tail by the writer
+	std::vector<TrajectorySlot> slots;
+	std::atomic<unsigned long long> head;
+	std::atomic<unsigned long long> tail;
+
+	std::thread writer;
+	std::atomic<bool> running;
+	std::mutex wakeLock; // Only the writer takes it
+	std::condition_variable wake;
+
+	// Only touched by the writer
+	std::vector<int64_t> previous;		 // Quantized positions of the last frame, x then y then z
+	std::vector<int64_t> beforePrevious; // And of the one before
+	std::vector<unsigned char> payload;
+	unsigned int keyDistance;
+
+	std::atomic<unsigned long long> framesDropped;
+	std::atomic<unsigned long long> bytesWritten;
+	std::atomic<bool> failed;
+};
+
+/**
+ * @brief Encodes and writes a frame, on the writer thread
+ */
+static void writeFrame(TrajectoryRecorder *recorder, const TrajectorySlot *slot)
+{
+	const std::vector<double> *columns[3] = {&slot->positionX, &slot->positionY, &slot->positionZ};
+	unsigned int bodyCount = recorder->bodyCount;
+	unsigned char *out = recorder->payload.data();
+	double scale = 1.0 / TRAJECTORY_QUANTUM;
+
+	for (int axis = 0; axis < 3; axis++)
+	{
+		const double *positions = columns[axis]->data();
+		int64_t *previous = &recorder->previous[axis * bodyCount];
+		int64_t *beforePrevious = &recorder->beforePrevious[axis * bodyCount];
+
+		for (unsigned int i = 0; i < bodyCount; i++)
+		{
+			int64_t quantized = (int64_t)floor(positions[i] * scale + 0.5);
+
+			out = putTrajectoryResidual(out, quantized - predictTrajectoryPosition(previous[i], beforePrevious[i], recorder->keyDistance));
+
+			beforePrevious[i] = previous[i];
+			previous[i] = quantized;
+		}
+	}
+
+	TrajectoryFrame frame = {};
+
+	frame.time = slot->time;
+	frame.keyFrame = (recorder->keyDistance == 0);
+	frame.payloadSize = (uint32_t)(out - recorder->payload.data());
+
+	recorder->keyDistance = (recorder->keyDistance + 1) % TRAJECTORY_KEY_INTERVAL;
+
+	if (fwrite(&frame, sizeof(frame), 1, recorder->file) != 1 ||
+		fwrite(recorder->payload.data(), 1, frame.payloadSize, recorder->file) != frame.payloadSize)
+		recorder->failed = true;
+	else
+		recorder->bytesWritten += sizeof(frame) + frame.payloadSize;
+}
+
+/**
+ * @brief Writes frames as they arrive, until stopped and drained
+ */
+static void writerLoop(TrajectoryRecorder *recorder)
+{
+	while (true)
+	{
+		// Read before checking for frames, so none published before stopping is lost
+		bool stopping = !recorder->running;
+
+		unsigned long long tail = recorder->tail.load(std::memory_order_relaxed);
+		unsigned long long head = recorder->head.load(std::memory_order_acquire);
+
+		if (tail == head)
+		{
+			if (stopping)
+				break;
+
+			// The simulation thread never takes the lock: a missed notification costs one wait
+			std::unique_lock<std::mutex> lock(recorder->wakeLock);
+			recorder->wake.wait_for(lock, std::chrono::milliseconds(TRAJECTORY_WRITER_WAIT));
+
+			continue;
+		}
+
+		if (!recorder->failed)
+			writeFrame(recorder, &recorder->slots[tail % recorder->slots.size()]);
+
+		recorder->tail.store(tail + 1, std::memory_order_release);
+	}
+}
+
+/**
+ * @brief Starts recording the trajectories of a simulation
+ *
+ * @param fileName The trajectory file, replaced if it exists
+ * @param sim The orbital simulation
+ * @param interval Steps between frames
+ * @return The trajectory recorder, or NULL if the file could not be created
+ */
+TrajectoryRecorder *constructTrajectoryRecorder(const char *fileName, const OrbitalSim *sim, unsigned int interval)
+{
+	FILE *file = fopen(fileName, "wb");
+
+	if (!file)
+		return NULL;
+
+	TrajectoryRecorder *recorder = new TrajectoryRecorder();
+	unsigned int bodyCount = sim->bodyCount;
+	size_t frameBytes = 3 * sizeof(double) * (size_t)bodyCount;
+	size_t slotCount = std::max((size_t)2, std::min((size_t)TRAJECTORY_RING_MAX_FRAMES, TRAJECTORY_RING_BYTES / frameBytes));
+
+	recorder->file = file;
+	recorder->bodyCount = bodyCount;
+	recorder->interval = std::max(interval, 1U);
+	recorder->countdown = 0; // Starts with the current state
+
+	recorder->slots.resize(slotCount);
+
+	for (TrajectorySlot &slot : recorder->slots)
+	{
+		slot.positionX.resize(bodyCount);
+		slot.positionY.resize(bodyCount);
+		slot.positionZ.resize(bodyCount);
+	}
+
+	recorder->head = 0;
+	recorder->tail = 0;
+	recorder->previous.assign(3 * (size_t)bodyCount, 0);
+	recorder->beforePrevious.assign(3 * (size_t)bodyCount, 0);
+	recorder->payload.resize(3 * (size_t)bodyCount * TRAJECTORY_MAX_RESIDUAL_BYTES);
+	recorder->keyDistance = 0;
+	recorder->framesDropped = 0;
+	recorder->failed = false;
+
+	TrajectoryHeader header = {};
+
+	header.magic = TRAJECTORY_MAGIC;
+	header.version = TRAJECTORY_VERSION;
+	header.bodyCount = bodyCount;
+	header.starSystemCount = sim->starSystemCount;
+	header.interval = recorder->interval;
+	header.keyInterval = TRAJECTORY_KEY_INTERVAL;
+	header.timeStep = sim->timeStep;
+	header.quantum = TRAJECTORY_QUANTUM;
+
+	recorder->failed = (fwrite(&header, sizeof(header), 1, file) != 1) ||
+					   (fwrite(sim->bodiesList.radius, sizeof(float), bodyCount, file) != bodyCount) ||
+					   (fwrite(sim->bodiesList.color, sizeof(Color), bodyCount, file) != bodyCount);
+	recorder->bytesWritten = sizeof(header) + (sizeof(float) + sizeof(Color)) * (unsigned long long)bodyCount;
+
+	recorder->running = true;
+	recorder->writer = std::thread(writerLoop, recorder);
+
+	return recorder;
+}
+
+/**
+ * @brief Writes the frames still in the ring buffer and closes the file
+ * @param recorder The trajectory recorder
+ * @return What was recorded
+ */
+TrajectoryStats destroyTrajectoryRecorder(TrajectoryRecorder *recorder)
+{
+	recorder->running = false;
+	recorder->wake.notify_one();
+	recorder->writer.join();
+
+	if (fclose(recorder->file))
+		recorder->failed = true;
+
+	TrajectoryStats stats;
+
+	stats.framesRecorded = recorder->head;
+	stats.framesDropped = recorder->framesDropped;
+	stats.bytesWritten = recorder->bytesWritten;
+	stats.failed = recorder->failed;
+
+	delete recorder;
+
+	return stats;
+}
+
+/**
+ * @brief Records the state of a simulation, if a frame is due
+ *
+ * Call after every step, from the thread that steps the simulation. Never
+ * waits for the writer.
+ *
+ * @param recorder The trajectory recorder
+ * @param sim The orbital simulation it was constructed with
+ */
+void recordOrbitalSim(TrajectoryRecorder *recorder, const OrbitalSim *sim)
+{
+	if (recorder->countdown)
+	{
+		recorder->countdown--;
+
+		return;
+	}
+
+	recorder->countdown = recorder->interval - 1;
+
+	unsigned long long head = recorder->head.load(std::memory_order_relaxed);
+
+	if (head - recorder->tail.load(std::memory_order_acquire) == recorder->slots.size())
+	{
+		recorder->framesDropped++;
+
+		return;
+	}
+
+	TrajectorySlot *slot = &recorder->slots[head % recorder->slots.size()];
+
+	slot->time = sim->totalTime;
+
+	parallelFor(sim->jobSystem, 0, recorder->bodyCount, 1 << 16, [=](unsigned int begin, unsigned int end)
+				{ getOrbitalSimPositions(sim, begin, end, slot->positionX.data(), slot->positionY.data(), slot->positionZ.data()); });
+
+	recorder->head.store(head + 1, std::memory_order_release);
+	recorder->wake.notify_one();
+}
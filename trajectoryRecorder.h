@@ -0,0 +1,123 @@
+/**
+ * @brief Records the trajectories of the bodies to disk, off the simulation thread
+ * @author Mariano Caceres Smoler
+ * @author Enzo Nicolas Rosa Fernandez
+ * @author Francisco Chiusaroli
+ */
+
+#ifndef TRAJECTORYRECORDER_H
+#define TRAJECTORYRECORDER_H
+
+#include <cstdint>
+
+#include "orbitalSim.h"
+
+#define TRAJECTORY_MAGIC 0x5254534F // "OSTR" in little endian, so other byte orders are rejected
+#define TRAJECTORY_VERSION 4
+
+/**
+ * @brief First bytes of a trajectory file, in native byte order
+ */
+struct TrajectoryHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t bodyCount;
+	uint32_t starSystemCount; // The first bodies, drawn as the sun and planets
+	uint32_t interval;		  // Steps between frames
+	uint32_t keyInterval;	  // Frames between key frames
+	double timeStep;
+	double quantum; // Meters per unit of the stored positions
+};
+
+/**
+ * @brief Precedes the residuals of each frame
+ */
+struct TrajectoryFrame
+{
+	double time;		  // Simulated seconds
+	uint32_t keyFrame;	  // Whether the prediction starts over at this frame
+	uint32_t payloadSize; // Bytes of residuals that follow
+};
+
+struct TrajectoryStats
+{
+	unsigned long long framesRecorded; // Written, or waiting to be
+	unsigned long long framesDropped;  // Found the ring buffer full
+	unsigned long long bytesWritten;
+	bool failed; // Whether a write to the file failed
+};
+
+struct TrajectoryRecorder;
+
+TrajectoryRecorder *constructTrajectoryRecorder(const char *fileName, const OrbitalSim *sim, unsigned int interval);
+
+TrajectoryStats destroyTrajectoryRecorder(TrajectoryRecorder *recorder);
+
+void recordOrbitalSim(TrajectoryRecorder *recorder, const OrbitalSim *sim);
+
+/**
+ * @brief Appends a residual as a zigzag varint
+ * @return Past the last byte written
+ */
+inline unsigned char *putTrajectoryResidual(unsigned char *out, int64_t residual)
+{
+	// Zigzag: small magnitudes of either sign become small unsigned values
+	uint64_t value = ((uint64_t)residual << 1) ^ (uint64_t)(residual >> 63);
+
+	while (value >= 0x80)
+	{
+		*out++ = (unsigned char)(value | 0x80);
+		value >>= 7;
+	}
+
+	*out++ = (unsigned char)value;
+
+	return out;
+}
+
+/**
+ * @brief Reads a zigzag varint residual
+ * @return Past the last byte read, or NULL if the payload ends first
+ */
+inline const unsigned char *getTrajectoryResidual(const unsigned char *in, const unsigned char *end, int64_t *residual)
+{
+	uint64_t value = 0;
+
+	for (int shift = 0; in < end && shift < 64; shift += 7)
+	{
+		unsigned char byte = *in++;
+
+		value |= (uint64_t)(byte & 0x7F) << shift;
+
+		if (!(byte & 0x80))
+		{
+			*residual = (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+
+			return in;
+		}
+	}
+
+	return NULL;
+}
+
+/**
+ * @brief Predicts a quantized position from the ones of the previous frames
+ *
+ * @param previous Of the previous frame
+ * @param beforePrevious Of the frame before it
+ * @param keyDistance Frames since the last key frame, 0 for a key frame
+ * @return The prediction the residual is taken against
+ */
+inline int64_t predictTrajectoryPosition(int64_t previous, int64_t beforePrevious, unsigned int keyDistance)
+{
+	if (keyDistance == 0)
+		return 0;
+
+	if (keyDistance == 1)
+		return previous;
+
+	return 2 * previous - beforePrevious; // Constant velocity
+}
+
+#endif
@@ -0,0 +1,356 @@
+/**
+ * @brief Plays recorded trajectories back as simulation snapshots, without physics
+ * @author Mariano Caceres Smoler
+ * @author Enzo Nicolas Rosa Fernandez
+ * @author Francisco Chiusaroli
+ *
+ * The trajectory file (see trajectoryRecorder.cpp) is mapped, and opening it
+ * only walks the frame headers to index where every frame starts and which key
+ * frame it depends on. Frames are decoded on demand: moving forward decodes
+ * just the new frame, seeking anywhere else decodes from the key frame before
+ * it, at most keyInterval frames. The last two decoded frames are kept, so
+ * playing back at any speed mostly reuses them.
+ *
+ * A snapshot at any time between the first and the last frame interpolates
+ * linearly between the frames around it. Radii and colors are read straight
+ * from the mapping.
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "mappedFile.h"
+#include "trajectoryRecorder.h"
+#include "trajectoryReplay.h"
+
+#define REPLAY_BODIES_PER_JOB (1 << 14)
+
+/**
+ * @brief Where a frame is in the file
+ */
+struct TrajectoryFrameIndex
+{
+	double time;
+	size_t payloadOffset;
+	unsigned int payloadSize;
+	unsigned int keyFrame; // Index of the key frame it is predicted from
+};
+
+/**
+ * @brief A decoded frame
+ */
+struct TrajectoryFrameSlot
+{
+	int frame; // -1 while empty
+	unsigned long long lastUse;
+	std::vector<double> positions; // Every x, then every y, then every z
+};
+
+struct TrajectoryReplay
+{
+	MappedFile *mappedFile;
+	TrajectoryHeader header;
+	std::vector<TrajectoryFrameIndex> frames;
+
+	// Decoder state: quantized positions of decodedFrame and of the frame before it
+	int decodedFrame; // -1 if none
+	std::vector<int64_t> previous;
+	std::vector<int64_t> beforePrevious;
+
+	TrajectoryFrameSlot slots[2];
+	unsigned long long useCount;
+
+	SimSnapshot snapshot;
+};
+
+/**
+ * @brief Maps a trajectory file and indexes its frames
+ *
+ * A file cut in the middle of a frame, as left by a crash while recording,
+ * plays back up to its last whole frame.
+ *
+ * @param fileName The trajectory file
+ * @return The trajectory replay, or NULL if the file is missing, has no frames or is from another version
+ */
+TrajectoryReplay *constructTrajectoryReplay(const char *fileName)
+{
+	MappedFile *mappedFile = constructMappedFile(fileName);
+
+	if (!mappedFile)
+		return NULL;
+
+	TrajectoryHeader header;
+
+	if (mappedFile->size < sizeof(header))
+	{
+		destroyMappedFile(mappedFile);
+
+		return NULL;
+	}
+
+	memcpy(&header, mappedFile->data, sizeof(header));
+
+	size_t bodiesOffset = sizeof(header);
+	size_t framesOffset = bodiesOffset + (sizeof(float) + sizeof(Color)) * (size_t)header.bodyCount;
+
+	if (header.magic != TRAJECTORY_MAGIC || header.version != TRAJECTORY_VERSION ||
+		!header.bodyCount || header.starSystemCount > header.bodyCount || !(header.quantum > 0) || framesOffset > mappedFile->size)
+	{
+		destroyMappedFile(mappedFile);
+
+		return NULL;
+	}
+
+	TrajectoryReplay *replay = new TrajectoryReplay();
+
+	replay->mappedFile = mappedFile;
+	replay->header = header;
+
+	size_t offset = framesOffset;
+	unsigned int keyFrame = 0;
+
+	while (offset + sizeof(TrajectoryFrame) <= mappedFile->size)
+	{
+		TrajectoryFrame frame;
+
+		memcpy(&frame, mappedFile->data + offset, sizeof(frame));
+		offset += sizeof(frame);
+
+		if (frame.payloadSize > mappedFile->size - offset)
+			break;
+
+		if (frame.keyFrame)
+			keyFrame = (unsigned int)replay->frames.size();
+		else if (replay->frames.empty())
+			break; // The first frame is always a key frame
+
+		replay->frames.push_back({frame.time, offset, frame.payloadSize, keyFrame});
+		offset += frame.payloadSize;
+	}
+
+	if (replay->frames.empty())
+	{
+		destroyTrajectoryReplay(replay);
+
+		return NULL;
+	}
+
+	size_t valueCount = 3 * (size_t)header.bodyCount;
+
+	replay->decodedFrame = -1;
+	replay->previous.resize(valueCount);
+	replay->beforePrevious.resize(valueCount);
+	replay->useCount = 0;
+
+	for (TrajectoryFrameSlot &slot : replay->slots)
+	{
+		slot.frame = -1;
+		slot.lastUse = 0;
+		slot.positions.resize(valueCount);
+	}
+
+	SimSnapshot &snapshot = replay->snapshot;
+
+	snapshot.bodyCount = header.bodyCount;
+	snapshot.starSystemCount = header.starSystemCount;
+	snapshot.totalTime = replay->frames[0].time;
+	snapshot.timeWarp = 0;
+	snapshot.subSteps = 0;
+	snapshot.diagnostics = {};
+	snapshot.positionX = new float[header.bodyCount];
+	snapshot.positionY = new float[header.bodyCount];
+	snapshot.positionZ = new float[header.bodyCount];
+	snapshot.radius = (const float *)(mappedFile->data + bodiesOffset);
+	snapshot.color = (const Color *)(mappedFile->data + bodiesOffset + sizeof(float) * header.bodyCount);
+
+	return replay;
+}
+
+/**
+ * @brief Unmaps the trajectory file and releases the decoded frames
+ * @param replay The trajectory replay
+ */
+void destroyTrajectoryReplay(TrajectoryReplay *replay)
+{
+	delete[] replay->snapshot.positionX;
+	delete[] replay->snapshot.positionY;
+	delete[] replay->snapshot.positionZ;
+
+	destroyMappedFile(replay->mappedFile);
+
+	delete replay;
+}
+
+/**
+ * @brief Gets the number of bodies recorded
+ * @param replay The trajectory replay
+ * @return The number of bodies
+ */
+unsigned int getTrajectoryReplayBodyCount(const TrajectoryReplay *replay)
+{
+	return replay->header.bodyCount;
+}
+
+/**
+ * @brief Gets the number of frames recorded
+ * @param replay The trajectory replay
+ * @return The number of frames, at least one
+ */
+unsigned int getTrajectoryReplayFrameCount(const TrajectoryReplay *replay)
+{
+	return (unsigned int)replay->frames.size();
+}
+
+/**
+ * @brief Gets the simulated time of a frame
+ *
+ * @param replay The trajectory replay
+ * @param frame Index of the frame
+ * @return Simulated seconds
+ */
+double getTrajectoryReplayFrameTime(const TrajectoryReplay *replay, unsigned int frame)
+{
+	return replay->frames[frame].time;
+}
+
+/**
+ * @brief Advances the decoder by one frame
+ *
+ * @param replay The trajectory replay
+ * @param frame Index of the frame, decodedFrame + 1 or a key frame
+ * @param positions Filled in with the positions in meters, if not NULL
+ * @return Whether the frame could be decoded
+ */
+static bool decodeNextFrame(TrajectoryReplay *replay, unsigned int frame, double *positions)
+{
+	const TrajectoryFrameIndex &index = replay->frames[frame];
+	const unsigned char *in = replay->mappedFile->data + index.payloadOffset;
+	const unsigned char *end = in + index.payloadSize;
+	unsigned int keyDistance = frame - index.keyFrame;
+	size_t valueCount = replay->previous.size();
+	int64_t *previous = replay->previous.data();
+	int64_t *beforePrevious = replay->beforePrevious.data();
+
+	for (size_t i = 0; i < valueCount; i++)
+	{
+		int64_t residual;
+
+		in = getTrajectoryResidual(in, end, &residual);
+
+		if (!in)
+		{
+			replay->decodedFrame = -1;
+
+			return false;
+		}
+
+		int64_t quantized = predictTrajectoryPosition(previous[i], beforePrevious[i], keyDistance) + residual;
+
+		beforePrevious[i] = previous[i];
+		previous[i] = quantized;
+
+		if (positions)
+			positions[i] = quantized * replay->header.quantum;
+	}
+
+	replay->decodedFrame = (int)frame;
+
+	return true;
+}
+
+/**
+ * @brief Decodes the positions of a frame
+ *
+ * @param replay The trajectory replay
+ * @param frame Index of the frame
+ * @return Every x, then every y, then every z, in meters; valid until the
+ *         frame after the next is decoded. NULL if the frame is damaged.
+ */
+const double *decodeTrajectoryReplayFrame(TrajectoryReplay *replay, unsigned int frame)
+{
+	TrajectoryFrameSlot *slot = &replay->slots[0];
+
+	for (TrajectoryFrameSlot &candidate : replay->slots)
+	{
+		if (candidate.frame == (int)frame)
+		{
+			candidate.lastUse = ++replay->useCount;
+
+			return candidate.positions.data();
+		}
+
+		if (candidate.lastUse < slot->lastUse)
+			slot = &candidate;
+	}
+
+	// Continue from the decoded frame if it is on the way, otherwise start over at the key frame
+	unsigned int keyFrame = replay->frames[frame].keyFrame;
+	unsigned int next = (replay->decodedFrame >= (int)keyFrame && replay->decodedFrame < (int)frame)
+							? replay->decodedFrame + 1
+							: keyFrame;
+
+	slot->frame = -1;
+
+	for (; next <= frame; next++)
+	{
+		if (!decodeNextFrame(replay, next, (next == frame) ? slot->positions.data() : NULL))
+			return NULL;
+	}
+
+	slot->frame = (int)frame;
+	slot->lastUse = ++replay->useCount;
+
+	return slot->positions.data();
+}
+
+/**
+ * @brief Gets the bodies at any time of the recording
+ *
+ * @param replay The trajectory replay
+ * @param time Simulated seconds, clamped to the times of the first and last frames
+ * @return The snapshot, interpolated between the frames around the time; valid
+ *         until the next call. If a frame is damaged, the previous snapshot.
+ */
+const SimSnapshot *seekTrajectoryReplay(TrajectoryReplay *replay, double time)
+{
+	const std::vector<TrajectoryFrameIndex> &frames = replay->frames;
+
+	time = std::max(frames.front().time, std::min(frames.back().time, time));
+
+	// Last frame at or before the time
+	unsigned int frame = (unsigned int)(std::upper_bound(frames.begin(), frames.end(), time,
+														 [](double t, const TrajectoryFrameIndex &index)
+														 { return t < index.time; }) -
+										frames.begin()) -
+						 1;
+	unsigned int nextFrame = std::min(frame + 1, (unsigned int)frames.size() - 1);
+
+	const double *from = decodeTrajectoryReplayFrame(replay, frame);
+	const double *to = decodeTrajectoryReplayFrame(replay, nextFrame);
+
+	if (!from || !to)
+		return &replay->snapshot;
+
+	double span = frames[nextFrame].time - frames[frame].time;
+	double alpha = (span > 0) ? (time - frames[frame].time) / span : 0;
+	unsigned int bodyCount = replay->header.bodyCount;
+	SimSnapshot *snapshot = &replay->snapshot;
+
+	parallelFor(getJobSystem(), 0, bodyCount, REPLAY_BODIES_PER_JOB, [=](unsigned int begin, unsigned int end)
+				{
+					const double *fromX = from, *fromY = from + bodyCount, *fromZ = from + 2 * (size_t)bodyCount;
+					const double *toX = to, *toY = to + bodyCount, *toZ = to + 2 * (size_t)bodyCount;
+
+					for (unsigned int i = begin; i < end; i++)
+					{
+						snapshot->positionX[i] = (float)(fromX[i] + alpha * (toX[i] - fromX[i]));
+						snapshot->positionY[i] = (float)(fromY[i] + alpha * (toY[i] - fromY[i]));
+						snapshot->positionZ[i] = (float)(fromZ[i] + alpha * (toZ[i] - fromZ[i]));
+					}
+				});
+
+	snapshot->totalTime = time;
+
+	return snapshot;
+}
@@ -0,0 +1,29 @@
+/**
+ * @brief Plays recorded trajectories back as simulation snapshots, without physics
+ * @author Mariano Caceres Smoler
+ * @author Enzo Nicolas Rosa Fernandez
+ * @author Francisco Chiusaroli
+ */
+
+#ifndef TRAJECTORYREPLAY_H
+#define TRAJECTORYREPLAY_H
+
+#include "simThread.h"
+
+struct TrajectoryReplay;
+
+TrajectoryReplay *constructTrajectoryReplay(const char *fileName);
+
+void destroyTrajectoryReplay(TrajectoryReplay *replay);
+
+unsigned int getTrajectoryReplayBodyCount(const TrajectoryReplay *replay);
+
+unsigned int getTrajectoryReplayFrameCount(const TrajectoryReplay *replay);
+
+double getTrajectoryReplayFrameTime(const TrajectoryReplay *replay, unsigned int frame);
+
+const double *decodeTrajectoryReplayFrame(TrajectoryReplay *replay, unsigned int frame);
+
+const SimSnapshot *seekTrajectoryReplay(TrajectoryReplay *replay, double time);
+
+#endif
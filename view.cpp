@@ -9,12 +9,15 @@
  * https://chatgpt.com/share/68be4269-8e2c-800e-aa0f-0acf02e21886 ; How to use quaternions to rotate models
  */
 
+#include <algorithm>
+#include <cstddef>
 #include <iostream>
 #include <string>
 #include <time.h>
 
 #include "configuration.h"
-#include "orbitalSim.h"
+#include "rlgl.h"
+#include "simThread.h"
 #include "view.h"
 
 // Macros and constant definitions
@@ -23,10 +26,25 @@
 #define CAMERA_SHORT_RANGE 50
 #define CAMERA_MEDIUM_RANGE 250
 #define ADJUSTMENT_FACTOR 5E-12F
+#define CAMERA_FAR_PLANE 1000.0F // rlgl's far clipping distance
+#define CULL_MARGIN 1.0F // Bounding radius assumed for an asteroid mesh
+#define RENDER_BODIES_PER_JOB 2048 // Asteroids classified by each job
+#define POINT_SIZE 500.0F // Pixels a far asteroid takes at a distance of one unit
 
-static void renderStandardSimulation(View *view, OrbitalSim *sim, resource_t *Master_resource, bool ship_enable);
-static void renderPepsiSimulation(View *view, OrbitalSim *sim, resource_t *Master_resource, bool ship_enable);
-static void renderSpaceShip(View *view, OrbitalSim *sim, resource_t *Master_resource);
+/**
+ * Planes bounding the camera view: a point p is inside when
+ * dot(normal, p) + offset >= 0 for every plane
+ */
+struct ViewFrustum
+{
+	Vector3 normal[6];
+	float offset[6];
+};
+
+static void renderStandardSimulation(View *view, const SimSnapshot *snapshot, resource_t *Master_resource, bool ship_enable);
+static void renderPepsiSimulation(View *view, const SimSnapshot *snapshot, resource_t *Master_resource, bool ship_enable);
+static void renderSpaceShip(View *view, const SimSnapshot *snapshot, resource_t *Master_resource);
+static void renderAsteroids(View *view, const SimSnapshot *snapshot, resource_t *Master_resource, unsigned int firstAsteroid);
 
 /**
  * @brief Converts a timestamp (number of seconds since 1/1/2022)
@@ -35,7 +53,7 @@ static void renderSpaceShip(View *view, OrbitalSim *sim, resource_t *Master_reso
  * @param timestamp the timestamp
  * @return The ISO date (a raylib string)
  */
-const char *getISODate(float timestamp)
+const char *getISODate(double timestamp)
 {
 	// Timestamp epoch: 1/1/2022
 	struct tm unichEpochTM = {0, 0, 0, 1, 0, 122};
@@ -59,6 +77,12 @@ View *constructView(int *fps, monitor_t *monitor)
 {
 	View *view = new View();
 
+	view->jobSystem = getJobSystem();
+	view->pointsVao = 0;
+	view->pointsCornerVbo = 0;
+	view->pointsVbo = 0;
+	view->pointsCapacity = 0;
+
 	InitWindow(0, 0, "EDA Orbital Simulation");
 	ToggleFullscreen();
 
@@ -96,6 +120,13 @@ void setup_3D_view(View *view)
  */
 void destroyView(View *view)
 {
+	if (view->pointsVao)
+	{
+		rlUnloadVertexBuffer(view->pointsVbo);
+		rlUnloadVertexBuffer(view->pointsCornerVbo);
+		rlUnloadVertexArray(view->pointsVao);
+	}
+
 	CloseWindow();
 
 	delete view;
@@ -115,9 +146,9 @@ bool isViewRendering(View *view)
  * @brief Renders an orbital simulation
  *
  * @param view The view
- * @param sim The orbital sim
+ * @param snapshot Snapshot of the orbital sim
  */
-void renderView(View *view, OrbitalSim *sim, resource_t *Master_resource, int simType, bool camera_movement, bool ship_enable)
+void renderView(View *view, const SimSnapshot *snapshot, resource_t *Master_resource, int simType, bool camera_movement, bool ship_enable)
 {
 
 	if (camera_movement)
@@ -125,11 +156,11 @@ void renderView(View *view, OrbitalSim *sim, resource_t *Master_resource, int si
 
 	if (simType == PLANETS_SIMULATION)
 	{
-		renderStandardSimulation(view, sim, Master_resource, ship_enable);
+		renderStandardSimulation(view, snapshot, Master_resource, ship_enable);
 	}
 	else if (simType == PEPSI_SIMULATION)
 	{
-		renderPepsiSimulation(view, sim, Master_resource, ship_enable);
+		renderPepsiSimulation(view, snapshot, Master_resource, ship_enable);
 	}
 }
 
@@ -137,11 +168,11 @@ void renderView(View *view, OrbitalSim *sim, resource_t *Master_resource, int si
  * @brief Renders the standard simulation, with planets
  *
  * @param view The view
- * @param sim The orbital sim
+ * @param snapshot Snapshot of the orbital sim
  * @param Master_resource Pointer to the struct containing all graphical data
  * @param ship_enable Flag to enable space ship
  */
-static void renderStandardSimulation(View *view, OrbitalSim *sim, resource_t *Master_resource, bool ship_enable)
+static void renderStandardSimulation(View *view, const SimSnapshot *snapshot, resource_t *Master_resource, bool ship_enable)
 {
 
 	BeginTextureMode(Master_resource->Texture_Buffer1);
@@ -150,75 +181,49 @@ static void renderStandardSimulation(View *view, OrbitalSim *sim, resource_t *Ma
 
 	static float rotation;
 
-	for (int i = 0; i < sim->bodyCount; i++)
-	{
-
-		Vector3 scaledBodyPos = {5E-10F * (sim->bodiesList[i].position.x), 5E-10F * (sim->bodiesList[i].position.y), 5E-10F * (sim->bodiesList[i].position.z)};
+	unsigned int planetCount = std::min((unsigned int)Master_resource->Models_Solar_System.size(), snapshot->starSystemCount);
 
-		Vector3 &cameraPos = view->camera.position;
+	for (unsigned int i = 0; i < planetCount; i++)
+	{
+		Vector3 scaledBodyPos = getSnapshotPosition(snapshot, i) * 5E-10F;
 
-		if (i < Master_resource->Models_Solar_System.size())
+		switch (i)
 		{
-			switch (i)
-			{
-			case 0:
-				DrawModelEx(Master_resource->Model_Sun, scaledBodyPos - (Vector3){0.0, 15.0, 0.0}, {0, 1, 0}, 0, {15.0F, 15.0F, 15.0F}, GOLD);
-				break;
-			case 1:
-				DrawModelEx(Master_resource->Model_Mercury, scaledBodyPos, {0, 1, 0}, 0, {1.0F, 1.0F, 1.0F}, WHITE);
-				break;
-			case 2:
-				DrawModelEx(Master_resource->Model_Venus, scaledBodyPos, {0, 1, 0}, 0, {2.0F, 2.0F, 2.0F}, WHITE);
-				break;
-			case 3:
-				DrawModelEx(Master_resource->Model_Earth, scaledBodyPos, {0, 1, 0}, 0, {2.0F, 2.0F, 2.0F}, WHITE);
-				break;
-			case 4:
-				DrawModelEx(Master_resource->Model_Mars, scaledBodyPos, {0, 1, 0}, 0, {1.0F, 1.0F, 1.0F}, WHITE);
-				break;
-			case 5:
-				DrawModelEx(Master_resource->Model_Jupiter, scaledBodyPos, {0, 1, 0}, 0, {5.0F, 5.0F, 5.0F}, WHITE);
-				break;
-			case 6:
-				DrawModelEx(Master_resource->Model_Saturn, scaledBodyPos, {0, 1, 0}, 0, {5.0F, 5.0F, 5.0F}, WHITE);
-				break;
-			case 7:
-				DrawModelEx(Master_resource->Model_Uranus, scaledBodyPos, {0, 1, 0}, 0, {4.0F, 4.0F, 4.0F}, WHITE);
-				break;
-			case 8:
-				DrawModelEx(Master_resource->Model_Neptune, scaledBodyPos, {0, 1, 0}, 0, {3.0F, 3.0F, 3.0F}, WHITE);
-				break;
-			}
+		case 0:
+			DrawModelEx(Master_resource->Model_Sun, scaledBodyPos - (Vector3){0.0, 15.0, 0.0}, {0, 1, 0}, 0, {15.0F, 15.0F, 15.0F}, GOLD);
+			break;
+		case 1:
+			DrawModelEx(Master_resource->Model_Mercury, scaledBodyPos, {0, 1, 0}, 0, {1.0F, 1.0F, 1.0F}, WHITE);
+			break;
+		case 2:
+			DrawModelEx(Master_resource->Model_Venus, scaledBodyPos, {0, 1, 0}, 0, {2.0F, 2.0F, 2.0F}, WHITE);
+			break;
+		case 3:
+			DrawModelEx(Master_resource->Model_Earth, scaledBodyPos, {0, 1, 0}, 0, {2.0F, 2.0F, 2.0F}, WHITE);
+			break;
+		case 4:
+			DrawModelEx(Master_resource->Model_Mars, scaledBodyPos, {0, 1, 0}, 0, {1.0F, 1.0F, 1.0F}, WHITE);
+			break;
+		case 5:
+			DrawModelEx(Master_resource->Model_Jupiter, scaledBodyPos, {0, 1, 0}, 0, {5.0F, 5.0F, 5.0F}, WHITE);
+			break;
+		case 6:
+			DrawModelEx(Master_resource->Model_Saturn, scaledBodyPos, {0, 1, 0}, 0, {5.0F, 5.0F, 5.0F}, WHITE);
+			break;
+		case 7:
+			DrawModelEx(Master_resource->Model_Uranus, scaledBodyPos, {0, 1, 0}, 0, {4.0F, 4.0F, 4.0F}, WHITE);
+			break;
+		case 8:
+			DrawModelEx(Master_resource->Model_Neptune, scaledBodyPos, {0, 1, 0}, 0, {3.0F, 3.0F, 3.0F}, WHITE);
+			break;
 		}
-		else
-		{
-			Vector3 diff = {
-				scaledBodyPos.x - cameraPos.x,
-				scaledBodyPos.y - cameraPos.y,
-				scaledBodyPos.z - cameraPos.z};
-
-			double dist = sqrt(diff.x * diff.x + diff.y * diff.y + diff.z * diff.z);
+	}
 
-			if (dist < CAMERA_SHORT_RANGE)
-			{
-				DrawModelEx(Master_resource->Models_Asteroids[i % 4], scaledBodyPos, {0, 1, 0}, 0, {0.4F, 0.4F, 0.4F}, WHITE);
-			}
-			else if (dist < CAMERA_MEDIUM_RANGE)
-			{
-				int rings = 2;
-				int slices = 3;
+	renderAsteroids(view, snapshot, Master_resource, planetCount);
 
-				DrawSphereEx(scaledBodyPos, 0.03F * cbrt(sim->bodiesList[i].radius), rings, slices, sim->bodiesList[i].color);
-			}
-			else
-			{
-				DrawPoint3D(scaledBodyPos, sim->bodiesList[i].color);
-			}
-		}
-	}
 	if (ship_enable)
 	{
-		renderSpaceShip(view, sim, Master_resource);
+		renderSpaceShip(view, snapshot, Master_resource);
 	}
 
 	EndMode3D();
@@ -230,11 +235,11 @@ static void renderStandardSimulation(View *view, OrbitalSim *sim, resource_t *Ma
  * @brief Renders the special simulation, with Pepsi cans B)
  *
  * @param view The view
- * @param sim The orbital sim
+ * @param snapshot Snapshot of the orbital sim
  * @param Master_resource Pointer to the struct containing all graphical data
  * @param ship_enable Flag to enable space ship
  */
-static void renderPepsiSimulation(View *view, OrbitalSim *sim, resource_t *Master_resource, bool ship_enable)
+static void renderPepsiSimulation(View *view, const SimSnapshot *snapshot, resource_t *Master_resource, bool ship_enable)
 {
 
 	BeginTextureMode(Master_resource->Texture_Buffer1);
@@ -244,59 +249,444 @@ static void renderPepsiSimulation(View *view, OrbitalSim *sim, resource_t *Maste
 
 	static float rotation;
 
-	DrawModelEx(Master_resource->Model_PepsiCan, {5E-10F * (sim->bodiesList[0].position.x), 5E-10F * (sim->bodiesList[0].position.y) - 15.0F, 5E-10F * (sim->bodiesList[0].position.z)}, {0, 1, 0}, -100 + rotation, {0.5F, 0.5F, 0.5F}, WHITE);
+	DrawModelEx(Master_resource->Model_PepsiCan, getSnapshotPosition(snapshot, 0) * 5E-10F - (Vector3){0.0, 15.0, 0.0}, {0, 1, 0}, -100 + rotation, {0.5F, 0.5F, 0.5F}, WHITE);
+
+	unsigned int canCount = std::min(9U, snapshot->starSystemCount);
+
+	for (unsigned int i = 1; i < canCount; i++)
+	{
+		DrawModelEx(Master_resource->Model_PepsiCan, getSnapshotPosition(snapshot, i) * 5E-10F, {0, 1, 0}, -100 + rotation, {0.1F, 0.1F, 0.1F}, WHITE);
+	}
+
+	renderAsteroids(view, snapshot, Master_resource, canCount);
+
+	rotation += 0.5;
+
+	if (ship_enable)
+	{
+		renderSpaceShip(view, snapshot, Master_resource);
+	}
+	EndMode3D();
+
+	EndTextureMode();
+}
+
+/**
+ * @brief Builds the model matrix of an instance: uniform scale, then translation
+ *
+ * @param position Position of the instance
+ * @param scale Scale of the instance
+ * @return The model matrix
+ */
+static Matrix getInstanceTransform(Vector3 position, float scale)
+{
+	Matrix transform = {};
+
+	transform.m0 = scale;
+	transform.m5 = scale;
+	transform.m10 = scale;
+	transform.m12 = position.x;
+	transform.m13 = position.y;
+	transform.m14 = position.z;
+	transform.m15 = 1.0F;
+
+	return transform;
+}
+
+/**
+ * @brief Compares two colors, alpha included
+ */
+static bool isSameColor(Color a, Color b)
+{
+	return a.r == b.r && a.g == b.g && a.b == b.b && a.a == b.a;
+}
 
-	for (int i = 1; i < 9; i++)
+/**
+ * @brief Gets the batch of a color, adding it if it is the first one
+ *
+ * @param batches The batches
+ * @param color The color
+ * @return The batch
+ */
+static InstanceBatch *getColorBatch(std::vector<InstanceBatch> &batches, Color color)
+{
+	for (size_t i = 0; i < batches.size(); i++)
 	{
-		DrawModelEx(Master_resource->Model_PepsiCan, {5E-10F * (sim->bodiesList[i].position.x), 5E-10F * (sim->bodiesList[i].position.y), 5E-10F * (sim->bodiesList[i].position.z)}, {0, 1, 0}, -100 + rotation, {0.1F, 0.1F, 0.1F}, WHITE);
+		if (isSameColor(batches[i].color, color))
+			return &batches[i];
 	}
-	for (int i = 9; i < sim->bodyCount; i++)
+
+	batches.push_back({color, std::vector<Matrix>()});
+
+	return &batches.back();
+}
+
+/**
+ * @brief Draws every mesh of a model once per transform, one draw call per mesh
+ *
+ * @param model The model, with materials using the instancing shader
+ * @param transforms Model matrices of the instances
+ */
+static void drawModelInstanced(const Model &model, const std::vector<Matrix> &transforms)
+{
+	if (transforms.empty())
+		return;
+
+	for (int i = 0; i < model.meshCount; i++)
+		DrawMeshInstanced(model.meshes[i], model.materials[model.meshMaterial[i]], transforms.data(), (int)transforms.size());
+}
+
+/**
+ * @brief Builds the planes of the volume a perspective camera sees
+ *
+ * @param camera The camera
+ * @param aspect Width / height of the render target
+ * @return The frustum
+ */
+static ViewFrustum getViewFrustum(const Camera3D &camera, float aspect)
+{
+	Vector3 forward = Vector3Normalize(Vector3Subtract(camera.target, camera.position));
+	Vector3 right = Vector3Normalize(Vector3CrossProduct(forward, camera.up));
+	Vector3 up = Vector3CrossProduct(right, forward);
+
+	float tanV = tanf(camera.fovy * DEG2RAD / 2);
+	float tanH = tanV * aspect;
+
+	// Side planes go through the camera; inward normals are forward * tan -+ the side
+	ViewFrustum frustum;
+
+	frustum.normal[0] = Vector3Normalize(Vector3Subtract(Vector3Scale(forward, tanH), right));
+	frustum.normal[1] = Vector3Normalize(Vector3Add(Vector3Scale(forward, tanH), right));
+	frustum.normal[2] = Vector3Normalize(Vector3Subtract(Vector3Scale(forward, tanV), up));
+	frustum.normal[3] = Vector3Normalize(Vector3Add(Vector3Scale(forward, tanV), up));
+	frustum.normal[4] = forward;
+	frustum.normal[5] = Vector3Scale(forward, -1);
+
+	for (int i = 0; i < 4; i++)
+		frustum.offset[i] = -Vector3DotProduct(frustum.normal[i], camera.position);
+
+	frustum.offset[4] = -Vector3DotProduct(forward, camera.position);
+	frustum.offset[5] = Vector3DotProduct(forward, camera.position) + CAMERA_FAR_PLANE;
+
+	return frustum;
+}
+
+/**
+ * @brief Sorts the visible asteroids of a range of the snapshot by level of detail
+ *
+ * Bodies outside the frustum are dropped; the others are counted in the batch
+ * of their range band, compared on squared distances.
+ *
+ * @param lists The lists to fill (emptied first)
+ * @param snapshot Snapshot of the orbital sim
+ * @param frustum Planes of the camera view
+ * @param cameraPos Position of the camera
+ * @param first First body of the range
+ * @param last One past the last body of the range
+ */
+static void classifyAsteroids(AsteroidDrawLists *lists, const SimSnapshot *snapshot, const ViewFrustum &frustum,
+							  Vector3 cameraPos, unsigned int first, unsigned int last)
+{
+	const float shortRange2 = (float)CAMERA_SHORT_RANGE * CAMERA_SHORT_RANGE;
+	const float mediumRange2 = (float)CAMERA_MEDIUM_RANGE * CAMERA_MEDIUM_RANGE;
+
+	lists->draws.clear();
+	lists->mediumColors.clear();
+	lists->batchCounts.assign(ASTEROID_BATCH_MEDIUM, 0);
+
+	for (unsigned int i = first; i < last; i++)
 	{
-		Vector3 scaledBodyPos = {5E-10F * (sim->bodiesList[i].position.x), 5E-10F * (sim->bodiesList[i].position.y), 5E-10F * (sim->bodiesList[i].position.z)};
-		Vector3 &cameraPos = view->camera.position;
+		Vector3 scaledBodyPos = getSnapshotPosition(snapshot, i) * 5E-10F;
+		bool visible = true;
 
-		Vector3 diff = {
-			scaledBodyPos.x - cameraPos.x,
-			scaledBodyPos.y - cameraPos.y,
-			scaledBodyPos.z - cameraPos.z};
+		for (int plane = 0; plane < 6; plane++)
+			visible &= Vector3DotProduct(frustum.normal[plane], scaledBodyPos) + frustum.offset[plane] >= -CULL_MARGIN;
 
-		double dist = sqrt(diff.x * diff.x + diff.y * diff.y + diff.z * diff.z);
-		if (dist < CAMERA_SHORT_RANGE)
+		if (!visible)
+			continue;
+
+		Vector3 diff = Vector3Subtract(scaledBodyPos, cameraPos);
+		float dist2 = Vector3DotProduct(diff, diff);
+		unsigned int batch;
+
+		if (dist2 < shortRange2)
 		{
-			DrawModelEx(Master_resource->Models_Asteroids[i % 4], scaledBodyPos, {0, 1, 0}, 0, {0.4F, 0.4F, 0.4F}, WHITE);
+			batch = i % ASTEROID_MODEL_COUNT;
 		}
-		else if (dist < CAMERA_MEDIUM_RANGE)
+		else if (dist2 < mediumRange2)
 		{
-			int rings = 2;
-			int slices = 3;
+			Color color = getSnapshotColor(snapshot, i);
+			size_t colorIndex = 0;
+
+			while (colorIndex < lists->mediumColors.size() && !isSameColor(lists->mediumColors[colorIndex], color))
+				colorIndex++;
 
-			DrawSphereEx(scaledBodyPos, 0.03F * cbrt(sim->bodiesList[i].radius), rings, slices, sim->bodiesList[i].color);
+			if (colorIndex == lists->mediumColors.size())
+			{
+				lists->mediumColors.push_back(color);
+				lists->batchCounts.push_back(0);
+			}
+
+			batch = ASTEROID_BATCH_MEDIUM + (unsigned int)colorIndex;
 		}
 		else
 		{
-			DrawPoint3D(scaledBodyPos, sim->bodiesList[i].color);
+			batch = ASTEROID_BATCH_FAR;
 		}
+
+		lists->draws.push_back({scaledBodyPos, i, batch});
+		lists->batchCounts[batch]++;
 	}
+}
 
-	rotation += 0.5;
+/**
+ * @brief Gives a range of asteroids its slice of every merged batch
+ *
+ * Called for the ranges in order: each slice starts where the same batch of
+ * the previous ranges ends.
+ *
+ * @param lists The classified lists of the range
+ * @param view The view, whose medium batches gain the new colors
+ * @param nearSizes Asteroids of each model taken so far, updated
+ * @param mediumSizes Asteroids of each merged medium batch taken so far, updated
+ * @param farSize Far asteroids taken so far, updated
+ */
+static void placeAsteroidDraws(AsteroidDrawLists *lists, View *view, unsigned int *nearSizes,
+							   std::vector<unsigned int> &mediumSizes, unsigned int *farSize)
+{
+	lists->batchOffsets.resize(lists->batchCounts.size());
+	lists->mediumBatches.resize(lists->mediumColors.size());
 
-	if (ship_enable)
+	for (int i = 0; i < ASTEROID_MODEL_COUNT; i++)
 	{
-		renderSpaceShip(view, sim, Master_resource);
+		lists->batchOffsets[i] = nearSizes[i];
+		nearSizes[i] += lists->batchCounts[i];
 	}
-	EndMode3D();
 
-	EndTextureMode();
+	lists->batchOffsets[ASTEROID_BATCH_FAR] = *farSize;
+	*farSize += lists->batchCounts[ASTEROID_BATCH_FAR];
+
+	for (size_t i = 0; i < lists->mediumColors.size(); i++)
+	{
+		unsigned int merged = (unsigned int)(getColorBatch(view->mediumAsteroids, lists->mediumColors[i]) - view->mediumAsteroids.data());
+		unsigned int batch = ASTEROID_BATCH_MEDIUM + (unsigned int)i;
+
+		mediumSizes.resize(view->mediumAsteroids.size(), 0);
+
+		lists->mediumBatches[i] = merged;
+		lists->batchOffsets[batch] = mediumSizes[merged];
+		mediumSizes[merged] += lists->batchCounts[batch];
+	}
+}
+
+/**
+ * @brief Writes the instances of a range of asteroids into its slices of the merged batches
+ *
+ * @param lists The placed lists of the range
+ * @param view The view, with merged batches already sized for every range
+ * @param snapshot Snapshot of the orbital sim
+ */
+static void writeAsteroidDraws(const AsteroidDrawLists *lists, View *view, const SimSnapshot *snapshot)
+{
+	std::vector<unsigned int> offsets = lists->batchOffsets;
+
+	for (const AsteroidDraw &draw : lists->draws)
+	{
+		unsigned int offset = offsets[draw.batch]++;
+
+		if (draw.batch < ASTEROID_BATCH_FAR)
+		{
+			view->nearAsteroids[draw.batch][offset] = getInstanceTransform(draw.position, 0.4F);
+		}
+		else if (draw.batch == ASTEROID_BATCH_FAR)
+		{
+			view->farAsteroids[offset] = {draw.position, getSnapshotColor(snapshot, draw.body)};
+		}
+		else
+		{
+			InstanceBatch &batch = view->mediumAsteroids[lists->mediumBatches[draw.batch - ASTEROID_BATCH_MEDIUM]];
+
+			batch.transforms[offset] = getInstanceTransform(draw.position, 0.03F * cbrtf(getSnapshotRadius(snapshot, draw.body)));
+		}
+	}
+}
+
+/**
+ * @brief Makes room for a number of points in the point cloud buffers
+ *
+ * @param view The view
+ * @param Master_resource Pointer to the struct containing all graphical data
+ * @param pointCount Points the buffers must hold
+ */
+static void reservePointCloud(View *view, const resource_t *Master_resource, unsigned int pointCount)
+{
+	if (pointCount <= view->pointsCapacity)
+		return;
+
+	if (!view->pointsVao)
+	{
+		// Two triangles covering [-1, 1]^2
+		static const float corners[] = {-1, -1, 1, -1, 1, 1, -1, -1, 1, 1, -1, 1};
+
+		view->pointsVao = rlLoadVertexArray();
+		rlEnableVertexArray(view->pointsVao);
+
+		view->pointsCornerVbo = rlLoadVertexBuffer(corners, sizeof(corners), false);
+		rlSetVertexAttribute(Master_resource->Shader_points_corner_location, 2, RL_FLOAT, false, 0, 0);
+		rlEnableVertexAttribute(Master_resource->Shader_points_corner_location);
+	}
+	else
+	{
+		rlEnableVertexArray(view->pointsVao);
+		rlUnloadVertexBuffer(view->pointsVbo);
+	}
+
+	// Grown geometrically, so a growing cloud is not reallocated every frame
+	view->pointsCapacity = std::max(pointCount, 2 * view->pointsCapacity);
+	view->pointsVbo = rlLoadVertexBuffer(NULL, view->pointsCapacity * sizeof(PointVertex), true);
+
+	int position = Master_resource->Shader_points_position_location;
+	int color = Master_resource->Shader_points_color_location;
+
+	rlSetVertexAttribute(position, 3, RL_FLOAT, false, sizeof(PointVertex), offsetof(PointVertex, position));
+	rlEnableVertexAttribute(position);
+	rlSetVertexAttributeDivisor(position, 1);
+
+	rlSetVertexAttribute(color, 4, RL_UNSIGNED_BYTE, true, sizeof(PointVertex), offsetof(PointVertex, color));
+	rlEnableVertexAttribute(color);
+	rlSetVertexAttributeDivisor(color, 1);
+
+	rlDisableVertexArray();
+}
+
+/**
+ * @brief Draws the far asteroids gathered this frame with a single call
+ *
+ * The points are uploaded to a buffer that persists across frames and drawn
+ * as instanced screen-space quads, shrinking with distance.
+ *
+ * @param view The view
+ * @param Master_resource Pointer to the struct containing all graphical data
+ */
+static void drawPointCloud(View *view, const resource_t *Master_resource)
+{
+	unsigned int pointCount = (unsigned int)view->farAsteroids.size();
+
+	if (!pointCount)
+		return;
+
+	reservePointCloud(view, Master_resource, pointCount);
+	rlUpdateVertexBuffer(view->pointsVbo, view->farAsteroids.data(), pointCount * sizeof(PointVertex), 0);
+
+	// Whatever raylib has batched so far goes first
+	rlDrawRenderBatchActive();
+
+	Matrix mvp = MatrixMultiply(rlGetMatrixModelview(), rlGetMatrixProjection());
+	float viewportSize[2] = {(float)rlGetFramebufferWidth(), (float)rlGetFramebufferHeight()};
+	float pointSize = POINT_SIZE;
+
+	rlEnableShader(Master_resource->Shader_points.id);
+	rlSetUniformMatrix(Master_resource->Shader_points_mvp_location, mvp);
+	rlSetUniform(Master_resource->Shader_points_viewportSize_location, viewportSize, RL_SHADER_UNIFORM_VEC2, 1);
+	rlSetUniform(Master_resource->Shader_points_pointSize_location, &pointSize, RL_SHADER_UNIFORM_FLOAT, 1);
+
+	rlEnableVertexArray(view->pointsVao);
+	rlDrawVertexArrayInstanced(0, 6, pointCount);
+	rlDisableVertexArray();
+
+	rlDisableShader();
+}
+
+/**
+ * @brief Renders the asteroids, culled and batched by level of detail
+ *
+ * Ranges of asteroids are classified in parallel, then each one writes its
+ * instances in parallel into its own slice of the merged batches: close
+ * asteroids are grouped by model and mid-range ones by color, and each group
+ * takes a single instanced draw call. Far asteroids are one point cloud.
+ *
+ * @param view The view
+ * @param snapshot Snapshot of the orbital sim
+ * @param Master_resource Pointer to the struct containing all graphical data
+ * @param firstAsteroid Index of the first asteroid in the snapshot
+ */
+static void renderAsteroids(View *view, const SimSnapshot *snapshot, resource_t *Master_resource, unsigned int firstAsteroid)
+{
+	if (firstAsteroid >= snapshot->bodyCount)
+		return;
+
+	const Texture2D &target = Master_resource->Texture_Buffer1.texture;
+	ViewFrustum frustum = getViewFrustum(view->camera, (float)target.width / target.height);
+	Vector3 cameraPos = view->camera.position;
+
+	unsigned int rangeCount = (snapshot->bodyCount - firstAsteroid + RENDER_BODIES_PER_JOB - 1) / RENDER_BODIES_PER_JOB;
+
+	if (view->asteroidRanges.size() < rangeCount)
+		view->asteroidRanges.resize(rangeCount);
+
+	AsteroidDrawLists *ranges = view->asteroidRanges.data();
+
+	parallelFor(view->jobSystem, 0, rangeCount, 1, [&](unsigned int begin, unsigned int end)
+				{
+					for (unsigned int range = begin; range < end; range++)
+					{
+						unsigned int first = firstAsteroid + range * RENDER_BODIES_PER_JOB;
+						unsigned int last = std::min(snapshot->bodyCount, first + RENDER_BODIES_PER_JOB);
+
+						classifyAsteroids(&ranges[range], snapshot, frustum, cameraPos, first, last);
+					}
+				});
+
+	// Prefix sums of the counts: only a few numbers per range, the instances are not copied
+	unsigned int nearSizes[ASTEROID_MODEL_COUNT] = {};
+	std::vector<unsigned int> mediumSizes(view->mediumAsteroids.size(), 0);
+	unsigned int farSize = 0;
+
+	for (unsigned int range = 0; range < rangeCount; range++)
+		placeAsteroidDraws(&ranges[range], view, nearSizes, mediumSizes, &farSize);
+
+	// Kept capacity is reused; only growth is initialized
+	for (int i = 0; i < ASTEROID_MODEL_COUNT; i++)
+		view->nearAsteroids[i].resize(nearSizes[i]);
+
+	for (size_t i = 0; i < view->mediumAsteroids.size(); i++)
+		view->mediumAsteroids[i].transforms.resize(mediumSizes[i]);
+
+	view->farAsteroids.resize(farSize);
+
+	parallelFor(view->jobSystem, 0, rangeCount, 1, [&](unsigned int begin, unsigned int end)
+				{
+					for (unsigned int range = begin; range < end; range++)
+						writeAsteroidDraws(&ranges[range], view, snapshot);
+				});
+
+	for (int i = 0; i < ASTEROID_MODEL_COUNT; i++)
+		drawModelInstanced(Master_resource->Models_Asteroids[i], view->nearAsteroids[i]);
+
+	Material &sphereMaterial = Master_resource->Material_AsteroidSphere;
+
+	for (size_t i = 0; i < view->mediumAsteroids.size(); i++)
+	{
+		const InstanceBatch &batch = view->mediumAsteroids[i];
+
+		if (batch.transforms.empty())
+			continue;
+
+		sphereMaterial.maps[MATERIAL_MAP_DIFFUSE].color = batch.color;
+		DrawMeshInstanced(Master_resource->Mesh_AsteroidSphere, sphereMaterial, batch.transforms.data(), (int)batch.transforms.size());
+	}
+
+	drawPointCloud(view, Master_resource);
 }
 
 /**
  * @brief Renders the spaceship
  *
  * @param view The view
- * @param sim The orbital sim
+ * @param snapshot Snapshot of the orbital sim
  * @param Master_resource Pointer to the struct containing all graphical data
  */
-static void renderSpaceShip(View *view, OrbitalSim *sim, resource_t *Master_resource)
+static void renderSpaceShip(View *view, const SimSnapshot *snapshot, resource_t *Master_resource)
 {
 	static float rotation = 0.0f;
 	static float tiltX = 0.0f;
@@ -8,8 +8,60 @@
 #ifndef ORBITALSIMVIEW_H
 #define ORBITALSIMVIEW_H
 
+#include <vector>
+
 #include "configuration.h"
-#include "orbitalSim.h"
+#include "jobSystem.h"
+#include "simThread.h"
+
+/**
+ * Instances of a mesh drawn with a single call
+ */
+struct InstanceBatch
+{
+	Color color;
+	std::vector<Matrix> transforms;
+};
+
+/**
+ * A point of the far point cloud, as stored in its vertex buffer
+ */
+struct PointVertex
+{
+	Vector3 position;
+	Color color;
+};
+
+// Draw batches of a range of asteroids: one per asteroid model, the point
+// cloud, then one per color of the mid-range spheres
+#define ASTEROID_BATCH_FAR ASTEROID_MODEL_COUNT
+#define ASTEROID_BATCH_MEDIUM (ASTEROID_MODEL_COUNT + 1)
+
+/**
+ * A visible asteroid and the batch it is drawn with
+ */
+struct AsteroidDraw
+{
+	Vector3 position; // Scaled to the view
+	unsigned int body;
+	unsigned int batch;
+};
+
+/**
+ * Visible asteroids of a range of the snapshot, sorted by level of detail
+ *
+ * Filled in two passes: the asteroids are classified and counted per batch,
+ * then written straight into the slice of the merged batches that prefix sums
+ * over the ranges give each range.
+ */
+struct AsteroidDrawLists
+{
+	std::vector<AsteroidDraw> draws;
+	std::vector<Color> mediumColors;		 // Color of each medium batch of the range
+	std::vector<unsigned int> mediumBatches; // Merged batch of each medium color, in View::mediumAsteroids
+	std::vector<unsigned int> batchCounts;	 // Asteroids per batch
+	std::vector<unsigned int> batchOffsets;	 // Start of the slice of each batch in its merged batch
+};
 
 /**
  * The view data
@@ -17,6 +69,19 @@
 struct View
 {
 	Camera3D camera;
+	JobSystem *jobSystem; // Workers the asteroids are classified on
+
+	// Asteroid batches, refilled every frame (kept to reuse their memory)
+	std::vector<AsteroidDrawLists> asteroidRanges;			 // Filled in parallel, one per range
+	std::vector<Matrix> nearAsteroids[ASTEROID_MODEL_COUNT]; // One per asteroid model, written by the ranges in parallel
+	std::vector<InstanceBatch> mediumAsteroids;				 // One per color, written by the ranges in parallel
+	std::vector<PointVertex> farAsteroids;					 // Written by the ranges in parallel
+
+	// GPU buffers of the point cloud, created on first use and grown as needed
+	unsigned int pointsVao;
+	unsigned int pointsCornerVbo; // The quad every point is drawn with
+	unsigned int pointsVbo;		  // One PointVertex per instance
+	unsigned int pointsCapacity;  // Points pointsVbo can hold
 };
 
 View *constructView(int *fps, monitor_t *monitor);
@@ -24,9 +89,9 @@ void setup_3D_view(View *view);
 void destroyView(View *view);
 
 bool isViewRendering(View *view);
-void renderView(View *view, OrbitalSim *sim, resource_t *Master_resource, int simType, bool camera_movement, bool ship_enable);
+void renderView(View *view, const SimSnapshot *snapshot, resource_t *Master_resource, int simType, bool camera_movement, bool ship_enable);
 
-const char *getISODate(float timestamp);
+const char *getISODate(double timestamp);
 
 
 #endif